@@ -6,10 +6,22 @@
 **  Each concept is presented by a C-structure type in this header file
 **  Sets of C-functions described in "src/core/" files operates these types:
 **    "saotime.c" - time calculation functions for Moment concept
+**    "saostat.c" - event catalog statistics for Seismicity concept
+**    "saoenv.c"  - min/max level-of-detail pyramid for Envelope concept
+**    "saoqc.c"   - quality control scan of samples for DataStat concept
+**    "saofft.c"  - fast Fourier transform of real traces for FftPlan concept
+**    "saoresp.c" - instrument response removal for Response concept
+**    "saoarray.c" - beamforming and FK analysis for FkPlan concept
+**    "saofilt.c" - Butterworth filters of traces for Filter concept
+**    "saotrig.c" - STA/LTA detection of events for Trigger concept
+**    "saopick.c" - kurtosis and AR-AIC onset picker for Pick concept
+**    "saoprof.c" - counters and timers of probes, see "saoprof.h"
 *******************************************************************************/
 #ifndef SAOCORE_H
 #define SAOCORE_H
 
+#include <stddef.h>
+#include <stdint.h>
 
 
 /*******************************************************************************
@@ -34,6 +46,16 @@ EPOCH_0 = {1970, 1, 1, 1, 0, 0, 0, 0};
 static const Moment
 NOT_MOMENT = {0, 0, 0, 0, 0, 0, 0, 0};
 
+/*  Status codes of reentrant functions, SAO_OK or negative error code  */
+#define SAO_OK          0       // Success
+#define SAO_EFORMAT    -1       // Incorrect input or unsupported format
+#define SAO_ESPACE     -2       // Buffer is too small
+#define SAO_EIO        -3       // File can not be opened, read or written
+#define SAO_ENOSAC     -4       // File is not a SAC file
+
+/*  Buffer size enough for Moment string of any supported format  */
+#define SAO_MOMENT_LEN  24
+
 
 /*******************************************************************************
 **    For reading and writing here is a table of supported string formats:
@@ -64,9 +86,13 @@ NOT_MOMENT = {0, 0, 0, 0, 0, 0, 0, 0};
 **  addSecs(..)       - add or substract seconds to/from a Moment
 **  difDays(..)       - calculate difference in days between two Moments
 **  difSecs(..)       - calculate difference in seconds between two Moments
+**  cmpMoment(..)     - compare two Moments without epoch time calculation
 **  readMoment(..)    - read Moment from a string of supported format
 **  writeMoment(..)   - write Moment to a string of specified format
 **  printMoment(..)   - print Moment to standard output
+**  Reentrant functions - no allocation, no output, return status code:
+**  scanMoment(..)    - read Moment from a string with status code
+**  sprintMoment(..)  - write Moment into a caller's buffer
 */
 Moment
 fromEpoch (double epoch);
@@ -83,6 +109,9 @@ difSecs (Moment t2, Moment t1);
 long
 difDays (Moment t2, Moment t1);
 
+int
+cmpMoment (Moment t2, Moment t1);
+
 Moment
 readMoment (const char *buf);
 
@@ -91,6 +120,12 @@ writeMoment (Moment t, const char* format);
 
 void
 printMoment (Moment t);
+
+int
+scanMoment (const char *buf, Moment *t);
+
+int
+sprintMoment (char *buf, size_t size, Moment t, const char *format);
 /******************************************************************************/
 
 
@@ -105,7 +140,438 @@ printMoment (Moment t);
 extern int    isDate (short y, short m, short d);
 extern int    isTime (short h, short m, short s);
 extern short  getYday (short year, short month, short day);
-extern void   getMonthDay (short* month, short* day, short year, short yday);
+extern int    getMonthDay (short* month, short* day, short year, short yday);
 extern int    isMoment (Moment t);
 /******************************************************************************/
+
+
+
+/*******************************************************************************
+**    <Seismicity> concept - describes statistics of an event catalog.
+**  Structure accumulates events one by one, so a catalog of any size is read
+**  only once and memory stays constant. Magnitudes are kept in the fixed
+**  magnitude-frequency histogram (MFD) with MFD_DM bin width, i.e. values
+**  rounded to one decimal as usual for catalogs. Scalar seismic moment of
+**  each event is estimated from its magnitude by Hanks & Kanamori relation.
+**  Two structures of the same binning could be merged, e.g. for windows.
+*/
+#define MFD_MMIN    -3.0        // Magnitude of the first histogram bin
+#define MFD_DM      0.1         // Magnitude bin width
+#define MFD_NBINS   130         // Number of bins: -3.0 .. 9.9
+
+typedef struct Seismicity {
+  long      nev,  nout;         // Number of events and events out of MFD
+  double    m0;                 // Cumulative scalar seismic moment, N*m
+  float     mmin, mmax;         // Minimal and maximal magnitudes
+  long      mfd[MFD_NBINS];     // Magnitude-frequency distribution
+}  Seismicity;
+
+static const Seismicity
+NO_SEISMICITY = {0, 0, 0.0, 99.f, -99.f, {0}};
+
+
+/*******************************************************************************
+**    Core functions for working with the Seismicity concept - "saostat.c"
+**  addEvent(..)      - account event of given magnitude
+**  mergeSeismicity(..) - add statistics of one structure to another
+**  getMc(..)         - estimate magnitude of completeness (max curvature)
+**  getBValue(..)     - estimate b-value above Mc (Aki-Utsu max likelihood)
+**  bootSeismicity(..) - one bootstrap replicate of Mc and b-value
+**  getBucket(..)     - key of hour/day/year bucket containing a Moment
+**  bucketBegin(..)   - first Moment of hour/day/year bucket by its key
+*/
+void
+addEvent (Seismicity *s, double mag);
+
+void
+mergeSeismicity (Seismicity *s, const Seismicity *add);
+
+double
+getMc (const Seismicity *s, double mccor);
+
+double
+getBValue (const Seismicity *s, double mc, double *a, long *n);
+
+void
+bootSeismicity (const Seismicity *s, double mccor, uint64_t seed,
+                double *mc, double *b);
+
+long
+getBucket (Moment t, char unit);
+
+Moment
+bucketBegin (long key, char unit);
+/******************************************************************************/
+
+
+
+/*******************************************************************************
+**    <Envelope> concept - min/max level-of-detail pyramid of a trace.
+**  To plot a long record there is no need to push every sample to plotter,
+**  minimum and maximum values per pixel give the same picture. Pyramid keeps
+**  such min/max pairs for blocks of samples at power-of-two decimations:
+**  level 0 has blocks of 'base' samples, every next level has blocks twice
+**  longer and merges pairs of the previous one. The last level is one block
+**  for the whole trace. All levels are stored in one continuous buffer of
+**  float pairs (min, max), which is about 4/base of the trace size.
+*/
+#define ENV_MAXLEV  48          // Maximal number of levels
+
+typedef struct Envelope {
+  long      npts;               // Number of samples of the trace
+  int       base, nlev;         // Samples per level 0 block, number of levels
+  double    b;                  // Epoch time of the first sample
+  double    delta;              // Sampling interval
+  long      len[ENV_MAXLEV];    // Number of blocks of each level
+  float    *lev[ENV_MAXLEV];    // Pointers to min/max pairs of each level
+}  Envelope;
+
+
+/*******************************************************************************
+**    Core functions for working with the Envelope concept - "saoenv.c"
+**  initEnvelope(..)  - set trace parameters and count levels
+**  setEnvelope(..)   - set pointers to levels in a buffer of pairs
+**  buildEnvelope(..) - calculate all levels from trace samples
+**  pickEnvelope(..)  - select level and blocks for time range and pixels
+*/
+long
+initEnvelope (Envelope *env, long npts, int base, double b, double delta);
+
+void
+setEnvelope (Envelope *env, float *buf);
+
+void
+buildEnvelope (Envelope *env, const float *data, float *buf);
+
+int
+pickEnvelope (const Envelope *env, double t1, double t2, int width,
+              long *first, long *count);
+/******************************************************************************/
+
+
+
+/*******************************************************************************
+**    <DataStat> concept - statistics of trace samples for quality control.
+**  All values are gathered in one pass over samples: broken values (NaN and
+**  infinity), zeros, the longest run of equal samples (dead channel or gap
+**  filled with constant), number of samples hitting minimum and maximum and
+**  the longest runs at them (clipping) and the range and mean to compare
+**  with the header.
+**  Range and mean are calculated over finite samples only.
+*/
+typedef struct DataStat {
+  long      npts;               // Number of scanned samples
+  long      nnan, ninf;         // Not-a-number and infinite samples
+  long      nzero;              // Zero samples
+  long      nmin, nmax;         // Samples equal to minimum and maximum
+  long      runmin, runmax;     // The longest runs at minimum and maximum
+  long      maxrun;             // The longest run of equal samples
+  float     runval;             // Value of the longest run
+  float     min,  max;          // Range of finite samples
+  double    mean;               // Mean of finite samples
+}  DataStat;
+
+
+/*******************************************************************************
+**    Core functions for working with the DataStat concept - "saoqc.c"
+**  scanData(..)      - gather statistics of samples in one pass
+*/
+void
+scanData (const float *x, long n, DataStat *st);
+/******************************************************************************/
+
+
+
+/*******************************************************************************
+**    <FftPlan> concept - prepared fast Fourier transform of real samples.
+**  Transform size is a power of two, traces are padded with zeros up to it.
+**  Spectrum of n samples is n/2 + 1 complex values (re, im pairs) from zero
+**  to Nyquist frequency, kept in the same buffer of n + 2 doubles.
+**  Plans are cached by size and shared between threads (read only).
+*/
+typedef struct FftPlan {
+  long      n;                  // Number of real samples
+  double   *tw;                 // Twiddles of complex transform of n/2
+  double   *rtw;                // Twiddles of real/complex splitting
+  long     *rev;                // Bit reversal table of n/2 points
+  struct FftPlan *next;         // Next plan in the cache
+}  FftPlan;
+
+
+/*******************************************************************************
+**    Core functions for working with the FftPlan concept - "saofft.c"
+**  fftSize(..)       - size of transform for a trace (next power of two)
+**  getFftPlan(..)    - get plan of transform of a size from the cache
+**  fftReal(..)       - spectrum of real samples (in place)
+**  fftInverse(..)    - real samples of spectrum (in place)
+*/
+long
+fftSize (long n);
+
+const FftPlan*
+getFftPlan (long n);
+
+void
+fftReal (const FftPlan *p, double *x);
+
+void
+fftInverse (const FftPlan *p, double *x);
+/******************************************************************************/
+
+
+
+/*******************************************************************************
+**    <Response> concept - instrument response in poles and zeros form.
+**  H(s) = constant * (s - z1)...(s - zN) / (s - p1)...(s - pM), s = 2*pi*i*f
+**  As in SAC PZ files the response is from displacement (m) to counts.
+**  Response is removed by spectral division with a water level (response
+**  below the level is raised to it keeping the phase) and pre-filter (cosine
+**  taper f1-f2 and f3-f4 in Hz). RespWork keeps buffers and the inverse
+**  response of the last trace, so traces of one channel with the same length
+**  and sampling reuse everything. One RespWork is used by one thread.
+*/
+#define RESP_MAXPZ 64
+
+typedef struct {
+  double    constant;           // Normalization and sensitivity
+  int       nzeros, npoles;     // Number of zeros and poles
+  double    zeros[2*RESP_MAXPZ];  // Zeros (re, im pairs), rad/s
+  double    poles[2*RESP_MAXPZ];  // Poles (re, im pairs), rad/s
+}  Response;
+
+typedef struct {
+  double    wlevel;             // Water level, dB below maximum (<0 - none)
+  double    pre[4];             // Pre-filter corners f1-f4, Hz (0 - none)
+  int       units;              // Output: 0 - displacement, 1 - velocity,
+                                //         2 - acceleration
+}  RespOpts;
+
+typedef struct {
+  long      size;               // Size of transform, 0 for empty RespWork
+  double   *buf;                // Trace and spectrum, size + 2 values
+  double   *inv;                // Inverse response, size + 2 values
+  const FftPlan  *plan;         // Plan of transform
+  const Response *resp;         // Response, sampling and options of 'inv'
+  double    delta;
+  RespOpts  opts;
+}  RespWork;
+
+
+/*******************************************************************************
+**    Core functions for working with the Response concept - "saoresp.c"
+**  evalResponse(..)  - complex response at a frequency
+**  removeResponse(..) - remove response from samples of a trace (in place)
+**  freeRespWork(..)  - free buffers of RespWork
+*/
+void
+evalResponse (const Response *r, double f, double *re, double *im);
+
+int
+removeResponse (RespWork *w, const Response *r, const RespOpts *o,
+                float *x, long n, double delta);
+
+void
+freeRespWork (RespWork *w);
+/******************************************************************************/
+
+
+
+/*******************************************************************************
+**    <FkPlan> concept - frequency-wavenumber analysis of a seismic array.
+**  Stations are given by offsets east (x) and north (y) from the array
+**  center in km. Horizontal slowness (sx, sy) in s/km is the propagation
+**  direction of a plane wave, it comes to a station at r after the center
+**  by the delay sx*x + sy*y. Slowness grid is NODES x NODES points from
+**  -smax to smax on both axes. For every window of all stations the beam
+**  power is summed over frequency bins of a band for each grid node.
+**  Plan keeps window taper and steering vectors exp(2*pi*i*f*delay) of all
+**  nodes, stations and bins (real and imaginary parts are separate rows of
+**  floats padded to 4 bins), so it is computed once and shared by threads.
+**  FkWork keeps buffers of one thread.
+*/
+typedef struct {
+  int       nsta;               // Number of stations
+  int       nodes;              // Grid nodes along each slowness axis
+  double    smax;               // Grid covers -smax..smax s/km
+  long      nwin, size;         // Samples in window and size of transform
+  double    delta;              // Sampling interval, s
+  long      k1, nf, nfv;        // First bin, number of bins, padded to 4
+  const FftPlan *plan;          // Plan of transform
+  float    *taper;              // Window taper, nwin values
+  float    *steer;              // Steering vectors, nodes^2 * nsta * 2 * nfv
+}  FkPlan;
+
+typedef struct {
+  double   *buf;                // Transform buffer, size + 2 values
+  float    *spec;               // Spectra of stations, nsta * 2 * nfv
+  float    *beam;               // Beam spectrum of a node, 2 * nfv
+}  FkWork;
+
+typedef struct {
+  double    relpow;             // Beam power relative to power of stations
+  double    abspow;             // Beam power (mean over bins)
+  double    sx, sy;             // Slowness of the maximum, s/km
+  double    baz, slow;          // Back azimuth (degrees) and slowness (s/km)
+}  FkPeak;
+
+
+/*******************************************************************************
+**    Core functions for working with the FkPlan concept - "saoarray.c"
+**  arrayOffsets(..)  - offsets of stations from the array center in km
+**  initFkPlan(..)    - prepare taper and steering vectors of a grid
+**  fkWindow(..)      - power map and its maximum for one window
+**  delayAndSum(..)   - beam trace of stations for a slowness
+**  freeFkPlan(..)    - free buffers of FkPlan
+**  freeFkWork(..)    - free buffers of FkWork
+*/
+void
+arrayOffsets (int nsta, const double *lat, const double *lon,
+              double *x, double *y);
+
+int
+initFkPlan (FkPlan *p, int nsta, const double *x, const double *y,
+            double smax, int nodes, long nwin, double delta,
+            double fmin, double fmax);
+
+int
+fkWindow (const FkPlan *p, FkWork *w, const float **tr, long first,
+          float *map, FkPeak *peak);
+
+void
+delayAndSum (const float **tr, int nsta, long npts, const double *x,
+             const double *y, double sx, double sy, double delta, float *beam);
+
+void
+freeFkPlan (FkPlan *p);
+
+void
+freeFkWork (FkWork *w);
+/******************************************************************************/
+
+
+/*******************************************************************************
+**    <Filter> concept - recursive Butterworth filter of a trace.
+**  Filter is a cascade of second order sections (biquads) designed by the
+**  bilinear transform with prewarping. Band-pass is a high-pass of lower
+**  corner followed by a low-pass of upper corner of the same order, so it
+**  suits bands wider than an octave. Zero-phase filter is applied forward
+**  and backward, so its order is doubled.
+*/
+#define FILT_MAXORD 8           // Maximum order of low-pass or high-pass
+#define FILT_MAXSEC FILT_MAXORD // Sections of band-pass of maximum order
+
+enum { FILT_LP, FILT_HP, FILT_BP };
+
+typedef struct {
+  int       nsec;               // Number of sections
+  int       zerophase;          // 1 - forward and backward pass
+  double    b[FILT_MAXSEC][3];  // Numerators of sections
+  double    a[FILT_MAXSEC][2];  // Denominators (a1, a2) of sections, a0 = 1
+}  Filter;
+
+
+/*******************************************************************************
+**    Core functions for working with the Filter concept - "saofilt.c"
+**  designFilter(..)  - design Butterworth filter for a sampling interval
+**  applyFilter(..)   - filter samples in place
+*/
+int
+designFilter (Filter *f, int type, double f1, double f2, int order,
+              int zerophase, double delta);
+
+void
+applyFilter (const Filter *f, float *x, long n);
+/******************************************************************************/
+
+
+
+/*******************************************************************************
+**    <Trigger> concept - event detected by STA/LTA ratio of a trace.
+**  Characteristic function is the ratio of mean squares of samples in a
+**  short (STA) and a long (LTA) window ending at a sample, both windows
+**  are moved by running sums. Trigger is on when the ratio exceeds ON and
+**  off when it falls below OFF. Ratio is 0 for the first LTA samples.
+*/
+typedef struct {
+  long      on,   off;          // Samples of switching on and off
+  float     peak;               // Maximum of ratio between them
+}  Trigger;
+
+
+/*******************************************************************************
+**    Core functions for working with the Trigger concept - "saotrig.c"
+**  staLta(..)        - characteristic function of classic STA/LTA
+**  findTriggers(..)  - triggers of a characteristic function
+*/
+int
+staLta (const float *x, long n, long nsta, long nlta, float *cf);
+
+long
+findTriggers (const float *cf, long n, double on, double off,
+              Trigger *tr, long max);
+/******************************************************************************/
+
+
+
+/*******************************************************************************
+**    <Pick> concept - onset of a phase picked in a window of a trace.
+**  Kurtosis of samples in a sliding window rises sharply at an impulsive
+**  onset, so its maximum gives a coarse pick. The pick is refined by
+**  AR-AIC: autoregressive models are fitted to noise before and signal
+**  after the coarse pick, and the onset is the minimum of Akaike criterion
+**  of their prediction errors. Weight is taken from signal-to-noise ratio
+**  as SAC quality 0 (best) to 4 (unusable). Kurtosis of a stream is kept
+**  in KurtState with the last nwin samples in a ring of the caller.
+*/
+#define PICK_MAXORD 32          // Maximum order of AR models
+#define PICK_LANES  4           // Windows with kurtosis done at once
+
+typedef struct {
+  long      idx;                // Sample of onset in the window
+  float     snr;                // RMS ratio of signal and noise windows
+  int       weight;             // Quality from 0 (best) to 4
+}  Pick;
+
+typedef struct {
+  long      nwin,  n;           // Samples of window, samples passed
+  long      nfin;               // Finite samples in window
+  double    ref;                // Level of sums, moved to the running mean
+  double    s1, s2, s3, s4;     // Sums of powers of samples relative to ref
+  float    *ring;               // The last nwin samples of the stream
+}  KurtState;
+
+
+/*******************************************************************************
+**    Core functions for working with the Pick concept - "saopick.c"
+**  initKurt(..)      - start streaming kurtosis of a sliding window
+**  streamKurt(..)    - kurtosis of next samples of a stream
+**  kurtosisCf(..)    - kurtosis of samples in a sliding window
+**  aicMin(..)        - onset by AIC of samples without a model
+**  arAic(..)         - onset by AIC of AR models prediction errors
+**  pickOnset(..)     - pick of onset in a window
+**  pickBatch(..)     - picks of onsets in windows of equal length
+*/
+int
+initKurt (KurtState *ks, long nwin, float *ring);
+
+void
+streamKurt (KurtState *ks, const float *x, long n, float *cf);
+
+int
+kurtosisCf (const float *x, long n, long nwin, float *cf);
+
+long
+aicMin (const float *x, long n, float *aic);
+
+long
+arAic (const float *x, long n, int order, float *work);
+
+int
+pickOnset (const float *x, long n, long nwin, int order, float *work,
+           Pick *p);
+
+long
+pickBatch (const float *x, const long *start, long nb, long len, long nwin,
+           int order, float *work, Pick *p);
+/******************************************************************************/
 #endif /* SAOCORE_H */
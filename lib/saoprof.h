@@ -0,0 +1,102 @@
+/*******************************************************************************
+**  saoprof.h - hot-path instrumentation of SAO libraries and tools
+**      Seismicity Analysis Organizer counters and timers
+**
+**  Probes are placed in library functions and tools around stages which
+**  usually take time: opening files, reading headers, parsing and writing
+**  strings, output. Each probe counts calls, nanoseconds of monotonic clock
+**  and bytes. Functions are described in "src/core/saoprof.c".
+**
+**  Probes are compiled in only with SAO_STATS defined (make STATS=1, which
+**  is default) and are switched on at runtime by '--stats' option of a
+**  tool, so a switched off probe costs one predictable branch. Counters are
+**  kept per thread and summed in the report, so threads do not share them.
+*******************************************************************************/
+#ifndef SAOPROF_H
+#define SAOPROF_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <time.h>
+
+
+
+/*******************************************************************************
+**  Probes - stages of processing
+*/
+enum {
+  SAO_ST_FILE,                  // Input files processed by a tool
+  SAO_ST_OPEN,                  // Opening of files
+  SAO_ST_DIR,                   // Reading of directory entries
+  SAO_ST_READSACH,              // Reading of SAC headers
+  SAO_ST_MAPSAC,                // Mapping of SAC files
+  SAO_ST_SCANDATA,              // Scanning of samples
+  SAO_ST_DECONV,                // Removal of instrument response
+  SAO_ST_BEAM,                  // Beamforming of array windows
+  SAO_ST_FILTER,                // Filtering of samples
+  SAO_ST_DETECT,                // STA/LTA of samples
+  SAO_ST_PICK,                  // Picking of phase onsets
+  SAO_ST_READMOMENT,            // Parsing of Moment strings
+  SAO_ST_FORMAT,                // Formatting of Moment and info strings
+  SAO_ST_OUTPUT,                // Output of results
+  SAO_ST_ALLOC,                 // Heap allocations
+  SAO_ST_NUM
+};
+
+
+/*******************************************************************************
+**  Probe macros - declare start time, then add time and bytes to a probe
+**    SAO_PROBE_START(t)          - declare and start timer 't'
+**    SAO_PROBE_STOP(id, t, n)    - add elapsed time and 'n' bytes to probe
+**    SAO_COUNT(id, n)            - count call and 'n' bytes without time
+**  Outer probes are for functions calling each other (formatters): only
+**  the outermost call of a thread is counted, so time is not counted twice
+**    SAO_OUTER_START(t)          - declare timer 't', start it if outermost
+**    SAO_OUTER_STOP(id, t, n)    - add time and bytes if outermost
+*/
+#ifdef SAO_STATS
+extern int saoStatsOn;
+extern __thread int saoProbeNest;
+
+static inline uint64_t
+saoClock (void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+void
+saoProbeAdd (int id, uint64_t ns, uint64_t bytes);
+
+#define SAO_PROBE_START(t)        uint64_t t = saoStatsOn ? saoClock() : 0
+#define SAO_PROBE_STOP(id, t, n)  do { if (saoStatsOn) \
+          saoProbeAdd((id), saoClock() - (t), (n)); } while (0)
+#define SAO_COUNT(id, n)          do { if (saoStatsOn) \
+          saoProbeAdd((id), 0, (n)); } while (0)
+#define SAO_OUTER_START(t)        uint64_t t = (saoStatsOn && \
+          saoProbeNest++ == 0) ? saoClock() : 0
+#define SAO_OUTER_STOP(id, t, n)  do { if (saoStatsOn && \
+          --saoProbeNest == 0) saoProbeAdd((id), saoClock() - (t), (n)); \
+          } while (0)
+#else
+#define SAO_PROBE_START(t)
+#define SAO_PROBE_STOP(id, t, n)  ((void)0)
+#define SAO_COUNT(id, n)          ((void)0)
+#define SAO_OUTER_START(t)
+#define SAO_OUTER_STOP(id, t, n)  ((void)0)
+#endif
+
+
+/*******************************************************************************
+**    Functions for tools (available with and without SAO_STATS):
+**  saoStatsArg(..)   - remove '--stats' from arguments and switch probes on
+**  saoStatsReport(..) - print JSON summary of all probes
+*/
+int
+saoStatsArg (int *argc, char *argv[]);
+
+void
+saoStatsReport (FILE *f, const char *tool);
+/******************************************************************************/
+#endif /* SAOPROF_H */
@@ -6,6 +6,12 @@
 **  This header contains definitions of structures, constants and C-functions
 **  described in "src/sys/" files as follow:
 **    "saowfm.c" - IO functions for waveforms in SAC file format
+**    "saothr.c" - threads functions for parallel processing
+**    "saolod.c" - sidecar files with min/max envelopes of waveforms
+**    "saoaio.c" - asynchronous batch reading of SAC headers
+**    "saodir.c" - parallel recursive search of files in directory trees
+**    "saopz.c"  - SAC poles and zeros response files and response cache
+**    "saoring.c" - real-time ring buffers of channels in shared memory
 *******************************************************************************/
 #ifndef SAOSYS_H
 #define SAOSYS_H
@@ -13,6 +19,7 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <stdint.h>
+#include <stdatomic.h>
 
 #include "saocore.h"
 
@@ -98,11 +105,37 @@ UNDEFINED_SACH = {-12345.,  -12345.,  -12345.,  -12345.,  -12345.,
   { '-','1','2','3','4','5',' ',' ' }};
 
 
+/*******************************************************************************
+**  SAC file mapped into memory - header and data are used without copying
+*/
+typedef struct {
+  SacH     *hdr;                // Header at the begining of the file
+  float    *data;               // Samples (first component for uneven data)
+  long      npts;               // Number of samples available in the file
+  size_t    size;               // Size of the file
+}  SacMap;
+
+
+/*  Buffer size enough for SAC info string of any mode  */
+#define SAO_SACINFO_LEN 256
+
+/*  Buffer size enough for channel key "NET.STA.LOC.CHA"  */
+#define SAO_KEY_LEN 40
+
+
 /*******************************************************************************
 **    Support functions:
 **  readSacH(..)      - read header from file-stream into SacH structure
 **  getSacBegin(..)   - get begining Moment from SacH structure
 **  writeSacInfo(..)  - get info from SacH as a string of specified format
+**  mapSac(..)        - map SAC file into memory for reading
+**  unmapSac(..)      - unmap SAC file
+**  Reentrant functions - no allocation, no output, return status code
+**  (getSacBegin(..), mapSac(..) and unmapSac(..) are reentrant as well):
+**  scanSacH(..)      - read header from file-stream with status code
+**  sprintSacInfo(..) - write info from SacH into a caller's buffer
+**  getSacKey(..)     - write channel key "NET.STA.LOC.CHA" of SacH
+**  writeSac(..)      - write header and samples into SAC file
 */
 SacH
 readSacH(FILE *fsac);
@@ -112,5 +145,258 @@ getSacBegin(SacH hdr);
 
 char*
 writeSacInfo (SacH hdr, int mode);
+
+int
+scanSacH(FILE *fsac, SacH *hdr);
+
+int
+sprintSacInfo (char *buf, size_t size, SacH hdr, int mode);
+
+int
+mapSac (const char *path, SacMap *map);
+
+void
+unmapSac (SacMap *map);
+
+int
+getSacKey (char *buf, size_t size, const SacH *hdr);
+
+int
+writeSac (const char *path, const SacH *hdr, const float *data);
+/******************************************************************************/
+
+
+
+/*******************************************************************************
+**    Parallel processing functions - "saothr.c"
+**  Task is a function called for every index from 0 to number of tasks
+**  with the same context pointer. Tasks are taken by threads one by one,
+**  so order of execution is not defined.
+**  runStealing(..) gives each thread a contiguous range of indexes, the
+**  thread takes tasks from the beginning of its range and a thread with
+**  empty range steals the upper half of the largest one. Task gets number
+**  of the thread to use its own buffers (e.g. Arena) without locking.
+**  Arena is a buffer for allocations of one thread which are all freed at
+**  once by resetArena(..), after the first tasks it is one block of memory
+**  reused by all the following ones.
+**  getNumThreads(..) - get number of online processors
+**  runParallel(..)   - run tasks on a number of threads and wait for them
+**  runStealing(..)   - run tasks with work stealing of index ranges
+**  arenaAlloc(..)    - allocate memory in an arena
+**  resetArena(..)    - free all allocations of an arena at once
+**  freeArena(..)     - free memory of an arena
+*/
+typedef void (*SaoTask)(void *ctx, long i);
+typedef void (*SaoWorkTask)(void *ctx, long i, int thread);
+
+typedef struct ArenaBlock {
+  struct ArenaBlock *next;      // Previous (full) block
+  size_t    size,  used;
+}  ArenaBlock;
+
+typedef struct {
+  ArenaBlock *head;             // Current block, zero filled for empty arena
+  size_t    total;              // Size of all blocks
+}  Arena;
+
+int
+getNumThreads (void);
+
+int
+runParallel (int nthreads, long ntasks, SaoTask task, void *ctx);
+
+int
+runStealing (int nthreads, long ntasks, SaoWorkTask task, void *ctx);
+
+void*
+arenaAlloc (Arena *a, size_t size);
+
+void
+resetArena (Arena *a);
+
+void
+freeArena (Arena *a);
+/******************************************************************************/
+
+
+
+/*******************************************************************************
+**    Sidecar envelope files - "saolod.c"
+**  Envelope pyramid of "FILE.sac" is stored next to it as "FILE.sac.lod"
+**  File keeps size and modification time of the SAC file to detect changes.
+**  Levels are mapped from sidecar file, see Envelope concept in "saocore.h"
+**  writeEnvelope(..) - build envelope of SAC file and write sidecar file
+**  mapEnvelope(..)   - map sidecar file of SAC file if it is up to date
+**  unmapEnvelope(..) - unmap sidecar file
+*/
+typedef struct {
+  Envelope  env;                // Envelope with levels inside the mapping
+  void     *map;                // Mapped sidecar file
+  size_t    size;               // Size of the mapping
+}  EnvMap;
+
+int
+writeEnvelope (const char *path, int base);
+
+int
+mapEnvelope (const char *path, EnvMap *emap);
+
+void
+unmapEnvelope (EnvMap *emap);
+/******************************************************************************/
+
+
+
+/*******************************************************************************
+**    Batch reading of SAC headers - "saoaio.c"
+**  Headers of many files are read at once (io_uring on Linux, threads
+**  otherwise) and passed to a callback in order of files, so a header scan
+**  is limited by the device and not by latency of each open/read.
+**  readSacHs(..)     - read headers of many files and pass them to a callback
+*/
+typedef void (*SacHCallback)(void *ctx, long i, int status, const SacH *hdr);
+
+long
+readSacHs (char **paths, long n, int nthreads, SacHCallback cb, void *ctx);
+/******************************************************************************/
+
+
+
+/*******************************************************************************
+**    Recursive search of files - "saodir.c"
+**  Directory tree is read by several threads with work stealing, files are
+**  filtered by a glob of name and/or a regular expression of relative path.
+**  findFiles(..)     - find files matching filters in a directory tree
+**  freeFiles(..)     - free list of files from findFiles(..)
+*/
+long
+findFiles (const char *root, const char *glob, const char *regex,
+           int nthreads, char ***files);
+
+void
+freeFiles (char **files, long n);
+/******************************************************************************/
+
+
+
+/*******************************************************************************
+**    Response cache - "saopz.c"
+**  Responses (see Response concept in "saocore.h") are loaded from SAC PZ
+**  files once and found by channel key and epoch time for each trace
+**  loadPZ(..)        - load SAC PZ file(s) into response cache
+**  findResponse(..)  - find response of a channel at a moment in the cache
+**  freeRespCache(..) - free responses of the cache
+*/
+typedef struct {
+  char      key[SAO_KEY_LEN];   // Channel "NET.STA.LOC.CHA"
+  double    t1,  t2;            // Epoch times of beginning and end
+  Response  resp;
+}  RespEntry;
+
+typedef struct {
+  RespEntry *entry;             // Responses sorted by key and beginning
+  long      n,    cap;
+}  RespCache;
+
+long
+loadPZ (RespCache *c, const char *path);
+
+const Response*
+findResponse (const RespCache *c, const char *key, double epoch);
+
+void
+freeRespCache (RespCache *c);
+/******************************************************************************/
+
+
+/*******************************************************************************
+**    Real-time ring buffers - "saoring.c"
+**  Live samples of channels are kept in one shared memory segment: header,
+**  table of channels and a ring of RING capacity samples for each channel.
+**  Sample is addressed by its sequence number since the first sample of
+**  the channel, so its epoch time is t0 + seq * delta and stays continuous.
+**  Producers (any number of threads or processes) reserve sequences with
+**  one atomic operation and publish them in order of reservation, gaps are
+**  filled with NaN and overlaps are dropped. Consumers never block
+**  producers: each one keeps its own RingCursor, and samples overwritten
+**  before they are read are counted as lost. Waiting consumers are woken
+**  by a futex on Linux and poll otherwise.
+**  Packets of the ingest socket or pipe are RingPacket followed by nsamp
+**  float samples (native byte order).
+**  createRing(..)    - create shared memory segment with empty channels
+**  openRing(..)      - open existing segment for reading and writing
+**  closeRing(..)     - unmap segment and optionally remove it
+**  unlinkRing(..)    - remove segment name, mappings stay valid
+**  writeRing(..)     - add samples of a channel (channel is created once)
+**  attachRing(..)    - set cursor to a channel of the segment
+**  readRing(..)      - copy new samples of a cursor
+**  waitRing(..)      - wait for new samples of a cursor
+*/
+#define RING_MAGIC  0x474E5253  // "SRNG"
+#define PACKET_MAGIC 0x54435053 // "SPCT"
+
+typedef struct {
+  uint32_t  magic;              // PACKET_MAGIC
+  int32_t   nsamp;              // Number of samples after the packet
+  char      key[SAO_KEY_LEN];   // Channel "NET.STA.LOC.CHA"
+  double    epoch;              // Epoch time of the first sample
+  double    delta;              // Sampling interval, s
+}  RingPacket;
+
+typedef struct {
+  char      key[SAO_KEY_LEN];   // Channel "NET.STA.LOC.CHA"
+  atomic_int        state;      // 0 - free, 1 - ready
+  double    delta,  t0;         // Sampling and epoch time of sequence 0
+  atomic_uint_fast64_t reserve; // Next sequence reserved by producers
+  atomic_uint_fast64_t head;    // Next sequence published to consumers
+  atomic_uint       wake;       // Futex word, changed on each publishing
+  atomic_uint       waiters;    // Consumers waiting on the futex
+  uint64_t  offset;             // Offset of samples in the segment
+}  RingChan;
+
+typedef struct {
+  uint32_t  magic;              // RING_MAGIC
+  int32_t   nchan;              // Size of table of channels
+  int64_t   cap;                // Samples of each ring (power of two)
+  atomic_flag       lock;       // Lock of creation of channels
+  RingChan  chan[];
+}  RingHdr;
+
+typedef struct {
+  RingHdr  *hdr;                // Mapped segment
+  size_t    size;
+}  SaoRing;
+
+typedef struct {
+  const SaoRing  *ring;
+  RingChan *chan;
+  uint64_t  seq;                // Next sequence to read
+  uint64_t  lost;               // Samples overwritten before reading
+}  RingCursor;
+
+int
+createRing (SaoRing *r, const char *name, int nchan, long cap);
+
+int
+openRing (SaoRing *r, const char *name);
+
+void
+closeRing (SaoRing *r, const char *name);
+
+void
+unlinkRing (const char *name);
+
+int
+writeRing (SaoRing *r, const char *key, double epoch, double delta,
+           const float *x, long n);
+
+int
+attachRing (const SaoRing *r, const char *key, int last, RingCursor *c);
+
+long
+readRing (RingCursor *c, float *x, long n, double *epoch);
+
+int
+waitRing (RingCursor *c, double timeout);
 /******************************************************************************/
 #endif /* SAOSYS_H */
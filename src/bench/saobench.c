@@ -0,0 +1,503 @@
+/*******************************************************************************
+**  saobench.c - Microbenchmark and Throughput Benchmark Suite
+**      Part of Seismicity Analysis Organizer
+**
+**  Harness measures library functions of hot paths in ns per operation and
+**  end-to-end runs of console tools over a generated synthetic archive.
+**  Every benchmark is run several times after warm-up runs, so mean,
+**  standard deviation and minimum are reported for comparison of builds.
+**  Program info and usage described in programInfo(..) functions
+*******************************************************************************/
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <spawn.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+
+#include "../../lib/saocore.h"
+#include "../../lib/saosys.h"
+
+extern char **environ;
+
+
+
+/*******************************************************************************
+**    Print program info and usage
+**      IN: 0 - program usage and info, 1 - full list of options
+*/
+void
+programInfo (int full)
+{
+  char *fullinfo =
+  "Microbenchmark and Throughput Benchmark Suite.\n"
+  "Measure time functions and SAC header reading of SAO libraries in ns\n"
+  "per operation, then generate synthetic SAC archive and timestamp file\n"
+  "in DIR and measure 'sacinfo' and 'utc' tools in files/s and MB/s.\n\n"
+  "Options:\n"
+  "  -r=REPS        measured repetitions of each benchmark, default 10\n"
+  "  -w=WARMUP      warm-up repetitions (not reported), default 2\n"
+  "  -i=ITERS       operations per repetition of microbenchmarks, 1000000\n"
+  "  -f=FILES       number of files in synthetic archive, default 1000\n"
+  "  -n=NPTS        samples in each synthetic SAC file, default 60000\n"
+  "  -d=DIR         directory for synthetic data, default temporary one\n"
+  "                 (it is removed at the end only if saobench created it)\n"
+  "  -b=BIN         directory with SAO tools, default 'bin'\n"
+  "  -m             machine-readable output (comma separated values)\n"
+  "  -h             display this help and exit\n\n"
+  "Machine-readable output columns:\n"
+  "  benchmark,unit,mean,stddev,min,reps,throughput,throughput unit\n\n"
+  "Examples:\n"
+  "  $ make bench\n"
+  "  $ make bench BENCHFLAGS=\"-m -r 20\" > before.csv\n\n"
+  "Seismicity Analysis Organizer <https://github.com/ScibRam/SAO>.\n";
+
+  printf("Usage: saobench [OPTION]...\n");
+  if (full == 1) printf("%s\n", fullinfo);
+  else printf("Try 'saobench -h' for full list of options and examples\n");
+  return ;
+}
+/******************************************************************************/
+
+
+
+/*******************************************************************************
+**    Benchmark settings and shared data
+*/
+typedef struct {
+  int       reps, warmup, machine;
+  long      iters, nfiles, npts;
+  char     *dir, *bin;
+  int       owndir;             // Directory is created by the benchmark
+  char    **files;              // Synthetic SAC files
+  char     *tsfile;             // Synthetic timestamp file
+  double   *epochs;             // Random epoch times
+  Moment   *moments;            // Moments of the epoch times
+  char    (*strings)[SAO_MOMENT_LEN];  // Moment strings of several formats
+  SacH     *hdrs;               // Headers of synthetic files
+}  Bench;
+
+/*  Benchmark function - one repetition, returns number of operations  */
+typedef long (*BenchFn)(Bench *bn);
+
+/*  Sink for results, so compiler does not remove benchmarked calls  */
+volatile double SINK;
+
+
+
+/*******************************************************************************
+**    Monotonic clock in nanoseconds
+*/
+double
+nowNs (void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+/******************************************************************************/
+
+
+
+/*******************************************************************************
+**    Run benchmark and report results
+**      IN1: Benchmark settings
+**      IN2: Name of benchmark
+**      IN3: Benchmark function
+**      IN4: Mode of report:
+**            'o' - ns per operation and operations/s
+**            'f' - ms per run and files/s, MB/s (bytes per run in IN5)
+**            'r' - ms per run and tool runs/s
+**      IN5: Bytes processed by one repetition (for 'f' mode)
+**  Warm-up repetitions are run first, then mean and standard deviation are
+**  calculated for the measured ones
+*/
+void
+runBench (Bench *bn, const char *name, BenchFn fn, int mode, double bytes)
+{
+  double t, sum = 0.0, sum2 = 0.0, min = INFINITY, mean, sd, val;
+  long ops = 1;   int r;
+
+  for (r = 0; r < bn->warmup; r++) fn(bn);
+  for (r = 0; r < bn->reps; r++) {
+    t = nowNs();
+    ops = fn(bn);
+    t = nowNs() - t;
+    val = (mode == 'o') ? t / ops : t / 1e6;
+    sum += val;   sum2 += val * val;
+    if (val < min) min = val;
+  }
+  mean = sum / bn->reps;
+  sd = (bn->reps > 1) ? sqrt(fmax(0.0, (sum2 - sum * mean) / (bn->reps - 1)))
+                      : 0.0;
+
+  if (mode == 'o') {
+    if (bn->machine)
+      printf("%s,ns/op,%.2f,%.2f,%.2f,%d,%.0f,op/s\n",
+             name, mean, sd, min, bn->reps, 1e9 / mean);
+    else
+      printf("%-24s %10.2f ns/op  +- %8.2f  (min %.2f)  %12.0f op/s\n",
+             name, mean, sd, min, 1e9 / mean);
+  }
+  else if (mode == 'r') {
+    if (bn->machine)
+      printf("%s,ms,%.3f,%.3f,%.3f,%d,%.1f,runs/s\n",
+             name, mean, sd, min, bn->reps, ops * 1e3 / mean);
+    else
+      printf("%-24s %10.3f ms/run  +- %8.3f  (min %.3f)  %10.1f runs/s\n",
+             name, mean, sd, min, ops * 1e3 / mean);
+  }
+  else {
+    if (bn->machine) {
+      printf("%s,ms,%.3f,%.3f,%.3f,%d,%.1f,files/s\n",
+             name, mean, sd, min, bn->reps, ops * 1e3 / mean);
+      printf("%s,ms,%.3f,%.3f,%.3f,%d,%.2f,MB/s\n",
+             name, mean, sd, min, bn->reps, bytes / 1e3 / mean);
+    }
+    else
+      printf("%-24s %10.3f ms/run  +- %8.3f  (min %.3f)  %10.1f files/s"
+             "  %8.2f MB/s\n", name, mean, sd, min,
+             ops * 1e3 / mean, bytes / 1e3 / mean);
+  }
+  fflush(stdout);
+}
+/******************************************************************************/
+
+
+
+/*******************************************************************************
+**    Microbenchmarks of library functions
+*/
+long
+benchFromEpoch (Bench *bn)
+{
+  long i;   double s = 0.0;
+  for (i = 0; i < bn->iters; i++) s += fromEpoch(bn->epochs[i]).msec;
+  SINK = s;
+  return bn->iters;
+}
+
+long
+benchToEpoch (Bench *bn)
+{
+  long i;   double s = 0.0;
+  for (i = 0; i < bn->iters; i++) s += toEpoch(bn->moments[i]);
+  SINK = s;
+  return bn->iters;
+}
+
+long
+benchReadMoment (Bench *bn)
+{
+  long i;   double s = 0.0;
+  for (i = 0; i < bn->iters; i++) s += readMoment(bn->strings[i]).sec;
+  SINK = s;
+  return bn->iters;
+}
+
+long
+benchWriteMoment (Bench *bn)
+{
+  static const char *fmt[] = { "ORD", "STD", "SAC", "SAO", "ISO" };
+  long i;   double s = 0.0;   char *buf;
+  for (i = 0; i < bn->iters; i++) {
+    buf = writeMoment(bn->moments[i], fmt[i % 5]);
+    s += buf[0];
+    free(buf);
+  }
+  SINK = s;
+  return bn->iters;
+}
+
+long
+benchSprintMoment (Bench *bn)
+{
+  static const char *fmt[] = { "ORD", "STD", "SAC", "SAO", "ISO" };
+  long i;   double s = 0.0;   char buf[SAO_MOMENT_LEN];
+  for (i = 0; i < bn->iters; i++)
+    s += sprintMoment(buf, sizeof(buf), bn->moments[i], fmt[i % 5]);
+  SINK = s;
+  return bn->iters;
+}
+
+long
+benchGetSacBegin (Bench *bn)
+{
+  long i;   double s = 0.0;
+  for (i = 0; i < bn->iters; i++)
+    s += getSacBegin(bn->hdrs[i % bn->nfiles]).msec;
+  SINK = s;
+  return bn->iters;
+}
+
+long
+benchReadSacH (Bench *bn)
+{
+  long i;   double s = 0.0;   FILE *fsac;
+  for (i = 0; i < bn->nfiles; i++)
+    if ((fsac = fopen(bn->files[i], "rb")) != NULL) {
+      s += readSacH(fsac).npts;
+      fclose(fsac);
+    }
+  SINK = s;
+  return bn->nfiles;
+}
+/******************************************************************************/
+
+
+
+/*******************************************************************************
+**    Run tool with arguments, standard output goes to /dev/null
+**      OUT: Exit status of the tool or -1
+**      IN:  NULL-terminated arguments, the first one is path to the tool
+*/
+int
+runTool (char **args)
+{
+  posix_spawn_file_actions_t fa;   pid_t pid;   int status = -1;
+  posix_spawn_file_actions_init(&fa);
+  posix_spawn_file_actions_addopen(&fa, 1, "/dev/null", O_WRONLY, 0);
+  if (posix_spawn(&pid, args[0], &fa, NULL, args, environ) == 0)
+    waitpid(pid, &status, 0);
+  posix_spawn_file_actions_destroy(&fa);
+  return status;
+}
+/******************************************************************************/
+
+
+
+/*******************************************************************************
+**    End-to-end benchmarks of tools - files are passed by 1000 per run,
+**  the same way as 'xargs' does
+*/
+#define ARGS_PER_RUN 1000
+
+long
+benchSacinfoMode (Bench *bn, const char *opt)
+{
+  char tool[4096], **args;   long i, n, k;
+  snprintf(tool, sizeof(tool), "%s/sacinfo", bn->bin);
+  args = (char**) malloc((ARGS_PER_RUN + 3) * sizeof(char*));
+  for (i = 0; i < bn->nfiles; i += n) {
+    n = (bn->nfiles - i < ARGS_PER_RUN) ? bn->nfiles - i : ARGS_PER_RUN;
+    args[0] = tool;   args[1] = (char*) opt;
+    for (k = 0; k < n; k++) args[2 + k] = bn->files[i + k];
+    args[2 + n] = NULL;
+    if (runTool(args) != 0) {
+      fprintf(stderr, "Can not run '%s %s'\n", tool, opt);
+      exit(1);
+    }
+  }
+  free(args);
+  return bn->nfiles;
+}
+
+long
+benchSacinfo (Bench *bn)
+{
+  return benchSacinfoMode(bn, "-s");
+}
+
+long
+benchSacinfoCheck (Bench *bn)
+{
+  return benchSacinfoMode(bn, "-c");
+}
+
+long
+benchUtc (Bench *bn)
+{
+  char tool[4096], line[64], *args[3];   long n = 0;   FILE *fts;
+  snprintf(tool, sizeof(tool), "%s/utc", bn->bin);
+  if ((fts = fopen(bn->tsfile, "r")) == NULL) exit(1);
+  while (fgets(line, sizeof(line), fts) != NULL) {
+    line[strcspn(line, "\n")] = '\0';
+    args[0] = tool;   args[1] = line;   args[2] = NULL;
+    if (runTool(args) != 0) {
+      fprintf(stderr, "Can not run '%s'\n", tool);
+      exit(1);
+    }
+    n++;
+  }
+  fclose(fts);
+  return n;
+}
+/******************************************************************************/
+
+
+
+/*******************************************************************************
+**    Generate synthetic data
+**  Epoch times are uniform in 1900-2100, strings are in all formats
+**  SAC files are undefined headers with station/time fields and sine data
+**  Timestamp file has one SAO string per line for 'utc' runs
+*/
+uint64_t
+nextRandom (uint64_t *x)
+{
+  uint64_t z = (*x += 0x9E3779B97F4A7C15ULL);
+  z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+  z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+  return z ^ (z >> 31);
+}
+
+void
+makeData (Bench *bn)
+{
+  static const char *fmt[] = { "ORD", "STD", "SAC", "SAO", "ISO" };
+  uint64_t seed = 2019;   long i, k;   char path[4096];
+  float *data;   FILE *f;
+
+  bn->epochs  = (double*) malloc(bn->iters * sizeof(double));
+  bn->moments = (Moment*) malloc(bn->iters * sizeof(Moment));
+  bn->strings = malloc(bn->iters * SAO_MOMENT_LEN);
+  bn->files   = (char**) malloc(bn->nfiles * sizeof(char*));
+  bn->hdrs    = (SacH*) malloc(bn->nfiles * sizeof(SacH));
+  data        = (float*) malloc(bn->npts * sizeof(float));
+  if (!bn->epochs || !bn->moments || !bn->strings || !bn->files ||
+      !bn->hdrs || !data) {
+    fprintf(stderr, "Not enough memory for synthetic data\n");
+    exit(1);
+  }
+  for (i = 0; i < bn->iters; i++) {
+    bn->epochs[i] = -2208988800.0 +
+                    (nextRandom(&seed) % 6311347200000ULL) / 1000.0;
+    bn->moments[i] = fromEpoch(bn->epochs[i]);
+    sprintMoment(bn->strings[i], SAO_MOMENT_LEN, bn->moments[i], fmt[i % 5]);
+  }
+  for (k = 0; k < bn->npts; k++) data[k] = 1000.0f * sinf(k * 0.01f);
+
+  for (i = 0; i < bn->nfiles; i++) {
+    SacH hdr = UNDEFINED_SACH;
+    Moment t = bn->moments[i % bn->iters];
+    hdr.delta = 0.01f;    hdr.b = 0.0f;   hdr.e = 0.01f * (bn->npts - 1);
+    hdr.depmin = -1000.0f;   hdr.depmax = 1000.0f;   hdr.depmen = 0.0f;
+    hdr.nzyear = t.year;  hdr.nzjday = t.yday;  hdr.nzhour = t.hour;
+    hdr.nzmin = t.min;    hdr.nzsec = t.sec;    hdr.nzmsec = t.msec;
+    hdr.internal4 = 6;    hdr.npts = bn->npts;  hdr.iftype = 1;
+    hdr.leven = 1;
+    snprintf(hdr.kstnm, 8, "S%04ld", i % 10000);
+    memcpy(hdr.knetwk, "XX      ", 8);   memcpy(hdr.kcmpnm, "HHZ     ", 8);
+    bn->hdrs[i] = hdr;
+
+    snprintf(path, sizeof(path), "%s/syn%06ld.sac", bn->dir, i);
+    bn->files[i] = strdup(path);
+    if ((f = fopen(path, "wb")) == NULL ||
+        fwrite(&hdr, sizeof(SacH), 1, f) != 1 ||
+        fwrite(data, sizeof(float), bn->npts, f) != (size_t)bn->npts) {
+      fprintf(stderr, "Can not write '%s'\n", path);
+      exit(1);
+    }
+    fclose(f);
+  }
+
+  snprintf(path, sizeof(path), "%s/timestamps.txt", bn->dir);
+  bn->tsfile = strdup(path);
+  if ((f = fopen(path, "w")) == NULL) exit(1);
+  for (i = 0; i < 200 && i < bn->iters; i++) {
+    char buf[SAO_MOMENT_LEN];
+    sprintMoment(buf, sizeof(buf), bn->moments[i], "SAO");
+    fprintf(f, "%s\n", buf);
+  }
+  fclose(f);
+  free(data);
+}
+
+void
+removeData (Bench *bn)
+{
+  long i;
+  for (i = 0; i < bn->nfiles; i++) { unlink(bn->files[i]);  free(bn->files[i]); }
+  unlink(bn->tsfile);
+  if (bn->owndir) rmdir(bn->dir);
+}
+/******************************************************************************/
+
+
+
+/*******************************************************************************
+**    Main function - detecting options, generating data and running benchmarks
+*/
+int main (int argc, char *argv[])
+{
+  char *options = "hr:w:i:f:n:d:b:m";   int opt;
+  int optdone = 0;                      Bench bn;
+  char tmpdir[] = "/tmp/saobench.XXXXXX";
+  double mb;
+
+  memset(&bn, 0, sizeof(Bench));
+  bn.reps = 10;   bn.warmup = 2;   bn.iters = 1000000;
+  bn.nfiles = 1000;   bn.npts = 60000;   bn.bin = "bin";
+  while (optdone != 1) {
+    if ((opt = getopt(argc, argv, options)) != -1) {
+      switch (opt) {
+        case 'h':
+          programInfo(1);
+          exit(0);
+        case 'r':
+          bn.reps = atoi(optarg);
+          break;
+        case 'w':
+          bn.warmup = atoi(optarg);
+          break;
+        case 'i':
+          bn.iters = atol(optarg);
+          break;
+        case 'f':
+          bn.nfiles = atol(optarg);
+          break;
+        case 'n':
+          bn.npts = atol(optarg);
+          break;
+        case 'd':
+          bn.dir = optarg;
+          break;
+        case 'b':
+          bn.bin = optarg;
+          break;
+        case 'm':
+          bn.machine = 1;
+          break;
+        default:
+          programInfo(0);
+          exit(1);
+      }
+    }
+    else optdone = 1;
+  }
+  if (bn.reps < 1 || bn.warmup < 0 || bn.iters < 1 || bn.nfiles < 1 ||
+      bn.npts < 1) {
+    programInfo(0);
+    exit(1);
+  }
+  bn.owndir = (bn.dir == NULL || mkdir(bn.dir, 0755) == 0);
+  if (bn.dir == NULL) bn.dir = mkdtemp(tmpdir);
+  if (bn.dir == NULL) { fprintf(stderr, "Can not create directory\n");  exit(1); }
+
+  makeData(&bn);
+  mb = bn.nfiles * (sizeof(SacH) + 4.0 * bn.npts);
+  if (bn.machine)
+    printf("benchmark,unit,mean,stddev,min,reps,throughput,throughput unit\n");
+  else
+    printf("SAO benchmarks: %d reps, %d warm-up, %ld iters, %ld files x %ld "
+           "samples\n", bn.reps, bn.warmup, bn.iters, bn.nfiles, bn.npts);
+
+  runBench(&bn, "fromEpoch",    benchFromEpoch,    'o', 0);
+  runBench(&bn, "toEpoch",      benchToEpoch,      'o', 0);
+  runBench(&bn, "readMoment",   benchReadMoment,   'o', 0);
+  runBench(&bn, "writeMoment",  benchWriteMoment,  'o', 0);
+  runBench(&bn, "sprintMoment", benchSprintMoment, 'o', 0);
+  runBench(&bn, "getSacBegin",  benchGetSacBegin,  'o', 0);
+  runBench(&bn, "readSacH",     benchReadSacH,     'f', bn.nfiles * sizeof(SacH));
+  runBench(&bn, "sacinfo -s",   benchSacinfo,      'f', bn.nfiles * sizeof(SacH));
+  runBench(&bn, "sacinfo -c",   benchSacinfoCheck, 'f', mb);
+  runBench(&bn, "utc",          benchUtc,          'r', 0);
+
+  removeData(&bn);
+  return 0;
+}
+/******************************************************************************/
@@ -0,0 +1,288 @@
+/*******************************************************************************
+**  saoarray.c - beamforming and FK analysis based on FkPlan structure type
+**      Part of SAO core library -> see "lib/saocore.h"
+**
+**    Core functions:
+**  arrayOffsets(..)  - offsets of stations from the array center in km
+**  initFkPlan(..)    - prepare taper and steering vectors of a grid
+**  fkWindow(..)      - power map and its maximum for one window
+**  delayAndSum(..)   - beam trace of stations for a slowness
+**  freeFkPlan(..)    - free buffers of FkPlan
+**  freeFkWork(..)    - free buffers of FkWork
+**
+**  Spectra of a window are transformed once per station, then every grid
+**  node is a sum of spectra multiplied by its steering vectors. The sum runs
+**  over frequency bins with SSE instructions when they are available (always
+**  for x86-64), four bins at once, rows are padded with zeros to 4 bins.
+*******************************************************************************/
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#if defined(__SSE__)
+#include <xmmintrin.h>
+#endif
+
+#include "../../lib/saocore.h"
+#include "../../lib/saoprof.h"
+
+
+
+#define KM_PER_DEG 111.195      // Kilometers in one degree of great circle
+#define FK_TAPER   0.1          // Part of window tapered at each end
+
+
+
+/*******************************************************************************
+**    Offsets of stations from the array center in km
+**      IN1: Number of stations
+**      IN2: Latitudes of stations, degrees
+**      IN3: Longitudes of stations, degrees
+**      OUT: Offsets east (x) and north (y) of stations, km
+**  Center is the mean of coordinates, flat approximation is enough for
+**  arrays up to tens of kilometers
+*/
+void
+arrayOffsets (int nsta, const double *lat, const double *lon,
+              double *x, double *y)
+{
+  double lat0 = 0.0, lon0 = 0.0, c;   int j;
+  for (j = 0; j < nsta; j++) { lat0 += lat[j];  lon0 += lon[j]; }
+  lat0 /= nsta;   lon0 /= nsta;
+  c = cos(lat0 * M_PI / 180.0);
+  for (j = 0; j < nsta; j++) {
+    x[j] = (lon[j] - lon0) * KM_PER_DEG * c;
+    y[j] = (lat[j] - lat0) * KM_PER_DEG;
+  }
+}
+/******************************************************************************/
+
+
+
+/*******************************************************************************
+**    Prepare taper and steering vectors of a grid
+**      OUT: SAO_OK, SAO_EFORMAT - incorrect parameters or no bins in the
+**           band, SAO_ESPACE - not enough memory
+**      IN1: Pointer to FkPlan structure
+**      IN2: Number of stations (at least 2)
+**      IN3: Offsets east of stations, km
+**      IN4: Offsets north of stations, km
+**      IN5: Maximum slowness of the grid, s/km
+**      IN6: Grid nodes along each slowness axis
+**      IN7: Samples in window
+**      IN8: Sampling interval, s
+**      IN9: Frequency band, Hz
+**  Node (a, b) of the grid is sy = -smax + 2 * smax * a / (nodes - 1) and
+**  sx = -smax + 2 * smax * b / (nodes - 1), maps are written row by row
+*/
+int
+initFkPlan (FkPlan *p, int nsta, const double *x, const double *y,
+            double smax, int nodes, long nwin, double delta,
+            double fmin, double fmax)
+{
+  long size, k1, k2, k, g, i, nt;   int a, b, j;
+  double df, step, sx, sy, d, ph;   float *s;
+
+  memset(p, 0, sizeof(FkPlan));
+  if (nsta < 2 || nodes < 1 || nwin < 4 || !(delta > 0.0) ||
+      !(smax > 0.0) || !(fmin < fmax))
+    return SAO_EFORMAT;
+  size = fftSize(nwin);   df = 1.0 / (size * delta);
+  k1 = (long) ceil(fmin / df);    if (k1 < 1) k1 = 1;
+  k2 = (long) floor(fmax / df);   if (k2 > size / 2) k2 = size / 2;
+  if (k2 < k1) return SAO_EFORMAT;
+
+  p->nsta = nsta;   p->nodes = nodes;   p->smax = smax;
+  p->nwin = nwin;   p->size = size;     p->delta = delta;
+  p->k1 = k1;       p->nf = k2 - k1 + 1;   p->nfv = (p->nf + 3) & ~3L;
+  p->plan  = getFftPlan(size);
+  p->taper = (float*) malloc(nwin * sizeof(float));
+  p->steer = (float*) calloc((size_t) nodes * nodes * nsta * 2 * p->nfv,
+                             sizeof(float));
+  if (p->plan == NULL || p->taper == NULL || p->steer == NULL) {
+    freeFkPlan(p);
+    return SAO_ESPACE;
+  }
+
+  nt = (long)(FK_TAPER * nwin);
+  for (i = 0; i < nwin; i++) p->taper[i] = 1.0;
+  for (i = 0; i < nt; i++)
+    p->taper[i] = p->taper[nwin-1-i] = 0.5 * (1.0 - cos(M_PI * i / nt));
+
+  step = (nodes > 1) ? 2.0 * smax / (nodes - 1) : 0.0;
+  for (a = 0; a < nodes; a++)
+    for (b = 0; b < nodes; b++) {
+      g = (long) a * nodes + b;
+      sy = (nodes > 1) ? -smax + a * step : 0.0;
+      sx = (nodes > 1) ? -smax + b * step : 0.0;
+      for (j = 0; j < nsta; j++) {
+        s = p->steer + (g * nsta + j) * 2 * p->nfv;
+        d = sx * x[j] + sy * y[j];
+        for (k = 0; k < p->nf; k++) {
+          ph = 2.0 * M_PI * (k1 + k) * df * d;
+          s[k] = cos(ph);   s[p->nfv + k] = sin(ph);
+        }
+      }
+    }
+  return SAO_OK;
+}
+/******************************************************************************/
+
+
+
+/*******************************************************************************
+**    Beam power of one grid node, sum over bins of |sum of steered spectra|^2
+*/
+static double
+nodePower (const FkPlan *p, FkWork *w, long g)
+{
+  long nfv = p->nfv, k;   int j;   double pw = 0.0;
+  const float *s, *x;   float *br = w->beam, *bi = w->beam + nfv;
+
+  memset(w->beam, 0, 2 * nfv * sizeof(float));
+  for (j = 0; j < p->nsta; j++) {
+    s = p->steer + (g * p->nsta + j) * 2 * nfv;
+    x = w->spec + (long) j * 2 * nfv;
+#if defined(__SSE__)
+    for (k = 0; k < nfv; k += 4) {
+      __m128 xr = _mm_loadu_ps(x + k),  xi = _mm_loadu_ps(x + nfv + k);
+      __m128 sr = _mm_loadu_ps(s + k),  si = _mm_loadu_ps(s + nfv + k);
+      _mm_storeu_ps(br + k, _mm_add_ps(_mm_loadu_ps(br + k),
+                    _mm_sub_ps(_mm_mul_ps(xr, sr), _mm_mul_ps(xi, si))));
+      _mm_storeu_ps(bi + k, _mm_add_ps(_mm_loadu_ps(bi + k),
+                    _mm_add_ps(_mm_mul_ps(xr, si), _mm_mul_ps(xi, sr))));
+    }
+#else
+    for (k = 0; k < nfv; k++) {
+      br[k] += x[k] * s[k] - x[nfv+k] * s[nfv+k];
+      bi[k] += x[k] * s[nfv+k] + x[nfv+k] * s[k];
+    }
+#endif
+  }
+  for (k = 0; k < nfv; k++) pw += (double) br[k] * br[k] + bi[k] * bi[k];
+  return pw;
+}
+/******************************************************************************/
+
+
+
+/*******************************************************************************
+**    Power map and its maximum for one window
+**      OUT: SAO_OK or SAO_ESPACE if there is no memory for buffers
+**      IN1: Pointer to FkPlan structure
+**      IN2: Pointer to FkWork structure (zero filled before first use and
+**           used with one plan only)
+**      IN3: Samples of stations, time aligned
+**      IN4: Index of the first sample of the window
+**      OUT: Relative power of grid nodes, nodes^2 values (may be NULL)
+**      OUT: Pointer to FkPeak structure with the maximum of the map
+**  Relative power is beam power divided by the sum of station powers
+**  and number of stations, it is 1 for identical traces with no delays
+*/
+int
+fkWindow (const FkPlan *p, FkWork *w, const float **tr, long first,
+          float *map, FkPeak *peak)
+{
+  long nfv = p->nfv, ng = (long) p->nodes * p->nodes, g, k, i, best = 0;
+  double *buf, mean, tot = 0.0, pw, pmax = -1.0, step;   float *x;   int j;
+  SAO_PROBE_START(t0);
+
+  if (w->buf == NULL) {
+    w->buf  = (double*) malloc((p->size + 2) * sizeof(double));
+    w->spec = (float*) calloc((size_t) p->nsta * 2 * nfv, sizeof(float));
+    w->beam = (float*) malloc(2 * nfv * sizeof(float));
+    if (w->buf == NULL || w->spec == NULL || w->beam == NULL) {
+      freeFkWork(w);
+      return SAO_ESPACE;
+    }
+  }
+
+  buf = w->buf;
+  for (j = 0; j < p->nsta; j++) {
+    for (i = 0, mean = 0.0; i < p->nwin; i++) mean += tr[j][first + i];
+    mean /= p->nwin;
+    for (i = 0; i < p->nwin; i++)
+      buf[i] = (tr[j][first + i] - mean) * p->taper[i];
+    memset(buf + p->nwin, 0, (p->size + 2 - p->nwin) * sizeof(double));
+    fftReal(p->plan, buf);
+    x = w->spec + (long) j * 2 * nfv;
+    for (k = 0; k < p->nf; k++) {
+      x[k] = buf[2 * (p->k1 + k)];   x[nfv + k] = buf[2 * (p->k1 + k) + 1];
+      tot += (double) x[k] * x[k] + (double) x[nfv + k] * x[nfv + k];
+    }
+  }
+
+  for (g = 0; g < ng; g++) {
+    pw = nodePower(p, w, g);
+    if (pw > pmax) { pmax = pw;  best = g; }
+    if (map != NULL) map[g] = (tot > 0.0) ? pw / (p->nsta * tot) : 0.0;
+  }
+
+  step = (p->nodes > 1) ? 2.0 * p->smax / (p->nodes - 1) : 0.0;
+  peak->relpow = (tot > 0.0) ? pmax / (p->nsta * tot) : 0.0;
+  peak->abspow = pmax / ((double) p->nsta * p->nsta * p->nf);
+  peak->sy = (p->nodes > 1) ? -p->smax + (best / p->nodes) * step : 0.0;
+  peak->sx = (p->nodes > 1) ? -p->smax + (best % p->nodes) * step : 0.0;
+  peak->slow = hypot(peak->sx, peak->sy);
+  peak->baz = atan2(-peak->sx, -peak->sy) * 180.0 / M_PI;
+  if (peak->baz < 0.0) peak->baz += 360.0;
+  SAO_PROBE_STOP(SAO_ST_BEAM, t0, p->nsta * p->nwin * sizeof(float));
+  return SAO_OK;
+}
+/******************************************************************************/
+
+
+
+/*******************************************************************************
+**    Beam trace of stations for a slowness (delay and sum)
+**      IN1: Samples of stations, time aligned
+**      IN2: Number of stations
+**      IN3: Number of samples of each station and of the beam
+**      IN4: Offsets east of stations, km
+**      IN5: Offsets north of stations, km
+**      IN6: Slowness east, s/km
+**      IN7: Slowness north, s/km
+**      IN8: Sampling interval, s
+**      OUT: Beam samples, mean of stations shifted back by their delays
+**  Fractional delays are done by linear interpolation, samples out of
+**  traces are taken as zeros
+*/
+void
+delayAndSum (const float **tr, int nsta, long npts, const double *x,
+             const double *y, double sx, double sy, double delta, float *beam)
+{
+  long i, m, lo, hi;   int j;   double sh;   float f, scale = 1.0f / nsta;
+  const float *u;
+
+  memset(beam, 0, npts * sizeof(float));
+  for (j = 0; j < nsta; j++) {
+    sh = (sx * x[j] + sy * y[j]) / delta;
+    m = (long) floor(sh);   f = (float)(sh - m);   u = tr[j];
+    lo = (m < 0) ? -m : 0;
+    hi = (npts - 1 - m < npts) ? npts - 1 - m : npts;
+    for (i = lo; i < hi; i++)
+      beam[i] += scale * ((1.0f - f) * u[i + m] + f * u[i + m + 1]);
+  }
+}
+/******************************************************************************/
+
+
+
+/*******************************************************************************
+**    Free buffers of FkPlan and FkWork
+**      IN:  Pointer to the structure, it is zero filled after the call
+*/
+void
+freeFkPlan (FkPlan *p)
+{
+  free(p->taper);   free(p->steer);
+  memset(p, 0, sizeof(FkPlan));
+}
+
+void
+freeFkWork (FkWork *w)
+{
+  free(w->buf);   free(w->spec);   free(w->beam);
+  memset(w, 0, sizeof(FkWork));
+}
+/******************************************************************************/
@@ -0,0 +1,193 @@
+/*******************************************************************************
+**  saoenv.c - min/max level-of-detail pyramid based on Envelope structure type
+**      Part of SAO core library -> see "lib/saocore.h"
+**
+**    Core functions:
+**  initEnvelope(..)  - set trace parameters and count levels
+**  setEnvelope(..)   - set pointers to levels in a buffer of pairs
+**  buildEnvelope(..) - calculate all levels from trace samples
+**  pickEnvelope(..)  - select level and blocks for time range and pixels
+**
+**  Level 0 is the only pass over trace samples, so it is done with SSE
+**  instructions when they are available (always for x86-64). Broken samples
+**  are skipped, blocks of only broken ones are NaN pairs (gaps).
+*******************************************************************************/
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#if defined(__SSE__)
+#include <xmmintrin.h>
+#endif
+
+#include "../../lib/saocore.h"
+
+
+
+/*******************************************************************************
+**    Set trace parameters and count levels
+**      OUT: Total number of min/max pairs in all levels (0 for bad input)
+**      IN1: Pointer to Envelope structure
+**      IN2: Number of samples in the trace
+**      IN3: Samples per block of level 0, power of two not less than 4
+**      IN4: Epoch time of the first sample
+**      IN5: Sampling interval
+**  Each level has ceil(len/2) blocks of the previous one until one is left
+**  Pointers to levels are not set here - see setEnvelope(..)
+*/
+long
+initEnvelope (Envelope *env, long npts, int base, double b, double delta)
+{
+  long len, total = 0;
+  memset(env, 0, sizeof(Envelope));
+  if (npts <= 0 || base < 4 || (base & (base - 1)) != 0) return 0;
+  env->npts = npts;   env->base = base;
+  env->b = b;         env->delta = delta;
+  len = (npts + base - 1) / base;
+  while (env->nlev < ENV_MAXLEV) {
+    env->len[env->nlev++] = len;
+    total += len;
+    if (len == 1) break;
+    len = (len + 1) / 2;
+  }
+  return total;
+}
+/******************************************************************************/
+
+
+
+/*******************************************************************************
+**    Set pointers to levels in a buffer of pairs
+**      IN1: Pointer to Envelope structure after initEnvelope(..)
+**      IN2: Buffer of 2 * (total number of pairs) floats
+**  Levels are placed one by one from the finest (level 0) to the coarsest
+*/
+void
+setEnvelope (Envelope *env, float *buf)
+{
+  int k;
+  for (k = 0; k < env->nlev; k++) {
+    env->lev[k] = buf;
+    buf += 2 * env->len[k];
+  }
+}
+/******************************************************************************/
+
+
+
+/*******************************************************************************
+**    Minimum and maximum of one block of samples
+**      IN1: Pointer to samples
+**      IN2: Number of samples (full blocks are multiple of 4)
+**      OUT: Pointer to min/max pair, NaN pair if there are no finite samples
+**  Broken samples (NaN and infinity) are skipped, so a block gives the same
+**  pair wherever they are in it.
+*/
+static inline void
+blockMinMax (const float *x, long n, float *pair)
+{
+  long j = 0;   float mn = INFINITY, mx = -INFINITY;
+#if defined(__SSE__)
+  if (n >= 4) {
+    const __m128 vinf = _mm_set1_ps(INFINITY), vninf = _mm_set1_ps(-INFINITY);
+    const __m128 vsign = _mm_set1_ps(-0.0f);
+    __m128 vmin = vinf, vmax = vninf, v, ok;
+    for (; j + 4 <= n; j += 4) {
+      v = _mm_loadu_ps(x + j);
+      ok = _mm_cmplt_ps(_mm_andnot_ps(vsign, v), vinf);
+      vmin = _mm_min_ps(vmin, _mm_or_ps(_mm_and_ps(ok, v),
+                                        _mm_andnot_ps(ok, vinf)));
+      vmax = _mm_max_ps(vmax, _mm_or_ps(_mm_and_ps(ok, v),
+                                        _mm_andnot_ps(ok, vninf)));
+    }
+    vmin = _mm_min_ps(vmin, _mm_movehl_ps(vmin, vmin));
+    vmax = _mm_max_ps(vmax, _mm_movehl_ps(vmax, vmax));
+    vmin = _mm_min_ss(vmin, _mm_shuffle_ps(vmin, vmin, 1));
+    vmax = _mm_max_ss(vmax, _mm_shuffle_ps(vmax, vmax, 1));
+    mn = _mm_cvtss_f32(vmin);
+    mx = _mm_cvtss_f32(vmax);
+  }
+#endif
+  for (; j < n; j++) {
+    if (!isfinite(x[j])) continue;
+    if (x[j] < mn) mn = x[j];
+    if (x[j] > mx) mx = x[j];
+  }
+  if (mn > mx) mn = mx = NAN;                   // Gap of broken samples
+  pair[0] = mn;   pair[1] = mx;
+}
+/******************************************************************************/
+
+
+
+/*******************************************************************************
+**    Calculate all levels from trace samples
+**      IN1: Pointer to Envelope structure after initEnvelope(..)
+**      IN2: Trace samples (env->npts of them)
+**      IN3: Buffer of 2 * (total number of pairs) floats, could be mapped file
+**  Level 0 is calculated from samples block by block, the last block could
+**  be shorter. Every next level merges two pairs of the previous one.
+*/
+void
+buildEnvelope (Envelope *env, const float *data, float *buf)
+{
+  long i, n;   int k;   float *src, *dst;
+  setEnvelope(env, buf);
+  if (env->nlev == 0) return ;
+
+  dst = env->lev[0];
+  for (i = 0; i < env->len[0]; i++) {
+    n = env->npts - i * env->base;
+    if (n > env->base) n = env->base;
+    blockMinMax(data + i * env->base, n, dst + 2 * i);
+  }
+
+  for (k = 1; k < env->nlev; k++) {
+    src = env->lev[k-1];   dst = env->lev[k];
+    for (i = 0; i < env->len[k-1] / 2; i++) {
+      dst[2*i]   = fminf(src[4*i],   src[4*i+2]);
+      dst[2*i+1] = fmaxf(src[4*i+1], src[4*i+3]);
+    }
+    if (env->len[k-1] % 2 == 1) {
+      dst[2*i]   = src[4*i];
+      dst[2*i+1] = src[4*i+1];
+    }
+  }
+}
+/******************************************************************************/
+
+
+
+/*******************************************************************************
+**    Select level and blocks for time range and pixels
+**      OUT: Level number or -1 if raw samples should be plotted
+**      IN1: Pointer to Envelope structure with levels
+**      IN2: Epoch time of the range begin
+**      IN3: Epoch time of the range end
+**      IN4: Width of the plot in pixels
+**      OUT: Pointers to the first block (or sample) and number of them
+**  Selected level is the coarsest one which still has at least one block per
+**  pixel, so the plot has at most 2 * width pairs and no visible loss.
+**  If there are less samples per pixel than 'base', raw samples are better.
+*/
+int
+pickEnvelope (const Envelope *env, double t1, double t2, int width,
+              long *first, long *count)
+{
+  long i1, i2, blk;   int k = -1;
+  i1 = (long)floor((t1 - env->b) / env->delta);
+  i2 = (long)ceil((t2 - env->b) / env->delta) + 1;
+  if (i1 < 0) i1 = 0;
+  if (i2 > env->npts) i2 = env->npts;
+  if (i2 <= i1 || width <= 0) { *first = 0;  *count = 0;  return -1; }
+
+  while (k + 1 < env->nlev &&
+         ((long)env->base << (k + 1)) * width <= i2 - i1) k++;
+  if (k < 0) { *first = i1;  *count = i2 - i1;  return -1; }
+
+  blk = (long)env->base << k;
+  *first = i1 / blk;
+  *count = (i2 + blk - 1) / blk - *first;
+  return k;
+}
+/******************************************************************************/
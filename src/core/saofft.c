@@ -0,0 +1,206 @@
+/*******************************************************************************
+**  saofft.c - fast Fourier transform of real traces based on FftPlan type
+**      Part of SAO core library -> see "lib/saocore.h"
+**
+**    Core functions:
+**  fftSize(..)       - size of transform for a trace (next power of two)
+**  getFftPlan(..)    - get plan of transform of a size from the cache
+**  fftReal(..)       - spectrum of real samples (in place)
+**  fftInverse(..)    - real samples of spectrum (in place)
+**
+**  Real transform of size n is done by complex radix-2 transform of size
+**  n/2 (even and odd samples as real and imaginary parts) and one pass of
+**  splitting. Plans keep twiddle factors and bit reversal table, they are
+**  created once per size and shared by all threads, as they never change.
+*******************************************************************************/
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <pthread.h>
+
+#include "../../lib/saocore.h"
+
+
+
+static FftPlan         *plans = NULL;
+static pthread_mutex_t  plansLock = PTHREAD_MUTEX_INITIALIZER;
+
+
+
+/*******************************************************************************
+**    Size of transform for a trace (next power of two)
+**      OUT: Power of two not less than number of samples and 4
+**      IN:  Number of samples
+*/
+long
+fftSize (long n)
+{
+  long size = 4;
+  while (size < n) size *= 2;
+  return size;
+}
+/******************************************************************************/
+
+
+
+/*******************************************************************************
+**    Create plan of transform of n real samples
+*/
+static FftPlan*
+newFftPlan (long n)
+{
+  FftPlan *p = (FftPlan*) calloc(1, sizeof(FftPlan));   long m = n / 2, i, j, b;
+  if (p == NULL) return NULL;
+  p->n = n;
+  p->tw  = (double*) malloc(m * sizeof(double));
+  p->rtw = (double*) malloc((m / 2 + 1) * 2 * sizeof(double));
+  p->rev = (long*) malloc(m * sizeof(long));
+  if (p->tw == NULL || p->rtw == NULL || p->rev == NULL) {
+    free(p->tw);  free(p->rtw);  free(p->rev);  free(p);
+    return NULL;
+  }
+  for (i = 0; i < m / 2; i++) {
+    p->tw[2*i]   =  cos(2.0 * M_PI * i / m);
+    p->tw[2*i+1] = -sin(2.0 * M_PI * i / m);
+  }
+  for (i = 0; i <= m / 2; i++) {
+    p->rtw[2*i]   =  cos(2.0 * M_PI * i / n);
+    p->rtw[2*i+1] = -sin(2.0 * M_PI * i / n);
+  }
+  for (i = 0; i < m; i++) {
+    for (j = 0, b = 1; b < m; b <<= 1) j = (j << 1) | ((i & b) ? 1 : 0);
+    p->rev[i] = j;
+  }
+  return p;
+}
+/******************************************************************************/
+
+
+
+/*******************************************************************************
+**    Get plan of transform of a size from the cache
+**      OUT: Pointer to the plan or NULL if size is not a power of two (at
+**           least 4) or there is no memory
+**      IN:  Size of transform (see fftSize(..))
+**  Plan is created on the first request and kept until the program ends
+*/
+const FftPlan*
+getFftPlan (long n)
+{
+  FftPlan *p;
+  if (n < 4 || (n & (n - 1)) != 0) return NULL;
+  pthread_mutex_lock(&plansLock);
+  for (p = plans; p != NULL && p->n != n; p = p->next) ;
+  if (p == NULL && (p = newFftPlan(n)) != NULL) {
+    p->next = plans;
+    plans = p;
+  }
+  pthread_mutex_unlock(&plansLock);
+  return p;
+}
+/******************************************************************************/
+
+
+
+/*******************************************************************************
+**    Complex transform of n/2 points in place (interleaved re, im)
+**      IN1: Plan of the real transform
+**      IN2: Points
+**      IN3: -1 - forward transform, 1 - inverse transform (not scaled)
+*/
+static void
+fftComplex (const FftPlan *p, double *z, int sign)
+{
+  long m = p->n / 2, len, half, step, i, j, k;
+  double wr, wi, tr, ti, *a, *b;
+
+  for (i = 0; i < m; i++) {
+    j = p->rev[i];
+    if (j > i) {
+      tr = z[2*i];   z[2*i] = z[2*j];   z[2*j] = tr;
+      ti = z[2*i+1]; z[2*i+1] = z[2*j+1]; z[2*j+1] = ti;
+    }
+  }
+  for (len = 2; len <= m; len *= 2) {
+    half = len / 2;   step = m / len;
+    for (i = 0; i < m; i += len)
+      for (k = 0; k < half; k++) {
+        a = z + 2 * (i + k);   b = a + 2 * half;
+        wr = p->tw[2*k*step];
+        wi = (sign < 0) ? p->tw[2*k*step+1] : -p->tw[2*k*step+1];
+        tr = b[0] * wr - b[1] * wi;
+        ti = b[0] * wi + b[1] * wr;
+        b[0] = a[0] - tr;   b[1] = a[1] - ti;
+        a[0] += tr;         a[1] += ti;
+      }
+  }
+}
+/******************************************************************************/
+
+
+
+/*******************************************************************************
+**    Spectrum of real samples (in place)
+**      IN1: Plan of transform
+**      IN2: Buffer of n + 2 values with n samples at the beginning
+**  Result is n/2 + 1 complex values (re, im) from zero to Nyquist frequency
+**  without scaling. Even and odd samples are transformed as one complex
+**  trace Z, then for each pair k and n/2 - k spectra of even and odd
+**  samples are split: E = (Z[k] + Z*[n/2-k]) / 2, O = (Z[k] - Z*[n/2-k]) / 2i
+**  and X[k] = E + W^k * O,  X[n/2-k] = (E - W^k * O)*
+*/
+void
+fftReal (const FftPlan *p, double *x)
+{
+  long m = p->n / 2, k;
+  double er, ei, ur, ui, wr, wi, tr, ti, *a, *b;
+
+  fftComplex(p, x, -1);
+  x[p->n] = x[0] - x[1];   x[p->n+1] = 0.0;
+  x[0] = x[0] + x[1];      x[1] = 0.0;
+  for (k = 1; k <= m / 2; k++) {
+    a = x + 2 * k;   b = x + 2 * (m - k);
+    er = 0.5 * (a[0] + b[0]);   ei = 0.5 * (a[1] - b[1]);
+    ur = 0.5 * (a[1] + b[1]);   ui = -0.5 * (a[0] - b[0]);
+    wr = p->rtw[2*k];   wi = p->rtw[2*k+1];
+    tr = wr * ur - wi * ui;   ti = wr * ui + wi * ur;
+    a[0] = er + tr;   a[1] = ei + ti;
+    b[0] = er - tr;   b[1] = -(ei - ti);
+  }
+}
+/******************************************************************************/
+
+
+
+/*******************************************************************************
+**    Real samples of spectrum (in place)
+**      IN1: Plan of transform
+**      IN2: Buffer of n + 2 values with n/2 + 1 complex values of spectrum
+**  Result is n samples at the beginning of the buffer, scaled by 1/n, so
+**  fftInverse(..) of fftReal(..) gives the same samples. Splitting is
+**  reversed: E = (X[k] + X*[n/2-k]) / 2, O = (X[k] - X*[n/2-k]) / 2 * W^-k
+**  and Z[k] = E + i*O.
+*/
+void
+fftInverse (const FftPlan *p, double *x)
+{
+  long m = p->n / 2, k;
+  double er, ei, ur, ui, wr, wi, tr, ti, dr, di, *a, *b, scale = 1.0 / m;
+
+  er = 0.5 * (x[0] + x[p->n]);   ur = 0.5 * (x[0] - x[p->n]);
+  x[0] = er;   x[1] = ur;
+  for (k = 1; k <= m / 2; k++) {
+    a = x + 2 * k;   b = x + 2 * (m - k);
+    er = 0.5 * (a[0] + b[0]);   ei = 0.5 * (a[1] - b[1]);
+    dr = 0.5 * (a[0] - b[0]);   di = 0.5 * (a[1] + b[1]);
+    wr = p->rtw[2*k];   wi = -p->rtw[2*k+1];
+    ur = dr * wr - di * wi;   ui = dr * wi + di * wr;
+    tr = er - ui;   ti = ei + ur;           // Z[k]     = E + i*O
+    a[0] = tr;      a[1] = ti;
+    b[0] = er + ui; b[1] = -ei + ur;        // Z[m-k]   = E* + i*O*
+  }
+  fftComplex(p, x, 1);
+  for (k = 0; k < p->n; k++) x[k] *= scale;
+}
+/******************************************************************************/
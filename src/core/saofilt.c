@@ -0,0 +1,126 @@
+/*******************************************************************************
+**  saofilt.c - Butterworth filters of traces based on Filter structure type
+**      Part of SAO core library -> see "lib/saocore.h"
+**
+**    Core functions:
+**  designFilter(..)  - design Butterworth filter for a sampling interval
+**  applyFilter(..)   - filter samples in place
+**
+**  Analog prototype of order n has poles on the unit circle at angles
+**  pi * (2k + 1) / (2n) from the imaginary axis, each pair gives a section
+**  1 / (s^2 + q*s + 1) with q = 2 * sin(angle), odd order adds 1 / (s + 1).
+**  With K = tan(pi * f * delta) bilinear transform of the sections gives
+**  the well known digital coefficients used below.
+*******************************************************************************/
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+
+#include "../../lib/saocore.h"
+#include "../../lib/saoprof.h"
+
+
+
+/*******************************************************************************
+**    Add low-pass or high-pass sections of order n and corner K
+*/
+static void
+addSections (Filter *f, int hp, int n, double K)
+{
+  double q, norm, *b, *a;   int k;
+
+  for (k = 0; k < n / 2; k++) {
+    b = f->b[f->nsec];   a = f->a[f->nsec++];
+    q = 2.0 * sin(M_PI * (2 * k + 1) / (2.0 * n));
+    norm = 1.0 / (1.0 + q * K + K * K);
+    if (hp == 1) { b[0] = norm;   b[1] = -2.0 * norm; }
+    else { b[0] = K * K * norm;   b[1] = 2.0 * b[0]; }
+    b[2] = b[0];
+    a[0] = 2.0 * (K * K - 1.0) * norm;
+    a[1] = (1.0 - q * K + K * K) * norm;
+  }
+  if (n % 2 == 1) {
+    b = f->b[f->nsec];   a = f->a[f->nsec++];
+    norm = 1.0 / (1.0 + K);
+    b[0] = (hp == 1) ? norm : K * norm;
+    b[1] = (hp == 1) ? -norm : K * norm;
+    b[2] = 0.0;   a[0] = (K - 1.0) * norm;   a[1] = 0.0;
+  }
+}
+/******************************************************************************/
+
+
+
+/*******************************************************************************
+**    Design Butterworth filter for a sampling interval
+**      OUT: SAO_OK or SAO_EFORMAT - incorrect order or corners
+**      IN1: Pointer to Filter structure
+**      IN2: Type of filter FILT_LP, FILT_HP or FILT_BP
+**      IN3: Corner of low-pass or high-pass, lower corner of band-pass, Hz
+**      IN4: Upper corner of band-pass, Hz (not used by others)
+**      IN5: Order from 1 to FILT_MAXORD (of each side of band-pass)
+**      IN6: 1 - zero-phase filter, 0 - causal filter
+**      IN7: Sampling interval, s
+**  Corners must be below Nyquist frequency
+*/
+int
+designFilter (Filter *f, int type, double f1, double f2, int order,
+              int zerophase, double delta)
+{
+  double nyq = 0.5 / delta;
+
+  memset(f, 0, sizeof(Filter));
+  if (order < 1 || order > FILT_MAXORD || !(delta > 0.0) ||
+      !(f1 > 0.0 && f1 < nyq) ||
+      (type == FILT_BP && !(f2 > f1 && f2 < nyq)) ||
+      (type != FILT_LP && type != FILT_HP && type != FILT_BP))
+    return SAO_EFORMAT;
+  f->zerophase = (zerophase == 1) ? 1 : 0;
+  if (type == FILT_BP) {
+    addSections(f, 1, order, tan(M_PI * f1 * delta));
+    addSections(f, 0, order, tan(M_PI * f2 * delta));
+  }
+  else
+    addSections(f, (type == FILT_HP) ? 1 : 0, order, tan(M_PI * f1 * delta));
+  return SAO_OK;
+}
+/******************************************************************************/
+
+
+
+/*******************************************************************************
+**    Filter samples in place
+**      IN1: Pointer to Filter structure
+**      IN2: Samples, replaced by filtered ones
+**      IN3: Number of samples
+**  Sections are applied one after another in transposed direct form II
+**  with double state, backward pass of zero-phase filter starts at rest
+*/
+void
+applyFilter (const Filter *f, float *x, long n)
+{
+  const double *b, *a;   double y, v, z1, z2;   long i;   int k;
+  SAO_PROBE_START(t0);
+
+  for (k = 0; k < f->nsec; k++) {
+    b = f->b[k];   a = f->a[k];   z1 = z2 = 0.0;
+    for (i = 0; i < n; i++) {
+      v = x[i];   y = b[0] * v + z1;
+      z1 = b[1] * v - a[0] * y + z2;
+      z2 = b[2] * v - a[1] * y;
+      x[i] = (float) y;
+    }
+  }
+  for (k = 0; k < f->nsec && f->zerophase == 1; k++) {
+    b = f->b[k];   a = f->a[k];   z1 = z2 = 0.0;
+    for (i = n - 1; i >= 0; i--) {
+      v = x[i];   y = b[0] * v + z1;
+      z1 = b[1] * v - a[0] * y + z2;
+      z2 = b[2] * v - a[1] * y;
+      x[i] = (float) y;
+    }
+  }
+  SAO_PROBE_STOP(SAO_ST_FILTER, t0, n * sizeof(float));
+}
+/******************************************************************************/
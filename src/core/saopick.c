@@ -0,0 +1,499 @@
+/*******************************************************************************
+**  saopick.c - onset picking of phases based on Pick structure type
+**      Part of SAO core library -> see "lib/saocore.h"
+**
+**    Core functions:
+**  initKurt(..)      - start streaming kurtosis of a sliding window
+**  streamKurt(..)    - kurtosis of next samples of a stream
+**  kurtosisCf(..)    - kurtosis of samples in a sliding window
+**  aicMin(..)        - onset by AIC of samples without a model
+**  arAic(..)         - onset by AIC of AR models prediction errors
+**  pickOnset(..)     - pick of onset in a window
+**  pickBatch(..)     - picks of onsets in windows of equal length
+**
+**  All functions are single passes over samples with running sums (no
+**  nested loops over the window), so a pick costs a few passes over it.
+**  Samples are taken relative to their mean, broken ones (NaN and
+**  infinity) are taken as the mean. Kurtosis skips broken samples, its
+**  sums are kept relative to a reference level that follows the running
+**  mean, so a stream gives the same values as the whole trace.
+**  Kurtosis of a batch is done with SSE2 instructions when they are
+**  available (always for x86-64), two windows in each register.
+*******************************************************************************/
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include "../../lib/saocore.h"
+#include "../../lib/saoprof.h"
+
+
+
+/*  Sample relative to the mean, zero for broken ones  */
+static inline double
+value (float v, double mean)
+{
+  return isfinite(v) ? v - mean : 0.0;
+}
+
+/*  Mean of finite samples  */
+static double
+finiteMean (const float *x, long n)
+{
+  double sum = 0.0;   long i, k = 0;
+  for (i = 0; i < n; i++)
+    if (isfinite(x[i])) { sum += x[i];  k++; }
+  return (k > 0) ? sum / k : 0.0;
+}
+
+/*  Log of a variance, tiny variance of flat samples is kept finite  */
+static inline double
+logVar (double var)
+{
+  return log((var > 1e-30) ? var : 1e-30);
+}
+/******************************************************************************/
+
+
+
+/*  Shift reference level of sums to the mean of the window  */
+static void
+kurtCenter (KurtState *ks)
+{
+  double c = ks->nfin, d = ks->s1 / c, d2 = d * d;
+
+  ks->s4 += -4.0 * d * ks->s3 + 6.0 * d2 * ks->s2 - 4.0 * d2 * d * ks->s1 +
+            c * d2 * d2;
+  ks->s3 += -3.0 * d * ks->s2 + 3.0 * d2 * ks->s1 - c * d2 * d;
+  ks->s2 += -2.0 * d * ks->s1 + c * d2;
+  ks->s1 -= c * d;
+  ks->ref += d;
+}
+
+/*  Pass next sample, old one leaves the window when it is full  */
+static inline void
+kurtAdd (KurtState *ks, float x, float old)
+{
+  double v, w;
+
+  if (isfinite(x)) {
+    if (ks->nfin++ == 0) {                      // Sums restart exactly
+      ks->ref = x;   ks->s1 = ks->s2 = ks->s3 = ks->s4 = 0.0;
+    }
+    v = x - ks->ref;   w = v * v;
+    ks->s1 += v;   ks->s2 += w;   ks->s3 += w * v;   ks->s4 += w * w;
+  }
+  if (ks->n >= ks->nwin && isfinite(old)) {
+    v = old - ks->ref;   w = v * v;   ks->nfin--;
+    ks->s1 -= v;   ks->s2 -= w;   ks->s3 -= w * v;   ks->s4 -= w * w;
+  }
+  if (++ks->n % ks->nwin == 0 && ks->nfin > 0) kurtCenter(ks);
+}
+
+/*  Kurtosis of the window, 0 until it is full  */
+static inline float
+kurtValue (const KurtState *ks)
+{
+  double c = ks->nfin, m, m2, m4;
+
+  if (ks->n < ks->nwin || ks->nfin < 4) return 0.0;
+  m = ks->s1 / c;   m2 = ks->s2 / c - m * m;
+  m4 = (ks->s4 - 4.0 * m * ks->s3 + 6.0 * m * m * ks->s2) / c -
+       3.0 * m * m * m * m;
+  return (m2 > 0.0) ? m4 / (m2 * m2) : 0.0;
+}
+/******************************************************************************/
+
+
+
+/*******************************************************************************
+**    Start streaming kurtosis of a sliding window
+**      OUT: SAO_OK or SAO_EFORMAT - window shorter than 4 samples
+**      OUT: State of the stream
+**      IN2: Samples of window (at least 4)
+**      TMP: Ring of the last nwin samples, used by streamKurt(..)
+*/
+int
+initKurt (KurtState *ks, long nwin, float *ring)
+{
+  if (nwin < 4) return SAO_EFORMAT;
+  memset(ks, 0, sizeof(KurtState));
+  ks->nwin = nwin;   ks->ring = ring;
+  return SAO_OK;
+}
+/******************************************************************************/
+
+
+
+/*******************************************************************************
+**    Kurtosis of next samples of a stream
+**      I/O: State of the stream
+**      IN2: Next samples
+**      IN3: Number of samples (any, down to one)
+**      OUT: Kurtosis of window ending at each sample, 0 for the first
+**           nwin - 1 samples of the stream
+**  Cost is the same for each sample, the values are equal to the ones of
+**  kurtosisCf(..) of the whole stream.
+*/
+void
+streamKurt (KurtState *ks, const float *x, long n, float *cf)
+{
+  long i, k;   float old;
+
+  for (i = 0; i < n; i++) {
+    k = ks->n % ks->nwin;   old = ks->ring[k];   ks->ring[k] = x[i];
+    kurtAdd(ks, x[i], old);
+    cf[i] = kurtValue(ks);
+  }
+}
+/******************************************************************************/
+
+
+
+/*******************************************************************************
+**    Kurtosis of samples in a sliding window
+**      OUT: SAO_OK or SAO_EFORMAT - window shorter than 4 samples
+**      IN1: Samples
+**      IN2: Number of samples
+**      IN3: Samples of window (at least 4)
+**      OUT: Kurtosis of window ending at each sample (3 for Gaussian noise),
+**           0 for the first nwin - 1 samples
+**  Central moments are taken from running sums of powers in double
+*/
+int
+kurtosisCf (const float *x, long n, long nwin, float *cf)
+{
+  KurtState ks;   long i;
+
+  if (initKurt(&ks, nwin, NULL) != SAO_OK) return SAO_EFORMAT;
+  for (i = 0; i < n; i++) {
+    kurtAdd(&ks, x[i], (i >= nwin) ? x[i - nwin] : 0.0f);
+    cf[i] = kurtValue(&ks);
+  }
+  return SAO_OK;
+}
+/******************************************************************************/
+
+
+
+/*******************************************************************************
+**    Onset by AIC of samples without a model (Maeda, 1985)
+**      OUT: Sample of AIC minimum or SAO_EFORMAT - less than 4 samples
+**      IN1: Samples
+**      IN2: Number of samples
+**      OUT: AIC of each sample or NULL (ends are copies of their neighbours)
+**  AIC(k) = k * log(var(x[0..k])) + (n - k - 1) * log(var(x[k+1..n-1]))
+*/
+long
+aicMin (const float *x, long n, float *aic)
+{
+  double l1 = 0.0, l2 = 0.0, t1 = 0.0, t2 = 0.0, mean, v, c, best = HUGE_VAL;
+  long k, kmin = 1;
+
+  if (n < 4) return SAO_EFORMAT;
+  mean = finiteMean(x, n);
+  for (k = 0; k < n; k++) {
+    v = value(x[k], mean);   t1 += v;   t2 += v * v;
+  }
+  l1 = l2 = value(x[0], mean);   l2 *= l2;
+  for (k = 1; k < n - 1; k++) {
+    v = value(x[k], mean);   l1 += v;   l2 += v * v;
+    c = (k + 1) * logVar(l2 / (k + 1) - (l1 / (k + 1)) * (l1 / (k + 1)));
+    v = n - k - 1;
+    c += v * logVar((t2 - l2) / v - ((t1 - l1) / v) * ((t1 - l1) / v));
+    if (aic != NULL) aic[k] = c;
+    if (c < best) { best = c;  kmin = k; }
+  }
+  if (aic != NULL) { aic[0] = aic[1];   aic[n - 1] = aic[n - 2]; }
+  return kmin;
+}
+/******************************************************************************/
+
+
+
+/*******************************************************************************
+**    Fit AR model by Yule-Walker equations with Levinson recursion
+**      IN1: Samples
+**      IN2: Number of samples
+**      IN3: Mean of samples of the whole window
+**      IN4: Order of model
+**      OUT: Coefficients a[1..order], x[i] ~ sum of a[j] * x[i - j]
+*/
+static void
+fitAr (const float *x, long n, double mean, int order, double *a)
+{
+  double r[PICK_MAXORD + 1], tmp[PICK_MAXORD + 1], err, k;   long i;   int j, m;
+
+  memset(a, 0, (order + 1) * sizeof(double));
+  for (j = 0; j <= order; j++)
+    for (r[j] = 0.0, i = j; i < n; i++)
+      r[j] += value(x[i], mean) * value(x[i - j], mean);
+  if (!((err = r[0]) > 0.0)) return;
+  for (m = 1; m <= order; m++) {
+    for (k = r[m], j = 1; j < m; j++) k -= a[j] * r[m - j];
+    k /= err;
+    for (j = 1; j < m; j++) tmp[j] = a[j] - k * a[m - j];
+    for (j = 1; j < m; j++) a[j] = tmp[j];
+    a[m] = k;   err *= 1.0 - k * k;
+    if (!(err > 0.0)) break;
+  }
+}
+/******************************************************************************/
+
+
+
+/*******************************************************************************
+**    Onset by AIC of AR models prediction errors (Sleeman & van Eck, 1999)
+**      OUT: Sample of AIC minimum or SAO_EFORMAT - incorrect order or
+**           window not longer than 4 * order samples
+**      IN1: Samples, onset is expected near the middle
+**      IN2: Number of samples
+**      IN3: Order of AR models (1..PICK_MAXORD)
+**      TMP: Work array of n floats
+**  Noise model is fitted to the first half and predicts forward, signal
+**  model is fitted to the second half and predicts backward. Errors of
+**  signal model are summed from the end into work array, errors of noise
+**  model are summed from the begining while looking for the minimum.
+*/
+long
+arAic (const float *x, long n, int order, float *work)
+{
+  double an[PICK_MAXORD + 1], as[PICK_MAXORD + 1], mean, e, sn = 0.0, ss;
+  double c, best = HUGE_VAL;   long i, k, kmin, last = n - order - 1;   int j;
+
+  if (order < 1 || order > PICK_MAXORD || n <= 4 * order) return SAO_EFORMAT;
+  mean = finiteMean(x, n);
+  fitAr(x, n / 2, mean, order, an);
+  fitAr(x + n / 2, n - n / 2, mean, order, as);
+
+  for (ss = 0.0, i = last; i >= 0; i--) {        // Suffix sums of signal
+    for (e = value(x[i], mean), j = 1; j <= order; j++)
+      e -= as[j] * value(x[i + j], mean);
+    ss += e * e;   work[i] = ss;
+  }
+  kmin = order + 1;
+  for (k = order; k < last - 1; k++) {           // Prefix sums of noise
+    for (e = value(x[k], mean), j = 1; j <= order; j++)
+      e -= an[j] * value(x[k - j], mean);
+    sn += e * e;
+    if (k == order) continue;
+    c = (k - order + 1) * logVar(sn / (k - order + 1)) +
+        (last - k) * logVar(work[k + 1] / (last - k));
+    if (c < best) { best = c;  kmin = k + 1; }
+  }
+  return kmin;
+}
+/******************************************************************************/
+
+
+
+/*  Pick of onset from kurtosis in work array, which is reused by AR-AIC  */
+static int
+refinePick (const float *x, long n, long nwin, int order, float *work,
+            Pick *p)
+{
+  long i, m, lo, hi, k;   double sig = 0.0, noise = 0.0, v, mean;
+
+  for (m = i = nwin - 1; i < n; i++)
+    if (work[i] > work[m]) m = i;
+  lo = (m - 2 * nwin > 0) ? m - 2 * nwin : 0;
+  hi = (m + nwin < n) ? m + nwin : n;
+  if (hi - lo > 4 * order) k = arAic(x + lo, hi - lo, order, work);
+  else k = aicMin(x + lo, hi - lo, NULL);
+  if (k < 0) return SAO_EFORMAT;
+  k += lo;
+
+  lo = (k - nwin > 0) ? k - nwin : 0;
+  hi = (k + nwin < n) ? k + nwin : n;
+  mean = finiteMean(x + lo, hi - lo);
+  for (i = lo; i < hi; i++) {
+    v = value(x[i], mean);
+    if (i < k) noise += v * v;
+    else sig += v * v;
+  }
+  p->idx = k;
+  p->snr = (noise > 0.0 && k > lo) ?
+           sqrt((sig / (hi - k)) / (noise / (k - lo))) : 0.0;
+  p->weight = (p->snr > 10.0) ? 0 : (p->snr > 5.0) ? 1 :
+              (p->snr > 3.0) ? 2 : (p->snr > 1.5) ? 3 : 4;
+  return SAO_OK;
+}
+
+#if defined(__SSE2__)
+/*  Steps of kurtosis of all lanes while their samples are finite and the
+**  window is not recentered, returns the first step that is not done  */
+static long
+kurtFast (const float **w, KurtState *ks, long i, long len, float *cf)
+{
+  const __m128 vinf = _mm_set1_ps(INFINITY);
+  const __m128 vabs = _mm_castsi128_ps(_mm_set1_epi32(0x7FFFFFFF));
+  const __m128d one = _mm_set1_pd(1.0), three = _mm_set1_pd(3.0);
+  const __m128d four = _mm_set1_pd(4.0), six = _mm_set1_pd(6.0);
+  const __m128d zero = _mm_setzero_pd();
+  __m128d ref[2], s1[2], s2[2], s3[2], s4[2], cnt[2], v, q, m, m2, m4, ok;
+  __m128 xn, xo = _mm_setzero_ps();   double out[2];
+  long nwin = ks[0].nwin, end = (i / nwin + 1) * nwin - 1;   int h, k;
+
+  for (k = 0; k < PICK_LANES; k++)
+    if (ks[k].nfin == 0) return i;
+  if (end > len) end = len;
+  for (h = 0; h < 2; h++) {
+    ref[h] = _mm_set_pd(ks[2 * h + 1].ref, ks[2 * h].ref);
+    s1[h] = _mm_set_pd(ks[2 * h + 1].s1, ks[2 * h].s1);
+    s2[h] = _mm_set_pd(ks[2 * h + 1].s2, ks[2 * h].s2);
+    s3[h] = _mm_set_pd(ks[2 * h + 1].s3, ks[2 * h].s3);
+    s4[h] = _mm_set_pd(ks[2 * h + 1].s4, ks[2 * h].s4);
+    cnt[h] = _mm_set_pd(ks[2 * h + 1].nfin, ks[2 * h].nfin);
+  }
+
+  for (; i < end; i++) {
+    xn = _mm_set_ps(w[3][i], w[2][i], w[1][i], w[0][i]);
+    if (i >= nwin)
+      xo = _mm_set_ps(w[3][i - nwin], w[2][i - nwin], w[1][i - nwin],
+                      w[0][i - nwin]);
+    if (_mm_movemask_ps(_mm_and_ps(_mm_cmplt_ps(_mm_and_ps(xn, vabs), vinf),
+        _mm_cmplt_ps(_mm_and_ps(xo, vabs), vinf))) != 0xF)
+      break;
+    for (h = 0; h < 2; h++) {
+      v = _mm_sub_pd(_mm_cvtps_pd(xn), ref[h]);   q = _mm_mul_pd(v, v);
+      s1[h] = _mm_add_pd(s1[h], v);   s2[h] = _mm_add_pd(s2[h], q);
+      s3[h] = _mm_add_pd(s3[h], _mm_mul_pd(q, v));
+      s4[h] = _mm_add_pd(s4[h], _mm_mul_pd(q, q));
+      if (i >= nwin) {
+        v = _mm_sub_pd(_mm_cvtps_pd(xo), ref[h]);   q = _mm_mul_pd(v, v);
+        s1[h] = _mm_sub_pd(s1[h], v);   s2[h] = _mm_sub_pd(s2[h], q);
+        s3[h] = _mm_sub_pd(s3[h], _mm_mul_pd(q, v));
+        s4[h] = _mm_sub_pd(s4[h], _mm_mul_pd(q, q));
+      }
+      else cnt[h] = _mm_add_pd(cnt[h], one);
+      xn = _mm_movehl_ps(xn, xn);   xo = _mm_movehl_ps(xo, xo);
+
+      m = _mm_div_pd(s1[h], cnt[h]);
+      m2 = _mm_sub_pd(_mm_div_pd(s2[h], cnt[h]), _mm_mul_pd(m, m));
+      m4 = _mm_sub_pd(s4[h], _mm_mul_pd(_mm_mul_pd(four, m), s3[h]));
+      m4 = _mm_add_pd(m4, _mm_mul_pd(_mm_mul_pd(_mm_mul_pd(six, m), m), s2[h]));
+      v = _mm_mul_pd(_mm_mul_pd(_mm_mul_pd(three, m), m), m);
+      m4 = _mm_sub_pd(_mm_div_pd(m4, cnt[h]), _mm_mul_pd(v, m));
+      ok = _mm_and_pd(_mm_cmpge_pd(cnt[h], four), _mm_cmpgt_pd(m2, zero));
+      if (i + 1 < nwin) ok = zero;              // Window is not full yet
+      _mm_storeu_pd(out, _mm_and_pd(ok, _mm_div_pd(m4, _mm_mul_pd(m2, m2))));
+      cf[2 * h * len + i] = out[0];   cf[(2 * h + 1) * len + i] = out[1];
+    }
+  }
+
+  for (h = 0; h < 2; h++) {
+    _mm_storel_pd(&ks[2 * h].s1, s1[h]);
+    _mm_storeh_pd(&ks[2 * h + 1].s1, s1[h]);
+    _mm_storel_pd(&ks[2 * h].s2, s2[h]);
+    _mm_storeh_pd(&ks[2 * h + 1].s2, s2[h]);
+    _mm_storel_pd(&ks[2 * h].s3, s3[h]);
+    _mm_storeh_pd(&ks[2 * h + 1].s3, s3[h]);
+    _mm_storel_pd(&ks[2 * h].s4, s4[h]);
+    _mm_storeh_pd(&ks[2 * h + 1].s4, s4[h]);
+    _mm_storeu_pd(out, cnt[h]);
+    ks[2 * h].nfin = out[0];   ks[2 * h + 1].nfin = out[1];
+  }
+  for (k = 0; k < PICK_LANES; k++) ks[k].n = i;
+  return i;
+}
+#endif
+
+/*  Kurtosis of PICK_LANES windows at once, lane k goes to cf + k * len  */
+static void
+kurtLanes (const float *x, const long *start, long len, long nwin, float *cf)
+{
+  KurtState ks[PICK_LANES];   const float *w[PICK_LANES];   long i;   int k;
+
+  for (k = 0; k < PICK_LANES; k++) {
+    initKurt(&ks[k], nwin, NULL);   w[k] = x + start[k];
+  }
+  for (i = 0; i < len; i++) {
+#if defined(__SSE2__)
+    if ((i = kurtFast(w, ks, i, len, cf)) == len) break;
+#endif
+    for (k = 0; k < PICK_LANES; k++) {
+      kurtAdd(&ks[k], w[k][i], (i >= nwin) ? w[k][i - nwin] : 0.0f);
+      cf[k * len + i] = kurtValue(&ks[k]);
+    }
+  }
+}
+/******************************************************************************/
+
+
+
+/*******************************************************************************
+**    Pick of onset in a window
+**      OUT: SAO_OK or SAO_EFORMAT - incorrect parameters or short window
+**      IN1: Samples of window
+**      IN2: Number of samples (at least 3 * nwin)
+**      IN3: Samples of kurtosis window (at least 4)
+**      IN4: Order of AR models (1..PICK_MAXORD)
+**      TMP: Work array of n floats
+**      OUT: Pick of onset
+**  Kurtosis reaches its maximum when the onset is inside its window, so
+**  AR-AIC looks for the onset in 2 * nwin samples before the maximum and
+**  nwin samples after it. SNR is RMS ratio of nwin samples after and
+**  before the onset. Weight 0..4 is given for SNR over 10, 5, 3, 1.5.
+*/
+int
+pickOnset (const float *x, long n, long nwin, int order, float *work,
+           Pick *p)
+{
+  SAO_PROBE_START(t0);
+
+  if (n < 3 * nwin || kurtosisCf(x, n, nwin, work) != SAO_OK ||
+      order < 1 || order > PICK_MAXORD ||
+      refinePick(x, n, nwin, order, work, p) != SAO_OK)
+    return SAO_EFORMAT;
+  SAO_PROBE_STOP(SAO_ST_PICK, t0, n * sizeof(float));
+  return SAO_OK;
+}
+/******************************************************************************/
+
+
+
+/*******************************************************************************
+**    Picks of onsets in windows of equal length
+**      OUT: Number of picked windows or SAO_EFORMAT - incorrect parameters
+**      IN1: Samples of trace
+**      IN2: First samples of windows, each of them is inside the trace
+**      IN3: Number of windows
+**      IN4: Samples of each window (at least 3 * nwin)
+**      IN5: Samples of kurtosis window (at least 4)
+**      IN6: Order of AR models (1..PICK_MAXORD)
+**      TMP: Work array of PICK_LANES * len floats
+**      OUT: Picks of windows like pickOnset(..), idx is -1 for failed ones
+**  Kurtosis of PICK_LANES windows is done at once, AR-AIC is done for
+**  each window. Picks are equal to the ones of pickOnset(..).
+*/
+long
+pickBatch (const float *x, const long *start, long nb, long len, long nwin,
+           int order, float *work, Pick *p)
+{
+  long lane[PICK_LANES], b, k, ng, npick = 0;
+  SAO_PROBE_START(t0);
+
+  if (len < 3 * nwin || nwin < 4 || order < 1 || order > PICK_MAXORD)
+    return SAO_EFORMAT;
+  for (b = 0; b < nb; b += ng) {
+    ng = (nb - b < PICK_LANES) ? nb - b : PICK_LANES;
+    if (ng == 1) kurtosisCf(x + start[b], len, nwin, work);
+    else {                                      // Spare lanes repeat one
+      for (k = 0; k < PICK_LANES; k++) lane[k] = start[b + (k < ng ? k : 0)];
+      kurtLanes(x, lane, len, nwin, work);
+    }
+    for (k = 0; k < ng; k++) {
+      if (refinePick(x + start[b + k], len, nwin, order, work + k * len,
+                     &p[b + k]) == SAO_OK)
+        npick++;
+      else p[b + k].idx = -1;
+    }
+  }
+  SAO_PROBE_STOP(SAO_ST_PICK, t0, nb * len * sizeof(float));
+  return npick;
+}
+/******************************************************************************/
@@ -0,0 +1,151 @@
+/*******************************************************************************
+**  saoprof.c - counters and timers for hot-path instrumentation
+**      Part of SAO core library -> see "lib/saoprof.h"
+**
+**    Core functions:
+**  saoProbeAdd(..)   - add time and bytes to a probe of the current thread
+**  saoStatsArg(..)   - remove '--stats' from arguments and switch probes on
+**  saoStatsReport(..) - print JSON summary of all probes
+**
+**  Each thread gets its own block of counters on the first probe, blocks
+**  are linked into a list and summed only when the report is printed
+*******************************************************************************/
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "../../lib/saocore.h"
+#include "../../lib/saoprof.h"
+
+
+
+/*  Names of probes in the report  */
+static const char*
+PROBE_NAMES[SAO_ST_NUM] = { "file", "open", "readDir", "readSacH", "mapSac",
+                            "scanData", "deconv", "beam", "filter", "detect",
+                            "pick", "readMoment", "format", "output", "alloc" };
+
+/*  Counters of one thread  */
+typedef struct ProbeBlock {
+  uint64_t  calls[SAO_ST_NUM];
+  uint64_t  ns[SAO_ST_NUM];
+  uint64_t  bytes[SAO_ST_NUM];
+  struct ProbeBlock *next;
+}  ProbeBlock;
+
+int saoStatsOn = 0;
+
+static ProbeBlock       *blocks = NULL;
+static pthread_mutex_t   blocksLock = PTHREAD_MUTEX_INITIALIZER;
+static struct timespec   startTime;
+
+
+
+#ifdef SAO_STATS
+static __thread ProbeBlock *threadBlock = NULL;
+__thread int saoProbeNest = 0;              // Depth of outer probes
+
+/*******************************************************************************
+**    Add time and bytes to a probe of the current thread
+**      IN1: Probe identifier SAO_ST_*
+**      IN2: Elapsed time in nanoseconds
+**      IN3: Bytes processed
+*/
+void
+saoProbeAdd (int id, uint64_t ns, uint64_t bytes)
+{
+  ProbeBlock *pb = threadBlock;
+  if (pb == NULL) {
+    if ((pb = (ProbeBlock*) calloc(1, sizeof(ProbeBlock))) == NULL) return ;
+    pthread_mutex_lock(&blocksLock);
+    pb->next = blocks;
+    blocks = pb;
+    pthread_mutex_unlock(&blocksLock);
+    threadBlock = pb;
+  }
+  pb->calls[id]++;
+  pb->ns[id]    += ns;
+  pb->bytes[id] += bytes;
+}
+/******************************************************************************/
+#endif
+
+
+
+/*******************************************************************************
+**    Remove '--stats' from arguments and switch probes on
+**      OUT: 1 if option was found, 0 otherwise
+**      IN1: Pointer to number of arguments (decreased if option is found)
+**      IN2: Arguments of the program
+**  Option is removed before getopt(..) sees it, so tools keep short options
+*/
+int
+saoStatsArg (int *argc, char *argv[])
+{
+  int i, k, found = 0;
+  for (i = 1; i < *argc; i++) {
+    if (strcmp(argv[i], "--") == 0) break;
+    if (strcmp(argv[i], "--stats") == 0) {
+      for (k = i; k < *argc; k++) argv[k] = argv[k + 1];
+      (*argc)--;   i--;   found = 1;
+    }
+  }
+  if (found == 1) {
+    clock_gettime(CLOCK_MONOTONIC, &startTime);
+#ifdef SAO_STATS
+    saoStatsOn = 1;
+#endif
+  }
+  return found;
+}
+/******************************************************************************/
+
+
+
+/*******************************************************************************
+**    Print JSON summary of all probes
+**      IN1: Output stream (usually stderr)
+**      IN2: Name of the tool
+**  Summary has wall time since saoStatsArg(..), files per second, bytes
+**  read from files (headers and mapped data), number of heap allocations
+**  and calls, time and bytes of each probe that was called
+*/
+void
+saoStatsReport (FILE *f, const char *tool)
+{
+  uint64_t calls[SAO_ST_NUM] = {0}, ns[SAO_ST_NUM] = {0};
+  uint64_t bytes[SAO_ST_NUM] = {0};
+  ProbeBlock *pb;   struct timespec now;   double wall;   int i, n = 0;
+
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  wall = (now.tv_sec - startTime.tv_sec) +
+         (now.tv_nsec - startTime.tv_nsec) / 1e9;
+#ifndef SAO_STATS
+  fprintf(f, "{\"tool\": \"%s\", \"wall_s\": %.6f, \"stats\": \"disabled\"}\n",
+          tool, wall);
+  return ;
+#endif
+  pthread_mutex_lock(&blocksLock);
+  for (pb = blocks; pb != NULL; pb = pb->next)
+    for (i = 0; i < SAO_ST_NUM; i++) {
+      calls[i] += pb->calls[i];   ns[i] += pb->ns[i];   bytes[i] += pb->bytes[i];
+    }
+  pthread_mutex_unlock(&blocksLock);
+
+  fprintf(f, "{\"tool\": \"%s\", \"wall_s\": %.6f, \"files\": %llu, "
+          "\"files_per_s\": %.1f, \"bytes_read\": %llu, \"allocs\": %llu,\n"
+          " \"stages\": {", tool, wall, (unsigned long long)calls[SAO_ST_FILE],
+          (wall > 0) ? calls[SAO_ST_FILE] / wall : 0.0,
+          (unsigned long long)(bytes[SAO_ST_READSACH] + bytes[SAO_ST_MAPSAC]),
+          (unsigned long long)calls[SAO_ST_ALLOC]);
+  for (i = 0; i < SAO_ST_NUM; i++) {
+    if (calls[i] == 0 || i == SAO_ST_FILE || i == SAO_ST_ALLOC) continue;
+    fprintf(f, "%s\n  \"%s\": {\"calls\": %llu, \"time_s\": %.6f, "
+            "\"ns_per_call\": %.1f, \"bytes\": %llu}", (n++ > 0) ? "," : "",
+            PROBE_NAMES[i], (unsigned long long)calls[i], ns[i] / 1e9,
+            (double)ns[i] / calls[i], (unsigned long long)bytes[i]);
+  }
+  fprintf(f, "}}\n");
+}
+/******************************************************************************/
@@ -0,0 +1,189 @@
+/*******************************************************************************
+**  saoqc.c - quality control of trace samples based on DataStat structure type
+**      Part of SAO core library -> see "lib/saocore.h"
+**
+**    Core functions:
+**  scanData(..)      - gather statistics of samples in one pass
+**
+**  The pass is done with SSE2 instructions when they are available (always
+**  for x86-64), four samples at once. Blocks with NaN or infinity are rare
+**  and go through the same scalar code as the tail of the trace.
+*******************************************************************************/
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include "../../lib/saocore.h"
+#include "../../lib/saoprof.h"
+
+
+
+/*  Scalar state of the pass  */
+typedef struct {
+  long      run,  nfin;         // Current run of equal samples, finite ones
+  float     prev;               // Previous sample
+  float     min,  max;          // Range of samples passed by scalar code
+  long      nmin, nmax;         // Samples equal to min and max of scalar code
+  float     rmin, rmax;         // Extremes of runs, i.e. of finite samples
+  double    sum;                // Sum of finite samples
+}  ScanState;
+
+
+
+/*******************************************************************************
+**    Account one sample in the longest run of equal samples
+*/
+static inline void
+scanRun (DataStat *st, ScanState *ss, float v)
+{
+  if (v == ss->prev) ss->run++;
+  else { ss->run = 1;  ss->prev = v; }
+  if (ss->run > st->maxrun) { st->maxrun = ss->run;  st->runval = v; }
+}
+/******************************************************************************/
+
+
+
+/*******************************************************************************
+**    Account the current run of a finite sample in the longest runs at the
+**  extremes, they restart when a new extreme appears
+*/
+static inline void
+scanExt (DataStat *st, ScanState *ss, float v)
+{
+  if (v <= ss->rmin) {
+    if (v < ss->rmin) { ss->rmin = v;  st->runmin = 0; }
+    if (ss->run > st->runmin) st->runmin = ss->run;
+  }
+  if (v >= ss->rmax) {
+    if (v > ss->rmax) { ss->rmax = v;  st->runmax = 0; }
+    if (ss->run > st->runmax) st->runmax = ss->run;
+  }
+}
+/******************************************************************************/
+
+
+
+/*******************************************************************************
+**    Account one sample by scalar code
+*/
+static inline void
+scanOne (DataStat *st, ScanState *ss, float v)
+{
+  scanRun(st, ss, v);
+  if (isnan(v)) st->nnan++;
+  else if (isinf(v)) st->ninf++;
+  else {
+    scanExt(st, ss, v);
+    ss->nfin++;   ss->sum += v;
+    if (v == 0.0f) st->nzero++;
+    if (v < ss->min) { ss->min = v;  ss->nmin = 1; }
+    else if (v == ss->min) ss->nmin++;
+    if (v > ss->max) { ss->max = v;  ss->nmax = 1; }
+    else if (v == ss->max) ss->nmax++;
+  }
+}
+/******************************************************************************/
+
+
+
+/*******************************************************************************
+**    Gather statistics of samples in one pass
+**      IN1: Pointer to samples
+**      IN2: Number of samples
+**      OUT: Pointer to DataStat structure
+**  Vector code keeps minimum and maximum in each of four lanes together with
+**  number of samples equal to them, lanes are merged at the end of the pass.
+**  Runs are checked by comparison with the previous samples (shifted load),
+**  so only blocks where a run ends need a look at single samples. Runs at
+**  the extremes are followed there too, for samples reaching the extremes
+**  of runs so far: the smallest (largest) value of runs is the minimum
+**  (maximum), so lanes need no merging for them.
+*/
+void
+scanData (const float *x, long n, DataStat *st)
+{
+  ScanState ss;   long i = 0;
+  SAO_PROBE_START(t0);
+  memset(st, 0, sizeof(DataStat));
+  memset(&ss, 0, sizeof(ScanState));
+  st->npts = n;
+  ss.prev = NAN;   ss.min = INFINITY;   ss.max = -INFINITY;
+  ss.rmin = INFINITY;   ss.rmax = -INFINITY;
+  if (n > 0) scanOne(st, &ss, x[i++]);
+
+#if defined(__SSE2__)
+  {
+    const __m128 vinf = _mm_set1_ps(INFINITY), zero = _mm_setzero_ps();
+    const __m128 vabs = _mm_castsi128_ps(_mm_set1_epi32(0x7FFFFFFF));
+    __m128 vmin = _mm_set1_ps(INFINITY), vmax = _mm_set1_ps(-INFINITY);
+    __m128 v, lt, gt, eq;
+    __m128i cmin = _mm_setzero_si128(), cmax = _mm_setzero_si128();
+    __m128d s0 = _mm_setzero_pd(), s1 = _mm_setzero_pd();
+    float fmin[4], fmax[4];   int32_t nmin[4], nmax[4];
+    int k, m, e;
+
+    for (; i + 4 <= n; i += 4) {
+      v = _mm_loadu_ps(x + i);
+      if (_mm_movemask_ps(_mm_cmplt_ps(_mm_and_ps(v, vabs), vinf)) != 0xF) {
+        for (k = 0; k < 4; k++) scanOne(st, &ss, x[i + k]);
+        continue;
+      }
+      m = _mm_movemask_ps(_mm_cmpeq_ps(v, _mm_loadu_ps(x + i - 1)));
+      if (m == 0xF) {
+        ss.run += 4;
+        if (ss.run > st->maxrun) { st->maxrun = ss.run;  st->runval = ss.prev; }
+        scanExt(st, &ss, ss.prev);
+      }
+      else {
+        e = _mm_movemask_ps(_mm_or_ps(_mm_cmple_ps(v, _mm_set1_ps(ss.rmin)),
+                                      _mm_cmpge_ps(v, _mm_set1_ps(ss.rmax))));
+        for (k = 0; k < 4; k++) {
+          scanRun(st, &ss, x[i + k]);
+          if (e & (1 << k)) scanExt(st, &ss, x[i + k]);
+        }
+      }
+
+      st->nzero += __builtin_popcount(_mm_movemask_ps(_mm_cmpeq_ps(v, zero)));
+      s0 = _mm_add_pd(s0, _mm_cvtps_pd(v));
+      s1 = _mm_add_pd(s1, _mm_cvtps_pd(_mm_movehl_ps(v, v)));
+
+      lt = _mm_cmplt_ps(v, vmin);   eq = _mm_cmpeq_ps(v, vmin);
+      cmin = _mm_andnot_si128(_mm_castps_si128(lt), cmin);
+      cmin = _mm_sub_epi32(cmin, _mm_castps_si128(_mm_or_ps(lt, eq)));
+      vmin = _mm_min_ps(vmin, v);
+      gt = _mm_cmpgt_ps(v, vmax);   eq = _mm_cmpeq_ps(v, vmax);
+      cmax = _mm_andnot_si128(_mm_castps_si128(gt), cmax);
+      cmax = _mm_sub_epi32(cmax, _mm_castps_si128(_mm_or_ps(gt, eq)));
+      vmax = _mm_max_ps(vmax, v);
+      ss.nfin += 4;
+    }
+
+    s0 = _mm_add_pd(s0, s1);
+    ss.sum += _mm_cvtsd_f64(s0) + _mm_cvtsd_f64(_mm_unpackhi_pd(s0, s0));
+    _mm_storeu_ps(fmin, vmin);   _mm_storeu_si128((__m128i*)nmin, cmin);
+    _mm_storeu_ps(fmax, vmax);   _mm_storeu_si128((__m128i*)nmax, cmax);
+    for (k = 0; k < 4; k++) {
+      if (fmin[k] < ss.min) { ss.min = fmin[k];  ss.nmin = nmin[k]; }
+      else if (fmin[k] == ss.min) ss.nmin += nmin[k];
+      if (fmax[k] > ss.max) { ss.max = fmax[k];  ss.nmax = nmax[k]; }
+      else if (fmax[k] == ss.max) ss.nmax += nmax[k];
+    }
+  }
+#endif
+
+  for (; i < n; i++) scanOne(st, &ss, x[i]);
+
+  if (ss.nfin > 0) {
+    st->min  = ss.min;    st->nmin = ss.nmin;
+    st->max  = ss.max;    st->nmax = ss.nmax;
+    st->mean = ss.sum / ss.nfin;
+  }
+  else { st->min = NAN;  st->max = NAN;  st->mean = NAN; }
+  SAO_PROBE_STOP(SAO_ST_SCANDATA, t0, n * sizeof(float));
+}
+/******************************************************************************/
@@ -0,0 +1,197 @@
+/*******************************************************************************
+**  saoresp.c - instrument response removal based on Response structure type
+**      Part of SAO core library -> see "lib/saocore.h"
+**
+**    Core functions:
+**  evalResponse(..)  - complex response at a frequency
+**  removeResponse(..) - remove response from samples of a trace (in place)
+**  freeRespWork(..)  - free buffers of RespWork
+**
+**  Trace is detrended, tapered by cosine on RESP_TAPER of its length at each
+**  end and padded with zeros to at least twice its length, then its
+**  spectrum is divided by the response. The padding keeps the division a
+**  linear convolution: long response tails of the end of a trace do not
+**  wrap around onto its beginning.
+*******************************************************************************/
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <complex.h>
+
+#include "../../lib/saocore.h"
+#include "../../lib/saoprof.h"
+
+
+
+#define RESP_TAPER 0.05         // Part of trace tapered at each end
+
+
+
+/*******************************************************************************
+**    Complex response at a frequency
+**      IN1: Pointer to Response structure
+**      IN2: Frequency in Hz
+**      OUT: Real and imaginary parts of the response
+*/
+void
+evalResponse (const Response *r, double f, double *re, double *im)
+{
+  double complex s = 2.0 * M_PI * f * I, h = r->constant;   int k;
+  for (k = 0; k < r->nzeros; k++)
+    h *= s - (r->zeros[2*k] + r->zeros[2*k+1] * I);
+  for (k = 0; k < r->npoles; k++)
+    h /= s - (r->poles[2*k] + r->poles[2*k+1] * I);
+  *re = creal(h);   *im = cimag(h);
+}
+/******************************************************************************/
+
+
+
+/*******************************************************************************
+**    Weight of pre-filter at a frequency (cosine taper f1-f2 and f3-f4)
+*/
+static double
+preFilter (const double *pre, double f)
+{
+  if (pre[3] <= 0.0) return 1.0;
+  if (f <= pre[0] || f >= pre[3]) return 0.0;
+  if (f < pre[1])
+    return 0.5 * (1.0 - cos(M_PI * (f - pre[0]) / (pre[1] - pre[0])));
+  if (f > pre[2])
+    return 0.5 * (1.0 + cos(M_PI * (f - pre[2]) / (pre[3] - pre[2])));
+  return 1.0;
+}
+/******************************************************************************/
+
+
+
+/*******************************************************************************
+**    Inverse response with water level, output units and pre-filter
+**  Response is evaluated first to find its maximum for the water level
+*/
+static void
+invertResponse (RespWork *w, const Response *r, const RespOpts *o, double delta)
+{
+  long k, nf = w->size / 2 + 1;   double *h = w->inv, f, a, amax = 0.0, amin;
+  double hr, hi, wt, om;
+
+  for (k = 0; k < nf; k++) {
+    evalResponse(r, k / (w->size * delta), &h[2*k], &h[2*k+1]);
+    a = hypot(h[2*k], h[2*k+1]);
+    if (a > amax) amax = a;
+  }
+  amin = (o->wlevel >= 0.0) ? amax * pow(10.0, -o->wlevel / 20.0) : 0.0;
+  for (k = 0; k < nf; k++) {
+    f = k / (w->size * delta);   om = 2.0 * M_PI * f;
+    hr = h[2*k];   hi = h[2*k+1];   a = hypot(hr, hi);
+    if (a < amin) {
+      if (a > 0.0) { hr *= amin / a;  hi *= amin / a; }
+      else { hr = amin;  hi = 0.0; }
+      a = amin;
+    }
+    wt = (a > 0.0) ? preFilter(o->pre, f) / (a * a) : 0.0;
+    hr *= wt;   hi *= -wt;                        // 1/H = H* / |H|^2
+    if (o->units == 1) { wt = hr;  hr = -om * hi;  hi = om * wt; }
+    else if (o->units == 2) { hr *= -om * om;  hi *= -om * om; }
+    h[2*k] = hr;   h[2*k+1] = hi;
+  }
+  w->resp = r;   w->delta = delta;   w->opts = *o;
+}
+/******************************************************************************/
+
+
+
+/*******************************************************************************
+**    Remove linear trend and taper ends of samples
+*/
+static void
+prepareTrace (double *x, long n)
+{
+  double sx = 0.0, sxy = 0.0, a, b, mx = 0.5 * (n - 1), d;
+  long i, nt = (long)(RESP_TAPER * n);
+
+  for (i = 0; i < n; i++) {
+    sx += x[i];   sxy += (i - mx) * x[i];
+  }
+  a = sx / n;
+  b = (n > 1) ? sxy / (n * ((double)n * n - 1.0) / 12.0) : 0.0;
+  for (i = 0; i < n; i++) x[i] -= a + b * (i - mx);
+  for (i = 0; i < nt; i++) {
+    d = 0.5 * (1.0 - cos(M_PI * i / nt));
+    x[i] *= d;   x[n-1-i] *= d;
+  }
+}
+/******************************************************************************/
+
+
+
+/*******************************************************************************
+**    Remove response from samples of a trace (in place)
+**      OUT: SAO_OK, SAO_EFORMAT - incorrect trace, SAO_ESPACE - no memory
+**      IN1: Pointer to RespWork structure (zero filled before first use)
+**      IN2: Pointer to Response structure
+**      IN3: Pointer to RespOpts structure
+**      IN4: Samples (counts), replaced by displacement, velocity or
+**           acceleration in meters and seconds
+**      IN5: Number of samples
+**      IN6: Sampling interval in seconds
+**  Buffers of RespWork grow only, transform plan is taken from the cache
+**  and inverse response is recalculated only if response, size of
+**  transform, sampling interval or options differ from the previous trace
+*/
+int
+removeResponse (RespWork *w, const Response *r, const RespOpts *o,
+                float *x, long n, double delta)
+{
+  long size = fftSize(2 * n), i;   double *buf, *inv, re;
+  SAO_PROBE_START(t0);
+
+  if (n < 2 || !(delta > 0.0)) return SAO_EFORMAT;
+  if (w->size != size) {
+    buf = (double*) realloc(w->buf, (size + 2) * sizeof(double));
+    if (buf != NULL) w->buf = buf;
+    inv = (double*) realloc(w->inv, (size + 2) * sizeof(double));
+    if (inv != NULL) w->inv = inv;
+    w->plan = getFftPlan(size);
+    if (buf == NULL || inv == NULL || w->plan == NULL) {
+      freeRespWork(w);
+      return SAO_ESPACE;
+    }
+    w->size = size;   w->resp = NULL;
+  }
+  if (w->resp != r || w->delta != delta || w->opts.wlevel != o->wlevel ||
+      w->opts.units != o->units ||
+      memcmp(w->opts.pre, o->pre, 4 * sizeof(double)) != 0)
+    invertResponse(w, r, o, delta);
+
+  buf = w->buf;   inv = w->inv;
+  for (i = 0; i < n; i++) buf[i] = x[i];
+  prepareTrace(buf, n);
+  memset(buf + n, 0, (size + 2 - n) * sizeof(double));
+  fftReal(w->plan, buf);
+  for (i = 0; i <= size / 2; i++) {
+    re = buf[2*i];
+    buf[2*i]   = re * inv[2*i] - buf[2*i+1] * inv[2*i+1];
+    buf[2*i+1] = re * inv[2*i+1] + buf[2*i+1] * inv[2*i];
+  }
+  fftInverse(w->plan, buf);
+  for (i = 0; i < n; i++) x[i] = (float) buf[i];
+  SAO_PROBE_STOP(SAO_ST_DECONV, t0, n * sizeof(float));
+  return SAO_OK;
+}
+/******************************************************************************/
+
+
+
+/*******************************************************************************
+**    Free buffers of RespWork
+**      IN:  Pointer to RespWork structure, it is zero filled after the call
+*/
+void
+freeRespWork (RespWork *w)
+{
+  free(w->buf);   free(w->inv);
+  memset(w, 0, sizeof(RespWork));
+}
+/******************************************************************************/
@@ -0,0 +1,213 @@
+/*******************************************************************************
+**  saostat.c - statistics of event catalogs based on Seismicity structure type
+**      Part of SAO core library -> see "lib/saocore.h"
+**
+**    Core functions:
+**  addEvent(..)      - account event of given magnitude
+**  mergeSeismicity(..) - add statistics of one structure to another
+**  getMc(..)         - estimate magnitude of completeness (max curvature)
+**  getBValue(..)     - estimate b-value above Mc (Aki-Utsu max likelihood)
+**  bootSeismicity(..) - one bootstrap replicate of Mc and b-value
+**  getBucket(..)     - key of hour/day/year bucket containing a Moment
+**  bucketBegin(..)   - first Moment of hour/day/year bucket by its key
+**
+*******************************************************************************/
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+
+#include "../../lib/saocore.h"
+
+
+
+/*******************************************************************************
+**    Account event of given magnitude
+**      IN1: Pointer to Seismicity structure to update
+**      IN2: Magnitude of the event
+**  Magnitude is rounded to the nearest histogram bin
+**  Events out of histogram range are still counted in total and moment
+**  Scalar moment by Hanks & Kanamori (1979): M0 = 10^(1.5*Mw + 9.1) N*m
+*/
+void
+addEvent (Seismicity *s, double mag)
+{
+  long i = lround((mag - MFD_MMIN) / MFD_DM);
+  if (i >= 0 && i < MFD_NBINS) s->mfd[i]++;
+  else s->nout++;
+  s->nev++;
+  s->m0 += pow(10.0, 1.5 * mag + 9.1);
+  if (mag < s->mmin) s->mmin = mag;
+  if (mag > s->mmax) s->mmax = mag;
+}
+/******************************************************************************/
+
+
+
+/*******************************************************************************
+**    Add statistics of one structure to another
+**      IN1: Pointer to Seismicity structure to update
+**      IN2: Pointer to Seismicity structure to add
+*/
+void
+mergeSeismicity (Seismicity *s, const Seismicity *add)
+{
+  int i;
+  for (i = 0; i < MFD_NBINS; i++) s->mfd[i] += add->mfd[i];
+  s->nev  += add->nev;
+  s->nout += add->nout;
+  s->m0   += add->m0;
+  if (add->mmin < s->mmin) s->mmin = add->mmin;
+  if (add->mmax > s->mmax) s->mmax = add->mmax;
+}
+/******************************************************************************/
+
+
+
+/*******************************************************************************
+**    Estimate magnitude of completeness by maximum curvature method
+**      OUT: Magnitude of completeness or NAN for empty histogram
+**      IN1: Pointer to Seismicity structure
+**      IN2: Correction added to the result (+0.2 by Woessner & Wiemer, 2005)
+**  Maximum curvature is simply the bin with the highest non-cumulative count
+*/
+double
+getMc (const Seismicity *s, double mccor)
+{
+  int i, imax = -1;   long nmax = 0;
+  for (i = 0; i < MFD_NBINS; i++)
+    if (s->mfd[i] > nmax) { nmax = s->mfd[i];  imax = i; }
+  if (imax < 0) return NAN;
+  return MFD_MMIN + imax * MFD_DM + mccor;
+}
+/******************************************************************************/
+
+
+
+/*******************************************************************************
+**    Estimate b-value above Mc by Aki-Utsu maximum likelihood method
+**      OUT: b-value or NAN if there is not enough events
+**      IN1: Pointer to Seismicity structure
+**      IN2: Magnitude of completeness
+**      IN3: Pointer to a-value (could be NULL)
+**      IN4: Pointer to number of events above Mc (could be NULL)
+**  b = log10(e) / (<M> - (Mc - dM/2)), half bin accounts for rounding
+**  a = log10(N) + b * Mc, so that log10(N(M >= Mc)) = a - b * Mc
+*/
+double
+getBValue (const Seismicity *s, double mc, double *a, long *n)
+{
+  long i, ic, cnt = 0;   double msum = 0.0, b = NAN;
+  if (isnan(mc)) ic = MFD_NBINS;
+  else ic = lround((mc - MFD_MMIN) / MFD_DM);
+  if (ic < 0) ic = 0;
+  for (i = ic; i < MFD_NBINS; i++) {
+    cnt  += s->mfd[i];
+    msum += s->mfd[i] * (MFD_MMIN + i * MFD_DM);
+  }
+  if (cnt > 1 && msum / cnt > mc - MFD_DM / 2)
+    b = M_LOG10E / (msum / cnt - (mc - MFD_DM / 2));
+  if (a != NULL) a[0] = (cnt > 0) ? log10(cnt) + b * mc : NAN;
+  if (n != NULL) n[0] = cnt;
+  return b;
+}
+/******************************************************************************/
+
+
+
+/*******************************************************************************
+**    One bootstrap replicate of magnitude of completeness and b-value
+**      IN1: Pointer to Seismicity structure with original distribution
+**      IN2: Correction for the maximum curvature method
+**      IN3: Seed of the replicate - same seed gives the same replicate
+**      OUT: Pointers to Mc and b-value of the replicate
+**  Resampling with replacement of N binned magnitudes is done directly from
+**  the histogram, so no catalog in memory is required for the bootstrap
+**  Walker's alias table gives a bin for one random number in O(1)
+**  Random numbers are from splitmix64 generator seeded for each replicate,
+**  thus results do not depend on the order and threads of execution
+**  The seed itself is scrambled first, so replicate number is a good seed
+*/
+static inline uint64_t
+splitMix (uint64_t *x)
+{
+  uint64_t z = (*x += 0x9E3779B97F4A7C15ULL);
+  z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+  z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+  return z ^ (z >> 31);
+}
+
+void
+bootSeismicity (const Seismicity *s, double mccor, uint64_t seed,
+                double *mc, double *b)
+{
+  double prob[MFD_NBINS];   int alias[MFD_NBINS];
+  int small[MFD_NBINS], large[MFD_NBINS], ns = 0, nl = 0;
+  Seismicity r = NO_SEISMICITY;   long i, n = 0;
+
+  for (i = 0; i < MFD_NBINS; i++) n += s->mfd[i];
+  if (n == 0) { *mc = NAN;  *b = NAN;  return ; }
+  seed = splitMix(&seed);
+  for (i = 0; i < MFD_NBINS; i++) {
+    prob[i] = (double)s->mfd[i] * MFD_NBINS / n;   alias[i] = i;
+    if (prob[i] < 1.0) small[ns++] = i; else large[nl++] = i;
+  }
+  while (ns > 0 && nl > 0) {
+    int l = small[--ns], g = large[nl - 1];
+    alias[l] = g;
+    prob[g] -= 1.0 - prob[l];
+    if (prob[g] < 1.0) { nl--;  small[ns++] = g; }
+  }
+  while (nl > 0) prob[large[--nl]] = 1.0;
+  while (ns > 0) prob[small[--ns]] = 1.0;
+
+  for (i = 0; i < n; i++) {
+    uint64_t x = splitMix(&seed);
+    int k = (int)(((x >> 32) * MFD_NBINS) >> 32);
+    double u = (double)(x & 0xFFFFFFFFULL) / 4294967296.0;
+    r.mfd[(u < prob[k]) ? k : alias[k]]++;
+  }
+  r.nev = n;
+  *mc = getMc(&r, mccor);
+  *b  = getBValue(&r, *mc, NULL, NULL);
+}
+/******************************************************************************/
+
+
+
+/*******************************************************************************
+**    Key of hour/day/year bucket containing a Moment
+**      OUT: Bucket key, which grows with time
+**      IN1: Moment structure
+**      IN2: Unit of bucket: 'h' - hour, 'd' - day, 'y' - year
+**  Keys are built from calendar fields directly (no epoch time calculation):
+**    year -> YYYY,  day -> YYYYDDD,  hour -> YYYYDDDhh
+*/
+long
+getBucket (Moment t, char unit)
+{
+  if (unit == 'y') return t.year;
+  if (unit == 'h') return ((long)t.year * 1000 + t.yday) * 100 + t.hour;
+  return (long)t.year * 1000 + t.yday;
+}
+/******************************************************************************/
+
+
+
+/*******************************************************************************
+**    First Moment of hour/day/year bucket by its key
+**      OUT: New Moment structure
+**      IN1: Bucket key from getBucket(..)
+**      IN2: Unit of bucket: 'h' - hour, 'd' - day, 'y' - year
+*/
+Moment
+bucketBegin (long key, char unit)
+{
+  Moment t = EPOCH_0;
+  if (unit == 'h') { t.hour = key % 100;  key /= 100; }
+  if (unit != 'y') { t.yday = key % 1000;  key /= 1000; }
+  t.year = key;
+  getMonthDay(&t.month, &t.day, t.year, t.yday);
+  return t;
+}
+/******************************************************************************/
@@ -8,16 +8,22 @@
 **  addSecs(..)       - add or substract seconds to/from a Moment
 **  difDays(..)       - calculate difference in days between two Moments
 **  difSecs(..)       - calculate difference in seconds between two Moments
+**  cmpMoment(..)     - compare two Moments without epoch time calculation
 **  readMoment(..)    - read Moment from a string of supported format
 **  writeMoment(..)   - write Moment to a string of specified format
 **  printMoment(..)   - print Moment to standard output
 **
+**    Reentrant functions (no allocation, no output, status codes):
+**  scanMoment(..)    - read Moment from a string with status code
+**  sprintMoment(..)  - write Moment into a caller's buffer
+**
 *******************************************************************************/
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
 
 #include "../../lib/saocore.h"
+#include "../../lib/saoprof.h"
 
 
 
@@ -41,7 +47,7 @@ fromEpoch (double epoch)
   long days = (long)(epoch / 86400);
   double rs = epoch - (double)(days * 86400);
   if (rs < 0.0f) { rs += 86400.0;  days -= 1; }
-  if (days > 0) while (days >= dpy) {
+  if (days >= 0) while (days >= dpy) {
     days -= dpy;
     t.year++;
     if (t.year % 4 == 0) dpy = 366; else dpy = 365;
@@ -84,7 +90,7 @@ toEpoch (Moment t)
     for (year = EPOCH_0.year; year >= t.year; year--)
     if (year % 4 == 0) nleaps++; }
   else {
-    for (year = EPOCH_0.year; year <= t.year; year++)
+    for (year = EPOCH_0.year; year < t.year; year++)
     if (year % 4 == 0) nleaps++; }
 
   if (years == 0) days = 0;
@@ -146,9 +152,32 @@ difDays (Moment t2, Moment t1)
 
 
 /*******************************************************************************
-**    Read Moment from a string of supported format
-**      OUT: New Moment struct
-**      IN:  String of supported format (see in saocore.h)
+**    Compare two Moments without epoch time calculation
+**      OUT: 1 if t2 is later than t1, -1 if earlier and 0 if equal
+**      INs: Moments to compare
+**  Correct Moments are ordered by their fields from year to millisecond
+**  It is much cheaper than difSecs(..) when we only need an order
+*/
+int
+cmpMoment (Moment t2, Moment t1)
+{
+  if (t2.year != t1.year) return (t2.year > t1.year) ? 1 : -1;
+  if (t2.yday != t1.yday) return (t2.yday > t1.yday) ? 1 : -1;
+  if (t2.hour != t1.hour) return (t2.hour > t1.hour) ? 1 : -1;
+  if (t2.min  != t1.min)  return (t2.min  > t1.min)  ? 1 : -1;
+  if (t2.sec  != t1.sec)  return (t2.sec  > t1.sec)  ? 1 : -1;
+  if (t2.msec != t1.msec) return (t2.msec > t1.msec) ? 1 : -1;
+  return 0;
+}
+/******************************************************************************/
+
+
+
+/*******************************************************************************
+**    Read Moment from a string of supported format with status code
+**      OUT: SAO_OK or SAO_EFORMAT if string is not a correct Moment
+**      IN1: String of supported format (see in saocore.h)
+**      OUT: Pointer to Moment structure, NOT_MOMENT for wrong string
 **  First we check how long input string is
 **  Then just checking blocks of date and time one by one
 **  Variable 'shift' is used to account for ordinal and ISO representation
@@ -159,13 +188,14 @@ difDays (Moment t2, Moment t1)
 **    buf[11+shift] & buf[14+shift] - separators of time parts for ISO format
 **    buf[15+shift] - separator of millesecond part for ISO format
 */
-Moment
-readMoment (const char *buf)
+int
+scanMoment (const char *buf, Moment *tp)
 {
   Moment t = EPOCH_0;
   char tmp2[3], tmp3[4], tmp4[5];
   int len = strlen(buf);
   int shift = 0;
+  SAO_PROBE_START(t0);
   tmp2[2] = '\0'; tmp3[3] = '\0'; tmp4[4] = '\0';
 
   if (len > 4 &&
@@ -233,58 +263,107 @@ readMoment (const char *buf)
     t.msec = atoi(memcpy(tmp3, buf + 16 + shift, 3));
   }
 strdone:
-  if (isMoment(t) == 1)
-    return t;
+  if (isMoment(t) == 1) {
+    *tp = t;
+    SAO_PROBE_STOP(SAO_ST_READMOMENT, t0, len);
+    return SAO_OK;
+  }
 
 wrongfmt:
-  return NOT_MOMENT;
+  *tp = NOT_MOMENT;
+  SAO_PROBE_STOP(SAO_ST_READMOMENT, t0, len);
+  return SAO_EFORMAT;
 }
 /******************************************************************************/
 
 
 
 /*******************************************************************************
-**    Write Moment to a string of specified format
-**      OUT: Pointer to the new string
-**      IN1: Moment to write
-**      IN2: Format of string
+**    Read Moment from a string of supported format
+**      OUT: New Moment struct, NOT_MOMENT for unsupported string
+**      IN:  String of supported format (see in saocore.h)
 */
-char*
-writeMoment (Moment t, const char *format)
+Moment
+readMoment (const char *buf)
 {
-  char *buf;  int len = 0;
-  if (isMoment(t) == 0) return NULL;
-  if (strcmp(format, "ORD") == 0) len = 8;
-  if (strcmp(format, "STD") == 0) len = 10;
-  if (strcmp(format, "SAC") == 0) len = 15;
-  if (strcmp(format, "SAO") == 0) len = 17;
-  if (strcmp(format, "ISO") == 0) len = 23;
+  Moment t;
+  scanMoment(buf, &t);
+  return t;
+}
+/******************************************************************************/
+
 
-  buf = (char*) malloc((len + 1) * sizeof(char));
+
+/*******************************************************************************
+**    Write Moment into a caller's buffer
+**      OUT: Length of the string or negative status code:
+**           SAO_EFORMAT - incorrect Moment or unsupported format
+**           SAO_ESPACE  - buffer is too small (24 bytes is enough for all)
+**      IN1: Buffer for the string
+**      IN2: Size of the buffer
+**      IN3: Moment to write
+**      IN4: Format of string
+*/
+int
+sprintMoment (char *buf, size_t size, Moment t, const char *format)
+{
+  int len = 0;
+  if (isMoment(t) == 0) return SAO_EFORMAT;
+  if (strcmp(format, "ORD") == 0) len = 8;
+  else if (strcmp(format, "STD") == 0) len = 10;
+  else if (strcmp(format, "SAC") == 0) len = 15;
+  else if (strcmp(format, "SAO") == 0) len = 17;
+  else if (strcmp(format, "ISO") == 0) len = 23;
+  else return SAO_EFORMAT;
+  if (size < (size_t)len + 1) return SAO_ESPACE;
+
+  SAO_OUTER_START(t0);
   switch (len) {
     case 8:
-      sprintf(buf, "%04d-%03d", t.year, t.yday);
+      snprintf(buf, size, "%04d-%03d", t.year, t.yday);
       break;
     case 10:
-      sprintf(buf, "%04d-%02d-%02d", t.year, t.month, t.day);
+      snprintf(buf, size, "%04d-%02d-%02d", t.year, t.month, t.day);
       break;
     case 15:
-      sprintf(buf, "%04d-%03d_%02d%02d%02d",
+      snprintf(buf, size, "%04d-%03d_%02d%02d%02d",
                     t.year, t.yday, t.hour, t.min, t.sec);
       break;
     case 17:
-      sprintf(buf, "%04d-%02d-%02d_%02d%02d%02d",
+      snprintf(buf, size, "%04d-%02d-%02d_%02d%02d%02d",
                     t.year, t.month, t.day, t.hour, t.min, t.sec);
       break;
     case 23:
-      sprintf(buf, "%04d-%02d-%02dT%02d:%02d:%02d.%03d",
+      snprintf(buf, size, "%04d-%02d-%02dT%02d:%02d:%02d.%03d",
                     t.year, t.month, t.day, t.hour, t.min, t.sec, t.msec);
       break;
-    default:
-      fprintf(stderr, "Not supported format for writing the moment.\n");
-      break;
   }
-  buf[len] = '\0';
+  SAO_OUTER_STOP(SAO_ST_FORMAT, t0, len);
+  return len;
+}
+/******************************************************************************/
+
+
+
+/*******************************************************************************
+**    Write Moment to a string of specified format
+**      OUT: Pointer to the new string (caller frees it) or NULL
+**      IN1: Moment to write
+**      IN2: Format of string
+**  Allocating wrapper of sprintMoment(..), reports unsupported format
+*/
+char*
+writeMoment (Moment t, const char *format)
+{
+  char *buf;   int len;
+  if (isMoment(t) == 0) return NULL;
+  if ((buf = (char*) malloc(SAO_MOMENT_LEN * sizeof(char))) == NULL)
+    return NULL;
+  SAO_COUNT(SAO_ST_ALLOC, SAO_MOMENT_LEN);
+  if ((len = sprintMoment(buf, SAO_MOMENT_LEN, t, format)) < 0) {
+    fprintf(stderr, "Not supported format for writing the moment.\n");
+    buf[0] = '\0';
+  }
   return buf;
 }
 /******************************************************************************/
@@ -370,22 +449,26 @@ isTime (short h, short m, short s)
 
 /*******************************************************************************
 **    Determine month and day from the day in a year
-**      OUT: Two pointers (1) Month number and (2) Day number
+**      OUT: SAO_OK or SAO_EFORMAT for incorrect day in the year
+**      OUT: Two pointers (1) Month number and (2) Day number, both are set
+**           to zero for incorrect day in the year
 **      IN1: Year number (bcs of the leap years)
 **      IN2: Year day
 */
-inline void
+inline int
 getMonthDay (short* month, short* day, short year, short yday)
 {
   short const *days;   short m;
-  if ( yday < 1 || yday > 366)
-    fprintf(stderr, "Incorect date. yday == [%d]\n", yday);
   if (year % 4 == 0) days = DAYS_366; else days = DAYS_365;
+  if (yday < 1 || yday > days[12]) {
+    *month = 0;  *day = 0;
+    return SAO_EFORMAT;
+  }
   for (m = 0; m < 12; m++)
     if (yday >= days[m] + 1 && yday <=days[m+1])
       { *day = yday - days[m]; break; }
   *month = m + 1;
-  return ;
+  return SAO_OK;
 }
 /******************************************************************************/
 
@@ -393,18 +476,16 @@ getMonthDay (short* month, short* day, short year, short yday)
 
 /*******************************************************************************
 **    Determine the day in a year from month and day
-**      OUT: Number of the day in a year
+**      OUT: Number of the day in a year, 0 for incorrect date
 **      INs: Year, Month and Day
 */
 inline short
 getYday (short year, short month, short day)
 {
-  short const *days;   short yday = 0;
-  if (isDate(year, month, day) == 0)
-    fprintf(stderr, "Incorect date. |%d-%d-%d|\n", year, month, day);
+  short const *days;
+  if (isDate(year, month, day) == 0) return 0;
   if (year % 4 == 0) days = DAYS_366; else days = DAYS_365;
-  yday = day + days[month-1];
-  return yday;
+  return day + days[month-1];
 }
 /******************************************************************************/
 
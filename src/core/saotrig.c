@@ -0,0 +1,99 @@
+/*******************************************************************************
+**  saotrig.c - STA/LTA detection of events based on Trigger structure type
+**      Part of SAO core library -> see "lib/saocore.h"
+**
+**    Core functions:
+**  staLta(..)        - characteristic function of classic STA/LTA
+**  findTriggers(..)  - triggers of a characteristic function
+**
+**  Both windows are moved by running sums of squares in double precision,
+**  so the function is one pass over samples whatever the window lengths.
+**  Broken samples (NaN and infinity) are taken as zeros.
+*******************************************************************************/
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+
+#include "../../lib/saocore.h"
+#include "../../lib/saoprof.h"
+
+
+
+/*  Square of a sample, zero for broken ones  */
+static inline double
+energy (float v)
+{
+  return isfinite(v) ? (double) v * v : 0.0;
+}
+
+
+
+/*******************************************************************************
+**    Characteristic function of classic STA/LTA
+**      OUT: SAO_OK or SAO_EFORMAT - incorrect windows
+**      IN1: Samples
+**      IN2: Number of samples
+**      IN3: Samples of short window (at least 1)
+**      IN4: Samples of long window (longer than short one)
+**      OUT: Ratio for each sample, 0 for the first nlta - 1 samples
+*/
+int
+staLta (const float *x, long n, long nsta, long nlta, float *cf)
+{
+  double sta = 0.0, lta = 0.0;   long i;
+  SAO_PROBE_START(t0);
+
+  if (nsta < 1 || nlta <= nsta) return SAO_EFORMAT;
+  for (i = 0; i < n; i++) {
+    sta += energy(x[i]);   lta += energy(x[i]);
+    if (i >= nsta) sta -= energy(x[i - nsta]);
+    if (i >= nlta) lta -= energy(x[i - nlta]);
+    if (i < nlta - 1) cf[i] = 0.0;
+    else cf[i] = (lta > 0.0) ? (sta / nsta) / (lta / nlta) : 0.0;
+  }
+  SAO_PROBE_STOP(SAO_ST_DETECT, t0, n * sizeof(float));
+  return SAO_OK;
+}
+/******************************************************************************/
+
+
+
+/*******************************************************************************
+**    Triggers of a characteristic function
+**      OUT: Number of triggers (may be more than the size of array)
+**      IN1: Characteristic function
+**      IN2: Number of samples
+**      IN3: Level of switching on
+**      IN4: Level of switching off
+**      OUT: Array of triggers, only the first 'max' ones are written
+**      IN6: Size of array
+**  Trigger still on at the end of samples is closed by the last sample
+*/
+long
+findTriggers (const float *cf, long n, double on, double off,
+              Trigger *tr, long max)
+{
+  long i, count = 0;   Trigger t = {-1, -1, 0.0};
+
+  for (i = 0; i < n; i++) {
+    if (t.on < 0) {
+      if (cf[i] > on) { t.on = i;  t.peak = cf[i]; }
+    }
+    else {
+      if (cf[i] > t.peak) t.peak = cf[i];
+      if (cf[i] < off) {
+        t.off = i;
+        if (count < max) tr[count] = t;
+        count++;   t.on = -1;
+      }
+    }
+  }
+  if (t.on >= 0) {
+    t.off = n - 1;
+    if (count < max) tr[count] = t;
+    count++;
+  }
+  return count;
+}
+/******************************************************************************/
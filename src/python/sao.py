@@ -0,0 +1,114 @@
+"""Seismicity Analysis Organizer - Python bindings to SAO libraries.
+
+SAC headers and samples are NumPy arrays backed directly by the mapped
+file, and time conversions run over whole arrays in C (see saomodule.c).
+Build with 'make python' and add 'lib' directory to PYTHONPATH.
+
+    >>> import sao
+    >>> hdr, data = sao.read_sac('station.sac')
+    >>> hdr['delta'], data.mean()
+    >>> hdrs = sao.read_headers(paths)          # structured array
+    >>> begin = sao.sac_begin(hdrs)             # epoch times
+    >>> sao.from_epoch(begin)['year']
+"""
+import numpy as np
+
+import _sao
+
+__all__ = ['SACH_DTYPE', 'MOMENT_DTYPE', 'SacFile', 'read_sac',
+           'read_headers', 'sac_begin', 'to_epoch', 'from_epoch']
+
+
+# SAC header structure - same order as SacH in "lib/saosys.h"
+_FLOATS = ['delta', 'depmin', 'depmax', 'scale', 'odelta',
+           'b', 'e', 'o', 'a', 'internal1',
+           't0', 't1', 't2', 't3', 't4',
+           't5', 't6', 't7', 't8', 't9',
+           'f', 'resp0', 'resp1', 'resp2', 'resp3',
+           'resp4', 'resp5', 'resp6', 'resp7', 'resp8',
+           'resp9', 'stla', 'stlo', 'stel', 'stdp',
+           'evla', 'evlo', 'evel', 'evdp', 'unused1',
+           'user0', 'user1', 'user2', 'user3', 'user4',
+           'user5', 'user6', 'user7', 'user8', 'user9',
+           'dist', 'az', 'baz', 'gcarc', 'internal2',
+           'internal3', 'depmen', 'cmpaz', 'cmpinc', 'unused2',
+           'unused3', 'unused4', 'unused5', 'unused6', 'unused7',
+           'unused8', 'unused9', 'unused10', 'unused11', 'unused12']
+_INTS = ['nzyear', 'nzjday', 'nzhour', 'nzmin', 'nzsec',
+         'nzmsec', 'internal4', 'internal5', 'internal6', 'npts',
+         'internal7', 'internal8', 'unused13', 'unused14', 'unused15',
+         'iftype', 'idep', 'iztype', 'unused16', 'iinst',
+         'istreg', 'ievreg', 'ievtyp', 'iqual', 'isynth',
+         'unused17', 'unused18', 'unused19', 'unused20', 'unused21',
+         'unused22', 'unused23', 'unused24', 'unused25', 'unused26',
+         'leven', 'lpspol', 'lovrok', 'lcalda', 'unused27']
+_CHARS = ['kstnm', 'kevnm', 'khole', 'ko', 'ka',
+          'kt0', 'kt1', 'kt2', 'kt3', 'kt4', 'kt5', 'kt6', 'kt7', 'kt8', 'kt9',
+          'kf', 'kuser0', 'kuser1', 'kuser2',
+          'kcmpnm', 'knetwk', 'kdatrd', 'kinst']
+
+SACH_DTYPE = np.dtype([(n, '=f4') for n in _FLOATS] +
+                      [(n, '=i4') for n in _INTS] +
+                      [(n, 'S16' if n == 'kevnm' else 'S8') for n in _CHARS])
+
+# Moment structure - same order as Moment in "lib/saocore.h"
+MOMENT_DTYPE = np.dtype([(n, '=i2') for n in
+                         ['year', 'month', 'day', 'yday',
+                          'hour', 'min', 'sec', 'msec']])
+
+assert SACH_DTYPE.itemsize == _sao.SACH_SIZE
+assert MOMENT_DTYPE.itemsize == _sao.MOMENT_SIZE
+
+SacFile = _sao.SacFile
+
+
+def read_sac(path):
+    """Map SAC file and return (header, samples) without copying.
+
+    Header is a 0-d structured array of SACH_DTYPE, samples are float32.
+    Both are read-only views of the file, which stays mapped while any
+    of them is alive.
+    """
+    f = SacFile(path)
+    hdr = np.frombuffer(f, dtype=SACH_DTYPE, count=1).reshape(())
+    data = np.frombuffer(f, dtype='=f4', count=f.npts,
+                         offset=SACH_DTYPE.itemsize)
+    return hdr, data
+
+
+def read_headers(paths):
+    """Read headers of many SAC files into one structured array.
+
+    Headers of unreadable files are undefined (all fields -12345),
+    valid SAC headers have 'internal4' equal to 6.
+    """
+    paths = list(paths)
+    out = np.empty(len(paths), dtype=SACH_DTYPE)
+    _sao.read_headers(paths, out)
+    return out
+
+
+def sac_begin(hdr):
+    """Epoch time of the first sample for header(s), like getSacBegin()."""
+    hdr = np.asarray(hdr, dtype=SACH_DTYPE)
+    t = np.zeros(hdr.shape, dtype=MOMENT_DTYPE)
+    for m, h in (('year', 'nzyear'), ('yday', 'nzjday'), ('hour', 'nzhour'),
+                 ('min', 'nzmin'), ('sec', 'nzsec'), ('msec', 'nzmsec')):
+        t[m] = hdr[h]
+    return to_epoch(t) + hdr['b']
+
+
+def to_epoch(moments):
+    """Epoch times (float64) of an array of MOMENT_DTYPE."""
+    moments = np.ascontiguousarray(moments, dtype=MOMENT_DTYPE)
+    out = np.empty(moments.shape, dtype=np.float64)
+    _sao.to_epoch(moments, out)
+    return out
+
+
+def from_epoch(epochs):
+    """Array of MOMENT_DTYPE for epoch times."""
+    epochs = np.ascontiguousarray(epochs, dtype=np.float64)
+    out = np.empty(epochs.shape, dtype=MOMENT_DTYPE)
+    _sao.from_epoch(epochs, out)
+    return out
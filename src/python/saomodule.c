@@ -0,0 +1,269 @@
+/*******************************************************************************
+**  saomodule.c - CPython extension '_sao' for SAO libraries
+**      Part of Seismicity Analysis Organizer
+**
+**  This module is a thin layer between SAO libraries and NumPy arrays,
+**  see "sao.py" for the Python interface built on top of it.
+**  Module does not depend on NumPy headers - all data are passed through
+**  the buffer protocol, so NumPy arrays are filled and viewed in place:
+**    SacFile(..)       - SAC file mapped into memory as a read-only buffer
+**    read_headers(..)  - read headers of many files into one buffer
+**    to_epoch(..)      - epoch times of Moment array
+**    from_epoch(..)    - Moment array of epoch times
+**  Loops over files and arrays run without GIL
+*******************************************************************************/
+#define PY_SSIZE_T_CLEAN
+#include <Python.h>
+#include <structmember.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "../../lib/saocore.h"
+#include "../../lib/saosys.h"
+
+
+
+/*******************************************************************************
+**    SacFile type - SAC file mapped into memory
+**  Object exports the whole file as a read-only buffer, so NumPy views of
+**  header and data keep it alive and the file is unmapped with the last one.
+**  Object is initialised once - mapping can not change under exported views
+*/
+typedef struct {
+  PyObject_HEAD
+  SacMap    map;
+  PyObject *path;
+}  SacFileObject;
+
+static int
+SacFile_init (SacFileObject *self, PyObject *args, PyObject *kwds)
+{
+  PyObject *path = NULL;   int ret;
+  if (!PyArg_ParseTuple(args, "O&", PyUnicode_FSConverter, &path))
+    return -1;
+  if (self->map.hdr != NULL) {
+    PyErr_SetString(PyExc_ValueError, "SAC file is already mapped");
+    Py_DECREF(path);
+    return -1;
+  }
+  Py_BEGIN_ALLOW_THREADS
+  ret = mapSac(PyBytes_AS_STRING(path), &self->map);
+  Py_END_ALLOW_THREADS
+  if (ret != 0) {
+    PyErr_Format(PyExc_OSError, "can not map SAC file '%s'",
+                 PyBytes_AS_STRING(path));
+    Py_DECREF(path);
+    return -1;
+  }
+  Py_XSETREF(self->path, path);
+  return 0;
+}
+
+static void
+SacFile_dealloc (SacFileObject *self)
+{
+  unmapSac(&self->map);
+  Py_XDECREF(self->path);
+  Py_TYPE(self)->tp_free((PyObject*)self);
+}
+
+static int
+SacFile_getbuffer (SacFileObject *self, Py_buffer *view, int flags)
+{
+  if (self->map.hdr == NULL) {
+    PyErr_SetString(PyExc_ValueError, "SAC file is not mapped");
+    view->obj = NULL;
+    return -1;
+  }
+  return PyBuffer_FillInfo(view, (PyObject*)self, self->map.hdr,
+                           self->map.size, 1, flags);
+}
+
+static PyObject*
+SacFile_getnpts (SacFileObject *self, void *closure)
+{
+  return PyLong_FromLong(self->map.npts);
+}
+
+static PyBufferProcs SacFile_as_buffer = {
+  (getbufferproc) SacFile_getbuffer, NULL
+};
+
+static PyMemberDef SacFile_members[] = {
+  {"path", T_OBJECT, offsetof(SacFileObject, path), READONLY,
+   "path to SAC file (bytes)"},
+  {NULL}
+};
+
+static PyGetSetDef SacFile_getset[] = {
+  {"npts", (getter) SacFile_getnpts, NULL,
+   "number of samples available in the file", NULL},
+  {NULL}
+};
+
+static PyTypeObject SacFileType = {
+  PyVarObject_HEAD_INIT(NULL, 0)
+  .tp_name      = "_sao.SacFile",
+  .tp_doc       = "SacFile(path) - SAC file mapped into memory as a buffer",
+  .tp_basicsize = sizeof(SacFileObject),
+  .tp_flags     = Py_TPFLAGS_DEFAULT,
+  .tp_new       = PyType_GenericNew,
+  .tp_init      = (initproc) SacFile_init,
+  .tp_dealloc   = (destructor) SacFile_dealloc,
+  .tp_as_buffer = &SacFile_as_buffer,
+  .tp_members   = SacFile_members,
+  .tp_getset    = SacFile_getset,
+};
+/******************************************************************************/
+
+
+
+/*******************************************************************************
+**    Read headers of many files into one buffer
+**      OUT: Number of valid SAC headers
+**      IN1: Sequence of paths
+**      IN2: Writable buffer for len(paths) headers
+**  Header of a file which could not be read is set to UNDEFINED_SACH
+**  Files are read in batch by readSacHs(..), see "saoaio.c"
+*/
+static void
+copyHeader (void *ctx, long i, int status, const SacH *hdr)
+{
+  ((SacH*) ctx)[i] = *hdr;
+}
+
+static PyObject*
+sao_read_headers (PyObject *self, PyObject *args)
+{
+  PyObject *seq, *fast, **items, **paths;   Py_buffer out;
+  Py_ssize_t i, n;   long nok = 0;   char **names;
+
+  if (!PyArg_ParseTuple(args, "Ow*", &seq, &out)) return NULL;
+  if ((fast = PySequence_Fast(seq, "paths should be a sequence")) == NULL) {
+    PyBuffer_Release(&out);
+    return NULL;
+  }
+  n = PySequence_Fast_GET_SIZE(fast);
+  items = PySequence_Fast_ITEMS(fast);
+  if (out.len < n * (Py_ssize_t)sizeof(SacH)) {
+    PyErr_SetString(PyExc_ValueError, "buffer is too small for headers");
+    goto fail;
+  }
+  if ((paths = (PyObject**) PyMem_Calloc(n + 1, sizeof(PyObject*))) == NULL) {
+    PyErr_NoMemory();
+    goto fail;
+  }
+  for (i = 0; i < n; i++)
+    if (!PyUnicode_FSConverter(items[i], &paths[i])) {
+      while (i-- > 0) Py_DECREF(paths[i]);
+      PyMem_Free(paths);
+      goto fail;
+    }
+  if ((names = (char**) PyMem_Calloc(n + 1, sizeof(char*))) == NULL) {
+    for (i = 0; i < n; i++) Py_DECREF(paths[i]);
+    PyMem_Free(paths);
+    PyErr_NoMemory();
+    goto fail;
+  }
+
+  for (i = 0; i < n; i++) names[i] = PyBytes_AS_STRING(paths[i]);
+  Py_BEGIN_ALLOW_THREADS
+  nok = readSacHs(names, n, 0, copyHeader, out.buf);
+  Py_END_ALLOW_THREADS
+
+  for (i = 0; i < n; i++) Py_DECREF(paths[i]);
+  PyMem_Free(paths);
+  PyMem_Free(names);
+  Py_DECREF(fast);
+  PyBuffer_Release(&out);
+  if (nok < 0) return PyErr_NoMemory();
+  return PyLong_FromLong(nok);
+
+fail:
+  Py_DECREF(fast);
+  PyBuffer_Release(&out);
+  return NULL;
+}
+/******************************************************************************/
+
+
+
+/*******************************************************************************
+**    Epoch times of Moment array and vice versa
+**      IN1: Buffer of Moment structures (epoch times) to convert
+**      IN2: Writable buffer for epoch times (Moment structures)
+*/
+static PyObject*
+sao_to_epoch (PyObject *self, PyObject *args)
+{
+  Py_buffer in, out;   Py_ssize_t i, n;   Moment *t;   double *e;
+  if (!PyArg_ParseTuple(args, "y*w*", &in, &out)) return NULL;
+  n = in.len / sizeof(Moment);
+  if (in.len % sizeof(Moment) != 0 || out.len != n * (Py_ssize_t)sizeof(double)) {
+    PyBuffer_Release(&in);  PyBuffer_Release(&out);
+    PyErr_SetString(PyExc_ValueError, "buffers do not match");
+    return NULL;
+  }
+  t = (Moment*) in.buf;   e = (double*) out.buf;
+  Py_BEGIN_ALLOW_THREADS
+  for (i = 0; i < n; i++) e[i] = toEpoch(t[i]);
+  Py_END_ALLOW_THREADS
+  PyBuffer_Release(&in);  PyBuffer_Release(&out);
+  Py_RETURN_NONE;
+}
+
+static PyObject*
+sao_from_epoch (PyObject *self, PyObject *args)
+{
+  Py_buffer in, out;   Py_ssize_t i, n;   Moment *t;   double *e;
+  if (!PyArg_ParseTuple(args, "y*w*", &in, &out)) return NULL;
+  n = in.len / sizeof(double);
+  if (in.len % sizeof(double) != 0 || out.len != n * (Py_ssize_t)sizeof(Moment)) {
+    PyBuffer_Release(&in);  PyBuffer_Release(&out);
+    PyErr_SetString(PyExc_ValueError, "buffers do not match");
+    return NULL;
+  }
+  e = (double*) in.buf;   t = (Moment*) out.buf;
+  Py_BEGIN_ALLOW_THREADS
+  for (i = 0; i < n; i++) t[i] = fromEpoch(e[i]);
+  Py_END_ALLOW_THREADS
+  PyBuffer_Release(&in);  PyBuffer_Release(&out);
+  Py_RETURN_NONE;
+}
+/******************************************************************************/
+
+
+
+/*******************************************************************************
+**    Module definition
+*/
+static PyMethodDef sao_methods[] = {
+  {"read_headers", sao_read_headers, METH_VARARGS,
+   "read_headers(paths, out) - read SAC headers into buffer, return valid"},
+  {"to_epoch", sao_to_epoch, METH_VARARGS,
+   "to_epoch(moments, out) - epoch times of Moment buffer"},
+  {"from_epoch", sao_from_epoch, METH_VARARGS,
+   "from_epoch(epochs, out) - Moment buffer of epoch times"},
+  {NULL, NULL, 0, NULL}
+};
+
+static struct PyModuleDef sao_module = {
+  PyModuleDef_HEAD_INIT, "_sao",
+  "Seismicity Analysis Organizer libraries, see module 'sao'", -1,
+  sao_methods
+};
+
+PyMODINIT_FUNC
+PyInit__sao (void)
+{
+  PyObject *m;
+  if (PyType_Ready(&SacFileType) < 0) return NULL;
+  if ((m = PyModule_Create(&sao_module)) == NULL) return NULL;
+  Py_INCREF(&SacFileType);
+  PyModule_AddObject(m, "SacFile", (PyObject*)&SacFileType);
+  PyModule_AddIntConstant(m, "SACH_SIZE", sizeof(SacH));
+  PyModule_AddIntConstant(m, "MOMENT_SIZE", sizeof(Moment));
+  return m;
+}
+/******************************************************************************/
@@ -0,0 +1,423 @@
+/******************************************************************************
+**  saoaio.c - asynchronous batch reading of SAC headers
+**              part of SAO system library -> see "lib/saosys.h"
+**
+**    Core functions:
+**  readSacHs(..)   - read headers of many files and pass them to a callback
+**
+**  On Linux the files are opened, read and closed by io_uring: each file is
+**  a chain of three linked requests (openat into a registered file slot,
+**  read of the header, close of the slot), and up to AIO_WINDOW files are in
+**  flight at once. Ring is driven by raw system calls, so no liburing is
+**  needed. Without io_uring (other OS, old kernel, disabled by sysctl or
+**  by SAO_NO_URING environment variable) files are read by threads.
+*******************************************************************************/
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#if defined(__linux__) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#define SAO_URING 1
+#include <errno.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+#endif
+#endif
+
+#include "../../lib/saocore.h"
+#include "../../lib/saosys.h"
+#include "../../lib/saoprof.h"
+
+
+
+#define AIO_WINDOW  256         // Files in flight with io_uring
+#define AIO_CHUNK   4096        // Files read by threads between callbacks
+#define AIO_THREADS 4           // Threads per processor (reads mostly wait)
+
+
+
+/*******************************************************************************
+**    Read header of one file
+**      OUT: SAO_OK, SAO_EIO - can not open, SAO_ENOSAC - not a SAC file
+*/
+static int
+readOne (const char *path, SacH *hdr)
+{
+  int fd = open(path, O_RDONLY | O_CLOEXEC), ret = SAO_ENOSAC;
+  SAO_COUNT(SAO_ST_OPEN, 0);
+  if (fd < 0) { *hdr = UNDEFINED_SACH;  return SAO_EIO; }
+  if (pread(fd, hdr, sizeof(SacH), 0) != sizeof(SacH)) *hdr = UNDEFINED_SACH;
+  else if (hdr->internal4 == 6) ret = SAO_OK;
+  close(fd);
+  return ret;
+}
+/******************************************************************************/
+
+
+
+/*******************************************************************************
+**    Thread-pool reading - files are read in parallel by chunks, callback
+**  gets headers of a chunk in order of files before the next chunk starts.
+**  Reading of a chunk is timed as one readSacH call with bytes of valid
+**  headers, opens are only counted (their time is in the chunk).
+*/
+typedef struct {
+  char    **paths;
+  SacH     *hdr;
+  int      *status;
+}  AioChunk;
+
+static void
+readTask (void *ctx, long i)
+{
+  AioChunk *ac = (AioChunk*) ctx;
+  ac->status[i] = readOne(ac->paths[i], &ac->hdr[i]);
+}
+
+static long
+readThreads (char **paths, long n, int nthreads, SacHCallback cb, void *ctx)
+{
+  AioChunk ac;   long i, j, k, nok = 0, valid;
+  if (nthreads <= 0) nthreads = AIO_THREADS * getNumThreads();
+  ac.hdr = (SacH*) malloc(AIO_CHUNK * sizeof(SacH));
+  ac.status = (int*) malloc(AIO_CHUNK * sizeof(int));
+  if (ac.hdr == NULL || ac.status == NULL) {
+    free(ac.hdr);  free(ac.status);
+    return SAO_ESPACE;
+  }
+  SAO_COUNT(SAO_ST_ALLOC, AIO_CHUNK * sizeof(SacH));
+  SAO_COUNT(SAO_ST_ALLOC, AIO_CHUNK * sizeof(int));
+  for (i = 0; i < n; i += k) {
+    k = (n - i < AIO_CHUNK) ? n - i : AIO_CHUNK;
+    ac.paths = paths + i;
+    SAO_PROBE_START(t0);
+    runParallel(nthreads, k, readTask, &ac);
+    for (valid = j = 0; j < k; j++)
+      if (ac.status[j] == SAO_OK) valid++;
+    SAO_PROBE_STOP(SAO_ST_READSACH, t0, valid * sizeof(SacH));
+    nok += valid;
+    for (j = 0; j < k; j++) cb(ctx, i + j, ac.status[j], &ac.hdr[j]);
+  }
+  free(ac.hdr);  free(ac.status);
+  return nok;
+}
+/******************************************************************************/
+
+
+
+#ifdef SAO_URING
+/*******************************************************************************
+**    Ring of io_uring instance mapped into memory
+*/
+typedef struct {
+  int       fd;
+  unsigned *sqhead, *sqtail, *sqmask, *sqarray;
+  unsigned *cqhead, *cqtail, *cqmask;
+  struct io_uring_sqe *sqes;
+  struct io_uring_cqe *cqes;
+  void     *sqmap,  *cqmap;
+  size_t    sqsize,  cqsize,  sqesize;
+  unsigned  entries;
+}  AioRing;
+
+/*  Files in flight - slot of a file is its index modulo AIO_WINDOW  */
+typedef struct {
+  SacH      hdr[AIO_WINDOW];
+  int       status[AIO_WINDOW];
+  int       pending[AIO_WINDOW];    // Requests of the chain not completed
+}  AioSlots;
+
+
+
+/*******************************************************************************
+**    Unmap ring and close io_uring instance
+*/
+static void
+closeUring (AioRing *r)
+{
+  if (r->sqes != NULL) munmap(r->sqes, r->sqesize);
+  if (r->cqmap != NULL && r->cqmap != r->sqmap) munmap(r->cqmap, r->cqsize);
+  if (r->sqmap != NULL) munmap(r->sqmap, r->sqsize);
+  close(r->fd);
+}
+/******************************************************************************/
+
+
+
+/*******************************************************************************
+**    Set up io_uring instance with AIO_WINDOW registered file slots
+**      OUT: SAO_OK or SAO_EIO if io_uring can not be used
+**      OUT: Pointer to AioRing structure
+**  Direct open and close of registered slots are required (Linux 5.15),
+**  setup fails on kernels without submission of all requests (5.18)
+*/
+static int
+openUring (AioRing *r)
+{
+  struct io_uring_params p;   int files[AIO_WINDOW], i;
+  char *sq, *cq;
+
+  memset(r, 0, sizeof(AioRing));
+  memset(&p, 0, sizeof(p));
+  p.flags = IORING_SETUP_SUBMIT_ALL;
+  r->fd = syscall(__NR_io_uring_setup, 4 * AIO_WINDOW, &p);
+  if (r->fd < 0) return SAO_EIO;
+  r->entries = p.sq_entries;
+  if (r->entries < 3 * AIO_WINDOW || p.cq_entries < 3 * AIO_WINDOW) {
+    close(r->fd);
+    return SAO_EIO;
+  }
+
+  r->sqsize = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+  r->cqsize = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+  if (p.features & IORING_FEAT_SINGLE_MMAP) {
+    if (r->cqsize > r->sqsize) r->sqsize = r->cqsize;
+    r->cqsize = r->sqsize;
+  }
+  r->sqmap = mmap(NULL, r->sqsize, PROT_READ | PROT_WRITE,
+                  MAP_SHARED | MAP_POPULATE, r->fd, IORING_OFF_SQ_RING);
+  if (r->sqmap == MAP_FAILED) { r->sqmap = NULL;  goto fail; }
+  if (p.features & IORING_FEAT_SINGLE_MMAP) r->cqmap = r->sqmap;
+  else {
+    r->cqmap = mmap(NULL, r->cqsize, PROT_READ | PROT_WRITE,
+                    MAP_SHARED | MAP_POPULATE, r->fd, IORING_OFF_CQ_RING);
+    if (r->cqmap == MAP_FAILED) { r->cqmap = NULL;  goto fail; }
+  }
+  r->sqesize = p.sq_entries * sizeof(struct io_uring_sqe);
+  r->sqes = mmap(NULL, r->sqesize, PROT_READ | PROT_WRITE,
+                 MAP_SHARED | MAP_POPULATE, r->fd, IORING_OFF_SQES);
+  if (r->sqes == MAP_FAILED) { r->sqes = NULL;  goto fail; }
+
+  sq = (char*) r->sqmap;   cq = (char*) r->cqmap;
+  r->sqhead  = (unsigned*)(sq + p.sq_off.head);
+  r->sqtail  = (unsigned*)(sq + p.sq_off.tail);
+  r->sqmask  = (unsigned*)(sq + p.sq_off.ring_mask);
+  r->sqarray = (unsigned*)(sq + p.sq_off.array);
+  r->cqhead  = (unsigned*)(cq + p.cq_off.head);
+  r->cqtail  = (unsigned*)(cq + p.cq_off.tail);
+  r->cqmask  = (unsigned*)(cq + p.cq_off.ring_mask);
+  r->cqes    = (struct io_uring_cqe*)(cq + p.cq_off.cqes);
+
+  for (i = 0; i < AIO_WINDOW; i++) files[i] = -1;
+  if (syscall(__NR_io_uring_register, r->fd, IORING_REGISTER_FILES,
+              files, AIO_WINDOW) < 0) goto fail;
+  return SAO_OK;
+
+fail:
+  closeUring(r);
+  return SAO_EIO;
+}
+/******************************************************************************/
+
+
+
+/*******************************************************************************
+**    Put chain of openat, read and close requests of one file into SQ ring
+**      IN1: Pointer to AioRing structure
+**      IN2: Path of the file
+**      IN3: Index of the file
+**      IN4: Header buffer of the slot
+**  Requests are hard-linked, so close is done even after a failed read.
+**  Index of the file and number of request are kept in user_data.
+*/
+static void
+queueFile (AioRing *r, const char *path, long i, SacH *hdr)
+{
+  unsigned tail = *r->sqtail, slot = i % AIO_WINDOW, k;
+  struct io_uring_sqe *sqe;
+
+  for (k = 0; k < 3; k++) {
+    sqe = &r->sqes[(tail + k) & *r->sqmask];
+    memset(sqe, 0, sizeof(struct io_uring_sqe));
+    sqe->user_data = ((uint64_t)i << 2) | k;
+    r->sqarray[(tail + k) & *r->sqmask] = (tail + k) & *r->sqmask;
+  }
+  sqe = &r->sqes[tail & *r->sqmask];
+  sqe->opcode = IORING_OP_OPENAT;
+  sqe->fd = AT_FDCWD;
+  sqe->addr = (uint64_t)(uintptr_t) path;
+  sqe->open_flags = O_RDONLY;         // O_CLOEXEC is refused for slots
+  sqe->file_index = slot + 1;
+  sqe->flags = IOSQE_IO_HARDLINK;
+
+  sqe = &r->sqes[(tail + 1) & *r->sqmask];
+  sqe->opcode = IORING_OP_READ;
+  sqe->fd = slot;
+  sqe->addr = (uint64_t)(uintptr_t) hdr;
+  sqe->len = sizeof(SacH);
+  sqe->flags = IOSQE_FIXED_FILE | IOSQE_IO_HARDLINK;
+
+  sqe = &r->sqes[(tail + 2) & *r->sqmask];
+  sqe->opcode = IORING_OP_CLOSE;
+  sqe->file_index = slot + 1;
+
+  __atomic_store_n(r->sqtail, tail + 3, __ATOMIC_RELEASE);
+}
+/******************************************************************************/
+
+
+
+/*******************************************************************************
+**    Wait for all requests in flight before their buffers are freed
+**      OUT: SAO_OK or SAO_EIO - ring does not work, buffers must be kept
+**      IN1: Pointer to AioRing structure
+**      IN2: Requests queued and not completed yet
+**  Requests are cancelled at first (Linux 5.19), then all completions
+**  (cancelled ones too) are waited for, cancel has user_data AIO_CANCEL
+*/
+#define AIO_CANCEL  (~(uint64_t)0)
+
+static int
+drainUring (AioRing *r, long inflight)
+{
+  unsigned head, tail, queued;   int ret;
+#ifdef IORING_ASYNC_CANCEL_ANY
+  unsigned stail = *r->sqtail;   struct io_uring_sqe *sqe;
+
+  if (stail - __atomic_load_n(r->sqhead, __ATOMIC_ACQUIRE) < r->entries) {
+    sqe = &r->sqes[stail & *r->sqmask];
+    memset(sqe, 0, sizeof(struct io_uring_sqe));
+    sqe->opcode = IORING_OP_ASYNC_CANCEL;
+    sqe->cancel_flags = IORING_ASYNC_CANCEL_ANY;
+    sqe->user_data = AIO_CANCEL;
+    r->sqarray[stail & *r->sqmask] = stail & *r->sqmask;
+    __atomic_store_n(r->sqtail, stail + 1, __ATOMIC_RELEASE);
+  }
+#endif
+  while (inflight > 0) {
+    queued = *r->sqtail - __atomic_load_n(r->sqhead, __ATOMIC_ACQUIRE);
+    ret = syscall(__NR_io_uring_enter, r->fd, queued, 1,
+                  IORING_ENTER_GETEVENTS, NULL, 0);
+    if (ret < 0 && errno != EINTR) return SAO_EIO;
+    head = *r->cqhead;
+    tail = __atomic_load_n(r->cqtail, __ATOMIC_ACQUIRE);
+    for (; head != tail; head++)
+      if (r->cqes[head & *r->cqmask].user_data != AIO_CANCEL) inflight--;
+    __atomic_store_n(r->cqhead, head, __ATOMIC_RELEASE);
+  }
+  return SAO_OK;
+}
+/******************************************************************************/
+
+
+
+/*******************************************************************************
+**    Read headers by io_uring
+**      OUT: Number of SAC headers or SAO_EIO if ring failed at start
+**  Window of files slides over the list: a file is passed to callback when
+**  all its requests and requests of previous files are completed, then its
+**  slot is given to the next file. If the ring fails on the way, requests
+**  in flight are drained (or their buffers are leaked if it is impossible)
+**  and files which were not passed to callback yet are read by threads.
+**  Each batch (submission and completions) is timed as one readSacH call.
+*/
+static long
+readUring (char **paths, long n, int nthreads, SacHCallback cb, void *ctx)
+{
+  AioRing r;   AioSlots *s;   struct io_uring_cqe *cqe;
+  long next = 0, done = 0, nok = 0, rest, i, k, valid, inflight = 0;
+  unsigned head, tail, queued, slot;   int ret = 0;
+
+  if (openUring(&r) != SAO_OK) return SAO_EIO;
+  if ((s = (AioSlots*) malloc(sizeof(AioSlots))) == NULL) {
+    closeUring(&r);
+    return SAO_EIO;
+  }
+  SAO_COUNT(SAO_ST_ALLOC, sizeof(AioSlots));
+
+  while (done < n) {
+    for (; next < n && next < done + AIO_WINDOW; next++) {
+      slot = next % AIO_WINDOW;
+      s->status[slot] = SAO_OK;   s->pending[slot] = 3;
+      queueFile(&r, paths[next], next, &s->hdr[slot]);
+      inflight += 3;
+    }
+    SAO_PROBE_START(t0);
+    queued = *r.sqtail - __atomic_load_n(r.sqhead, __ATOMIC_ACQUIRE);
+    ret = syscall(__NR_io_uring_enter, r.fd, queued, 1,
+                  IORING_ENTER_GETEVENTS, NULL, 0);
+    if (ret < 0 && errno != EINTR) {
+      SAO_PROBE_STOP(SAO_ST_READSACH, t0, 0);
+      break;
+    }
+    ret = 0;
+
+    head = *r.cqhead;
+    tail = __atomic_load_n(r.cqtail, __ATOMIC_ACQUIRE);
+    for (; head != tail; head++) {
+      cqe = &r.cqes[head & *r.cqmask];
+      i = cqe->user_data >> 2;   slot = i % AIO_WINDOW;
+      switch (cqe->user_data & 3) {
+        case 0:
+          SAO_COUNT(SAO_ST_OPEN, 0);
+          if (cqe->res < 0) s->status[slot] = SAO_EIO;
+          break;
+        case 1:
+          if (cqe->res != sizeof(SacH) && s->status[slot] == SAO_OK)
+            s->status[slot] = SAO_ENOSAC;
+          break;
+      }
+      s->pending[slot]--;   inflight--;
+    }
+    __atomic_store_n(r.cqhead, head, __ATOMIC_RELEASE);
+
+    for (valid = 0, k = done; k < next && s->pending[k % AIO_WINDOW] == 0;
+         k++) {
+      slot = k % AIO_WINDOW;
+      if (s->status[slot] != SAO_OK) s->hdr[slot] = UNDEFINED_SACH;
+      else if (s->hdr[slot].internal4 != 6) s->status[slot] = SAO_ENOSAC;
+      else valid++;
+    }
+    SAO_PROBE_STOP(SAO_ST_READSACH, t0, valid * sizeof(SacH));
+    nok += valid;
+    for (; done < k; done++)
+      cb(ctx, done, s->status[done % AIO_WINDOW], &s->hdr[done % AIO_WINDOW]);
+  }
+
+  if (ret < 0 && inflight > 0 && drainUring(&r, inflight) != SAO_OK)
+    s = NULL;                   // Kernel may still write into slots
+  closeUring(&r);
+  free(s);
+  if (done < n) {
+    rest = readThreads(paths + done, n - done, nthreads, cb, ctx);
+    if (rest < 0) return rest;
+    nok += rest;
+  }
+  return nok;
+}
+/******************************************************************************/
+#endif
+
+
+
+/*******************************************************************************
+**    Read headers of many files and pass them to a callback
+**      OUT: Number of SAC headers read or SAO_ESPACE if there is no memory
+**      IN1: Paths of files
+**      IN2: Number of files
+**      IN3: Number of threads if io_uring is not available (0 or less means
+**           4 threads per processor)
+**      IN4: Callback called as cb(ctx, i, status, hdr) for each file
+**      IN5: Context pointer passed to callback
+**  Callback is called from the calling thread in order of files. Status is
+**  SAO_OK, SAO_EIO if file can not be opened or SAO_ENOSAC if it is too
+**  short or not a SAC file; header is UNDEFINED_SACH if it was not read.
+**  Header pointer is valid only during the call.
+*/
+long
+readSacHs (char **paths, long n, int nthreads, SacHCallback cb, void *ctx)
+{
+  if (n <= 0) return 0;
+#ifdef SAO_URING
+  if (getenv("SAO_NO_URING") == NULL) {
+    long ret = readUring(paths, n, nthreads, cb, ctx);
+    if (ret != SAO_EIO) return ret;
+  }
+#endif
+  return readThreads(paths, n, nthreads, cb, ctx);
+}
+/******************************************************************************/
@@ -0,0 +1,367 @@
+/******************************************************************************
+**  saodir.c - parallel recursive search of files in directory trees
+**              part of SAO system library -> see "lib/saosys.h"
+**
+**    Core functions:
+**  findFiles(..)   - find files matching filters in a directory tree
+**  freeFiles(..)   - free list of files from findFiles(..)
+**
+**  Each thread keeps a deque of directories to read: it takes the newest
+**  directory of its own deque and, when the deque is empty, steals the
+**  oldest one (usually the largest subtree) from other threads. Entries
+**  are read by getdents64 on Linux (readdir elsewhere) and their type is
+**  taken from d_type, so stat is needed only for links and file systems
+**  which do not report the type.
+*******************************************************************************/
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <time.h>
+#include <fnmatch.h>
+#include <regex.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <sys/stat.h>
+#if defined(__linux__)
+#include <sys/syscall.h>
+#else
+#include <dirent.h>
+#endif
+
+#include "../../lib/saocore.h"
+#include "../../lib/saosys.h"
+#include "../../lib/saoprof.h"
+
+
+
+#define DIR_BUFSIZE (64 * 1024) // Buffer of getdents64 for one call
+
+
+
+/*  Deque of directories of one thread  */
+typedef struct {
+  pthread_mutex_t lock;
+  char    **dirs;
+  long      head, tail, cap;    // Thieves take at head, owner at tail
+}  WalkQueue;
+
+/*  Files found by one thread  */
+typedef struct {
+  char    **files;
+  long      n,    cap;
+}  WalkList;
+
+/*  Shared state of one findFiles(..) call  */
+typedef struct {
+  WalkQueue    *queue;
+  WalkList     *list;
+  int           nthreads;
+  size_t        rootlen;        // Length of root prefix in paths
+  const char   *glob;           // Pattern of file name or NULL
+  regex_t      *regex;          // Expression for relative path or NULL
+  atomic_long   pending;        // Directories queued and not read yet
+  atomic_int    failed;         // Memory allocation failed
+}  WalkCtx;
+
+#if defined(__linux__)
+/*  Entry returned by getdents64 (there is no declaration in libc)  */
+struct linux_dirent64 {
+  uint64_t        d_ino;
+  int64_t         d_off;
+  unsigned short  d_reclen;
+  unsigned char   d_type;
+  char            d_name[];
+};
+#ifndef DT_DIR
+#define DT_UNKNOWN  0
+#define DT_DIR      4
+#define DT_REG      8
+#define DT_LNK      10
+#endif
+#endif
+
+
+
+/*******************************************************************************
+**    Push directory to the tail of a deque
+**      OUT: SAO_OK or SAO_ESPACE if there is no memory
+*/
+static int
+pushDir (WalkQueue *q, char *dir)
+{
+  char **dirs;   long n;
+  pthread_mutex_lock(&q->lock);
+  if (q->tail == q->cap) {
+    n = q->tail - q->head;
+    if (q->head > 0 && n < q->cap / 2) {
+      memmove(q->dirs, q->dirs + q->head, n * sizeof(char*));
+    }
+    else {
+      dirs = (char**) realloc(q->dirs, 2 * (q->cap + 16) * sizeof(char*));
+      if (dirs == NULL) { pthread_mutex_unlock(&q->lock);  return SAO_ESPACE; }
+      q->dirs = dirs;   q->cap = 2 * (q->cap + 16);
+      SAO_COUNT(SAO_ST_ALLOC, q->cap * sizeof(char*));
+      if (q->head > 0) memmove(q->dirs, q->dirs + q->head, n * sizeof(char*));
+    }
+    q->head = 0;   q->tail = n;
+  }
+  q->dirs[q->tail++] = dir;
+  pthread_mutex_unlock(&q->lock);
+  return SAO_OK;
+}
+/******************************************************************************/
+
+
+
+/*******************************************************************************
+**    Take directory from a deque - newest for the owner, oldest for a thief
+**      OUT: Path of directory or NULL if the deque is empty
+*/
+static char*
+takeDir (WalkQueue *q, int steal)
+{
+  char *dir = NULL;
+  pthread_mutex_lock(&q->lock);
+  if (q->tail > q->head) dir = steal ? q->dirs[q->head++] : q->dirs[--q->tail];
+  if (q->tail == q->head) q->tail = q->head = 0;
+  pthread_mutex_unlock(&q->lock);
+  return dir;
+}
+/******************************************************************************/
+
+
+
+/*******************************************************************************
+**    Join directory and name of an entry into a new path
+*/
+static char*
+joinPath (const char *dir, const char *name)
+{
+  size_t ld = strlen(dir), ln = strlen(name);
+  char *path = (char*) malloc(ld + ln + 2);
+  if (path == NULL) return NULL;
+  SAO_COUNT(SAO_ST_ALLOC, ld + ln + 2);
+  memcpy(path, dir, ld);
+  if (ld == 0 || dir[ld-1] != '/') path[ld++] = '/';
+  memcpy(path + ld, name, ln + 1);
+  return path;
+}
+/******************************************************************************/
+
+
+
+/*******************************************************************************
+**    Handle one entry of a directory - queue subdirectory or add file
+**      IN1: Shared state
+**      IN2: Worker index
+**      IN3: Descriptor and path of the directory
+**      IN5: Name and d_type of the entry
+*/
+static void
+walkEntry (WalkCtx *wc, int id, int dfd, const char *dir,
+           const char *name, int type)
+{
+  WalkList *wl = &wc->list[id];   struct stat st;   char *path, **files;
+
+  if (name[0] == '.' && (name[1] == '\0' ||
+      (name[1] == '.' && name[2] == '\0'))) return;
+  if (type == DT_UNKNOWN || type == DT_LNK) {
+    if (fstatat(dfd, name, &st, 0) != 0) return;
+    if (S_ISREG(st.st_mode)) type = DT_REG;
+    else if (S_ISDIR(st.st_mode) && type == DT_UNKNOWN) type = DT_DIR;
+    else return;
+  }
+  if (type == DT_REG && wc->glob != NULL &&
+      fnmatch(wc->glob, name, 0) != 0) return;
+  if (type != DT_REG && type != DT_DIR) return;
+
+  if ((path = joinPath(dir, name)) == NULL) { wc->failed = 1;  return; }
+  if (type == DT_DIR) {
+    atomic_fetch_add(&wc->pending, 1);
+    if (pushDir(&wc->queue[id], path) != SAO_OK) {
+      atomic_fetch_sub(&wc->pending, 1);
+      free(path);   wc->failed = 1;
+    }
+    return;
+  }
+  if (wc->regex != NULL &&
+      regexec(wc->regex, path + wc->rootlen, 0, NULL, 0) != 0) {
+    free(path);
+    return;
+  }
+  if (wl->n == wl->cap) {
+    files = (char**) realloc(wl->files, 2 * (wl->cap + 64) * sizeof(char*));
+    if (files == NULL) { free(path);  wc->failed = 1;  return; }
+    wl->files = files;   wl->cap = 2 * (wl->cap + 64);
+    SAO_COUNT(SAO_ST_ALLOC, wl->cap * sizeof(char*));
+  }
+  wl->files[wl->n++] = path;
+}
+/******************************************************************************/
+
+
+
+/*******************************************************************************
+**    Read all entries of one directory
+*/
+static void
+walkDir (WalkCtx *wc, int id, const char *dir, char *buf)
+{
+  int dfd = open(dir, O_RDONLY | O_DIRECTORY | O_CLOEXEC);   long nread = 0;
+#if defined(__linux__)
+  struct linux_dirent64 *de;   long len, pos;
+#else
+  DIR *d;   struct dirent *de;
+#endif
+  SAO_PROBE_START(t0);
+  if (dfd < 0) return;
+#if defined(__linux__)
+  while ((len = syscall(SYS_getdents64, dfd, buf, DIR_BUFSIZE)) > 0) {
+    nread += len;
+    for (pos = 0; pos < len; pos += de->d_reclen) {
+      de = (struct linux_dirent64*)(buf + pos);
+      walkEntry(wc, id, dfd, dir, de->d_name, de->d_type);
+    }
+  }
+#else
+  (void) buf;
+  if ((d = fdopendir(dfd)) == NULL) { close(dfd);  return; }
+  while ((de = readdir(d)) != NULL) {
+    nread += sizeof(struct dirent);
+    walkEntry(wc, id, dfd, dir, de->d_name, de->d_type);
+  }
+  closedir(d);
+  dfd = -1;
+#endif
+  if (dfd >= 0) close(dfd);
+  SAO_PROBE_STOP(SAO_ST_DIR, t0, nread);
+}
+/******************************************************************************/
+
+
+
+/*******************************************************************************
+**    Worker - read directories of own deque, steal when it is empty and
+**  stop when no directory is queued or being read by any thread
+*/
+static void
+walkTask (void *ctx, long id)
+{
+  WalkCtx *wc = (WalkCtx*) ctx;   char *dir, *buf;   int k;
+  struct timespec nap = {0, 50000};
+
+  if ((buf = (char*) malloc(DIR_BUFSIZE)) == NULL) { wc->failed = 1;  return; }
+  SAO_COUNT(SAO_ST_ALLOC, DIR_BUFSIZE);
+  while (atomic_load(&wc->pending) > 0) {
+    dir = takeDir(&wc->queue[id], 0);
+    for (k = 1; dir == NULL && k < wc->nthreads; k++)
+      dir = takeDir(&wc->queue[(id + k) % wc->nthreads], 1);
+    if (dir == NULL) { nanosleep(&nap, NULL);  continue; }
+    walkDir(wc, (int)id, dir, buf);
+    free(dir);
+    atomic_fetch_sub(&wc->pending, 1);
+  }
+  free(buf);
+}
+/******************************************************************************/
+
+
+
+/*******************************************************************************
+**    Compare paths for qsort(..)
+*/
+static int
+cmpPath (const void *a, const void *b)
+{
+  return strcmp(*(char* const*)a, *(char* const*)b);
+}
+/******************************************************************************/
+
+
+
+/*******************************************************************************
+**    Find files matching filters in a directory tree
+**      OUT: Number of files found or negative status code:
+**           SAO_EIO     - root is not a readable directory
+**           SAO_EFORMAT - regular expression is incorrect
+**           SAO_ESPACE  - not enough memory
+**      IN1: Root directory
+**      IN2: Pattern of file name (shell glob, e.g. "*.BH?.*") or NULL
+**      IN3: Extended regular expression matched with path relative to the
+**           root (e.g. "^2019/IU/ANMO/") or NULL
+**      IN4: Number of threads (0 or less means all processors)
+**      OUT: Sorted list of paths, free it with freeFiles(..)
+**  Only regular files (and links to them) are listed, links to directories
+**  are not followed, so there are no cycles
+*/
+long
+findFiles (const char *root, const char *glob, const char *regex,
+           int nthreads, char ***files)
+{
+  WalkCtx wc;   regex_t re;   struct stat st;
+  long i, n = 0;   int k, ret = SAO_ESPACE;   char *dir;
+
+  *files = NULL;
+  if (stat(root, &st) != 0 || !S_ISDIR(st.st_mode)) return SAO_EIO;
+  if (regex != NULL && regcomp(&re, regex, REG_EXTENDED | REG_NOSUB) != 0)
+    return SAO_EFORMAT;
+  if (nthreads <= 0) nthreads = getNumThreads();
+
+  memset(&wc, 0, sizeof(WalkCtx));
+  wc.nthreads = nthreads;   wc.glob = glob;
+  wc.regex = (regex != NULL) ? &re : NULL;
+  wc.queue = (WalkQueue*) calloc(nthreads, sizeof(WalkQueue));
+  wc.list = (WalkList*) calloc(nthreads, sizeof(WalkList));
+  if (wc.queue == NULL || wc.list == NULL || (dir = joinPath(root, "")) == NULL)
+    goto done;
+  wc.rootlen = strlen(dir);
+  for (k = 0; k < nthreads; k++) pthread_mutex_init(&wc.queue[k].lock, NULL);
+  atomic_init(&wc.pending, 1);
+  atomic_init(&wc.failed, 0);
+  pushDir(&wc.queue[0], dir);
+
+  runParallel(nthreads, nthreads, walkTask, &wc);
+
+  for (k = 0; k < nthreads; k++) {
+    pthread_mutex_destroy(&wc.queue[k].lock);
+    free(wc.queue[k].dirs);
+    n += wc.list[k].n;
+  }
+  if (wc.failed == 0 && (*files = (char**) malloc((n + 1) * sizeof(char*)))) {
+    SAO_COUNT(SAO_ST_ALLOC, (n + 1) * sizeof(char*));
+    for (n = 0, k = 0; k < nthreads; k++)
+      for (i = 0; i < wc.list[k].n; i++) (*files)[n++] = wc.list[k].files[i];
+    qsort(*files, n, sizeof(char*), cmpPath);
+    (*files)[n] = NULL;
+    ret = SAO_OK;
+  }
+  else for (k = 0; k < nthreads; k++) {
+    for (i = 0; i < wc.list[k].n; i++) free(wc.list[k].files[i]);
+  }
+  for (k = 0; k < nthreads; k++) free(wc.list[k].files);
+
+done:
+  free(wc.queue);   free(wc.list);
+  if (regex != NULL) regfree(&re);
+  return (ret == SAO_OK) ? n : ret;
+}
+/******************************************************************************/
+
+
+
+/*******************************************************************************
+**    Free list of files from findFiles(..)
+**      IN1: List of paths
+**      IN2: Number of paths
+*/
+void
+freeFiles (char **files, long n)
+{
+  long i;
+  if (files == NULL) return;
+  for (i = 0; i < n; i++) free(files[i]);
+  free(files);
+}
+/******************************************************************************/
@@ -0,0 +1,160 @@
+/******************************************************************************
+**  saolod.c - functions for sidecar files with min/max envelopes of waveforms
+**              part of SAO system library -> see "lib/saosys.h"
+**
+**    Core functions:
+**  writeEnvelope(..) - build envelope of SAC file and write sidecar file
+**  mapEnvelope(..)   - map sidecar file of SAC file if it is up to date
+**  unmapEnvelope(..) - unmap sidecar file
+**
+**  Sidecar file "FILE.lod" is a header of 64 bytes and min/max pairs of all
+**  levels of the Envelope (see "saocore.h") in native byte order
+*******************************************************************************/
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "../../lib/saocore.h"
+#include "../../lib/saosys.h"
+
+
+
+/*  Header of sidecar file - 64 bytes  */
+typedef struct {
+  char      magic[8];           // "SAOLOD1"
+  int64_t   npts;               // Number of samples of the trace
+  int32_t   base, nlev;         // Samples per level 0 block, levels
+  double    b,    delta;        // First sample epoch time, sampling interval
+  int64_t   srcsize;            // Size of SAC file
+  int64_t   srcmtime;           // Modification time of SAC file
+  int64_t   unused;
+}  LodH;
+
+static const char LOD_MAGIC[8] = "SAOLOD1";
+
+
+
+/*******************************************************************************
+**    Get path of sidecar file (caller frees the string)
+*/
+static char*
+lodPath (const char *path, const char *ext)
+{
+  char *buf = (char*) malloc(strlen(path) + strlen(ext) + 1);
+  if (buf != NULL) sprintf(buf, "%s%s", path, ext);
+  return buf;
+}
+/******************************************************************************/
+
+
+
+/*******************************************************************************
+**    Build envelope of SAC file and write sidecar file
+**      OUT: SAO_OK, SAO_ENOSAC - not a SAC file, SAO_EIO - can not write
+**      IN1: Path to SAC file
+**      IN2: Samples per block of level 0, power of two not less than 4
+**  SAC file is mapped and passed once, levels are written straight into
+**  mapped sidecar file. Temporary file is renamed at the end, so readers
+**  never see a partially written sidecar.
+*/
+int
+writeEnvelope (const char *path, int base)
+{
+  SacMap sac;   Envelope env;   LodH hdr;   struct stat st;
+  char *tmp = NULL, *lod = NULL;   void *ptr;
+  long total;   size_t size;   int fd, ret = SAO_EIO;
+
+  if (mapSac(path, &sac) != SAO_OK) return SAO_ENOSAC;
+  if (stat(path, &st) != 0) goto done;
+  total = initEnvelope(&env, sac.npts, base,
+                       toEpoch(getSacBegin(*sac.hdr)), sac.hdr->delta);
+  if (total == 0) goto done;
+
+  memset(&hdr, 0, sizeof(LodH));
+  memcpy(hdr.magic, LOD_MAGIC, 8);
+  hdr.npts = env.npts;  hdr.base = env.base;  hdr.nlev = env.nlev;
+  hdr.b = env.b;        hdr.delta = env.delta;
+  hdr.srcsize = st.st_size;   hdr.srcmtime = st.st_mtime;
+  size = sizeof(LodH) + 2 * total * sizeof(float);
+
+  tmp = lodPath(path, ".lod.tmp");   lod = lodPath(path, ".lod");
+  if (tmp == NULL || lod == NULL) goto done;
+  if ((fd = open(tmp, O_RDWR | O_CREAT | O_TRUNC, 0644)) < 0) goto done;
+  if (ftruncate(fd, size) != 0) { close(fd);  unlink(tmp);  goto done; }
+  ptr = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close(fd);
+  if (ptr == MAP_FAILED) { unlink(tmp);  goto done; }
+
+  memcpy(ptr, &hdr, sizeof(LodH));
+  buildEnvelope(&env, sac.data, (float*)((char*)ptr + sizeof(LodH)));
+  munmap(ptr, size);
+  if (rename(tmp, lod) == 0) ret = SAO_OK;
+  else unlink(tmp);
+
+done:
+  free(tmp);  free(lod);
+  unmapSac(&sac);
+  return ret;
+}
+/******************************************************************************/
+
+
+
+/*******************************************************************************
+**    Map sidecar file of SAC file if it is up to date
+**      OUT: SAO_OK or SAO_EIO - no sidecar file or it is outdated
+**      IN1: Path to SAC file (not to the sidecar)
+**      OUT: Pointer to EnvMap structure
+**  Sidecar is outdated if size or modification time of SAC file changed
+*/
+int
+mapEnvelope (const char *path, EnvMap *emap)
+{
+  struct stat st, sst;   LodH hdr;   char *lod;
+  long total;   int fd;   void *ptr;
+
+  memset(emap, 0, sizeof(EnvMap));
+  if (stat(path, &sst) != 0 || (lod = lodPath(path, ".lod")) == NULL)
+    return SAO_EIO;
+  fd = open(lod, O_RDONLY);
+  free(lod);
+  if (fd < 0) return SAO_EIO;
+  if (fstat(fd, &st) != 0 || st.st_size < (off_t)sizeof(LodH) ||
+      pread(fd, &hdr, sizeof(LodH), 0) != sizeof(LodH) ||
+      memcmp(hdr.magic, LOD_MAGIC, 8) != 0 ||
+      hdr.srcsize != sst.st_size || hdr.srcmtime != sst.st_mtime) {
+    close(fd);
+    return SAO_EIO;
+  }
+  total = initEnvelope(&emap->env, hdr.npts, hdr.base, hdr.b, hdr.delta);
+  if (total == 0 || emap->env.nlev != hdr.nlev ||
+      st.st_size != (off_t)(sizeof(LodH) + 2 * total * sizeof(float))) {
+    close(fd);
+    return SAO_EIO;
+  }
+  ptr = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (ptr == MAP_FAILED) return SAO_EIO;
+  emap->map = ptr;   emap->size = st.st_size;
+  setEnvelope(&emap->env, (float*)((char*)ptr + sizeof(LodH)));
+  return SAO_OK;
+}
+/******************************************************************************/
+
+
+
+/*******************************************************************************
+**    Unmap sidecar file
+**      IN:  Pointer to EnvMap structure from mapEnvelope(..)
+*/
+void
+unmapEnvelope (EnvMap *emap)
+{
+  if (emap->map != NULL) munmap(emap->map, emap->size);
+  memset(emap, 0, sizeof(EnvMap));
+}
+/******************************************************************************/
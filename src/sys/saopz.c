@@ -0,0 +1,246 @@
+/******************************************************************************
+**  saopz.c - functions for SAC poles and zeros response files
+**              part of SAO system library -> see "lib/saosys.h"
+**
+**    Core functions:
+**  loadPZ(..)        - load SAC PZ file(s) into response cache
+**  findResponse(..)  - find response of a channel at a moment in the cache
+**  freeRespCache(..) - free responses of the cache
+**
+**  SAC PZ file has ZEROS, POLES and CONSTANT sections, responses written by
+**  rdseed or IRIS web services have comments with channel and epoch:
+**    * NETWORK   (KNETWK): IU
+**    * STATION    (KSTNM): ANMO
+**    * LOCATION   (KHOLE): 00
+**    * CHANNEL   (KCMPNM): BHZ
+**    * START             : 2002-11-19T21:07:00
+**    * END               : 2008-06-30T20:00:00
+**  Without comments channel is taken from file name like rdseed one
+**  "SAC_PZs_NET_STA_CHA_LOC_..." and response is valid at any time.
+**  One file may keep several responses one after another.
+*******************************************************************************/
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <sys/stat.h>
+
+#include "../../lib/saocore.h"
+#include "../../lib/saosys.h"
+
+
+
+/*  Channel and epoch of the response being read  */
+typedef struct {
+  char      net[9],  sta[9],  loc[9],  cha[9];   // As k-fields of SacH
+  double    t1,  t2;
+}  PzMeta;
+
+
+
+/*******************************************************************************
+**    Copy a field without leading and trailing blanks
+*/
+static void
+copyField (char *dst, size_t size, const char *src)
+{
+  size_t len;
+  while (*src == ' ' || *src == '\t') src++;
+  len = strcspn(src, "\r\n");
+  while (len > 0 && (src[len-1] == ' ' || src[len-1] == '\t')) len--;
+  if (len >= size) len = size - 1;
+  memcpy(dst, src, len);   dst[len] = '\0';
+  if (strcmp(dst, "--") == 0) dst[0] = '\0';
+}
+/******************************************************************************/
+
+
+
+/*******************************************************************************
+**    Channel of the file name "SAC_PZs_NET_STA_CHA_LOC_..." (default meta)
+*/
+static void
+metaOfName (PzMeta *m, const char *path)
+{
+  const char *name = strrchr(path, '/'), *p;   char *f[4];   int k;
+  memset(m, 0, sizeof(PzMeta));
+  m->t1 = -INFINITY;   m->t2 = INFINITY;
+  name = (name == NULL) ? path : name + 1;
+  if (strncmp(name, "SAC_PZs_", 8) != 0) return;
+  f[0] = m->net;   f[1] = m->sta;   f[2] = m->cha;   f[3] = m->loc;
+  for (p = name + 8, k = 0; k < 4; k++) {
+    size_t len = strcspn(p, "_");
+    if (len > 8) len = 8;
+    memcpy(f[k], p, len);   f[k][len] = '\0';
+    p += strcspn(p, "_");
+    if (*p == '_') p++;
+  }
+  if (strcmp(m->loc, "--") == 0) m->loc[0] = '\0';
+}
+/******************************************************************************/
+
+
+
+/*******************************************************************************
+**    Add response to the cache
+**      OUT: SAO_OK or SAO_ESPACE if there is no memory
+*/
+static int
+addResponse (RespCache *c, const PzMeta *m, const Response *r)
+{
+  RespEntry *e;
+  if (c->n == c->cap) {
+    e = (RespEntry*) realloc(c->entry, 2 * (c->cap + 8) * sizeof(RespEntry));
+    if (e == NULL) return SAO_ESPACE;
+    c->entry = e;   c->cap = 2 * (c->cap + 8);
+  }
+  e = &c->entry[c->n++];
+  snprintf(e->key, SAO_KEY_LEN, "%s.%s.%s.%s", m->net, m->sta, m->loc, m->cha);
+  e->t1 = m->t1;   e->t2 = m->t2;   e->resp = *r;
+  return SAO_OK;
+}
+/******************************************************************************/
+
+
+
+/*******************************************************************************
+**    Read responses of one SAC PZ file
+**      OUT: Number of responses or SAO_EIO, SAO_EFORMAT, SAO_ESPACE
+*/
+static long
+loadFile (RespCache *c, const char *path)
+{
+  FILE *f;   char line[256], tbuf[32], *v;   PzMeta m, base;   Response r;
+  Moment t;   double re, im;   long n = 0;   int mode = 0, k = 0, num;
+
+  if ((f = fopen(path, "r")) == NULL) return SAO_EIO;
+  metaOfName(&base, path);   m = base;
+  memset(&r, 0, sizeof(Response));
+  while (fgets(line, sizeof(line), f) != NULL) {
+    if (line[0] == '*') {
+      if ((v = strchr(line, ':')) == NULL) continue;
+      v++;
+      if (strncmp(line + 1, " NETWORK", 8) == 0) copyField(m.net, 9, v);
+      else if (strncmp(line + 1, " STATION", 8) == 0) copyField(m.sta, 9, v);
+      else if (strncmp(line + 1, " LOCATION", 9) == 0) copyField(m.loc, 9, v);
+      else if (strncmp(line + 1, " CHANNEL", 8) == 0) copyField(m.cha, 9, v);
+      else if (strncmp(line + 1, " START", 6) == 0 ||
+               strncmp(line + 1, " END", 4) == 0) {
+        copyField(tbuf, sizeof(tbuf), v);
+        if (strlen(tbuf) > 19) tbuf[19] = '\0';  // Drop fraction of seconds
+        if (line[2] == 'S')
+          m.t1 = (scanMoment(tbuf, &t) == SAO_OK) ? toEpoch(t) : -INFINITY;
+        else m.t2 = (scanMoment(tbuf, &t) == SAO_OK) ? toEpoch(t) : INFINITY;
+      }
+    }
+    else if (sscanf(line, " ZEROS %d", &num) == 1 ||
+             sscanf(line, " POLES %d", &num) == 1) {
+      if (num < 0 || num > RESP_MAXPZ) { n = SAO_EFORMAT;  break; }
+      mode = (strstr(line, "ZEROS") != NULL) ? 'z' : 'p';   k = 0;
+      if (mode == 'z') r.nzeros = num;  else r.npoles = num;
+    }
+    else if (sscanf(line, " CONSTANT %lf", &r.constant) == 1) {
+      if (addResponse(c, &m, &r) != SAO_OK) { n = SAO_ESPACE;  break; }
+      n++;   mode = 0;   m = base;
+      memset(&r, 0, sizeof(Response));
+    }
+    else if (mode != 0 && sscanf(line, "%lf %lf", &re, &im) == 2) {
+      if (mode == 'z' && k < r.nzeros) {
+        r.zeros[2*k] = re;   r.zeros[2*k+1] = im;   k++;
+      }
+      else if (mode == 'p' && k < r.npoles) {
+        r.poles[2*k] = re;   r.poles[2*k+1] = im;   k++;
+      }
+    }
+  }
+  fclose(f);
+  return n;
+}
+/******************************************************************************/
+
+
+
+/*******************************************************************************
+**    Compare responses by channel and beginning of epoch for qsort(..)
+*/
+static int
+cmpEntry (const void *a, const void *b)
+{
+  const RespEntry *ea = (const RespEntry*) a, *eb = (const RespEntry*) b;
+  int c = strcmp(ea->key, eb->key);
+  if (c != 0) return c;
+  return (ea->t1 > eb->t1) - (ea->t1 < eb->t1);
+}
+/******************************************************************************/
+
+
+
+/*******************************************************************************
+**    Load SAC PZ file(s) into response cache
+**      OUT: Number of loaded responses or negative status code:
+**           SAO_EIO - can not read path, SAO_EFORMAT - incorrect file,
+**           SAO_ESPACE - not enough memory
+**      IN1: Pointer to RespCache structure (zero filled before first use)
+**      IN2: Path to SAC PZ file or directory with them (all files of the
+**           directory tree are read, files without responses are skipped)
+**  Responses are sorted after loading, pointers from findResponse(..) are
+**  valid until the next loadPZ(..) or freeRespCache(..)
+*/
+long
+loadPZ (RespCache *c, const char *path)
+{
+  struct stat st;   char **files;   long n = 0, nf, i, k;
+  if (stat(path, &st) != 0) return SAO_EIO;
+  if (S_ISDIR(st.st_mode)) {
+    if ((nf = findFiles(path, NULL, NULL, 0, &files)) < 0) return nf;
+    for (i = 0; i < nf && n >= 0; i++) {
+      k = loadFile(c, files[i]);
+      if (k >= 0) n += k;
+      else if (k == SAO_ESPACE) n = k;
+    }
+    freeFiles(files, nf);
+  }
+  else n = loadFile(c, path);
+  if (c->n > 0) qsort(c->entry, c->n, sizeof(RespEntry), cmpEntry);
+  return n;
+}
+/******************************************************************************/
+
+
+
+/*******************************************************************************
+**    Find response of a channel at a moment in the cache
+**      OUT: Pointer to Response structure or NULL if there is no response
+**      IN1: Pointer to RespCache structure
+**      IN2: Channel key "NET.STA.LOC.CHA" (see getSacKey(..))
+**      IN3: Epoch time of the moment
+**  If epochs overlap, the response with the latest beginning is taken
+*/
+const Response*
+findResponse (const RespCache *c, const char *key, double epoch)
+{
+  long lo = 0, hi = c->n, mid;   const RespEntry *e, *found = NULL;
+  while (lo < hi) {
+    mid = (lo + hi) / 2;
+    if (strcmp(c->entry[mid].key, key) < 0) lo = mid + 1;
+    else hi = mid;
+  }
+  for (e = c->entry + lo; e < c->entry + c->n && strcmp(e->key, key) == 0; e++)
+    if (e->t1 <= epoch && epoch < e->t2) found = e;
+  return (found != NULL) ? &found->resp : NULL;
+}
+/******************************************************************************/
+
+
+
+/*******************************************************************************
+**    Free responses of the cache
+**      IN:  Pointer to RespCache structure, it is zero filled after the call
+*/
+void
+freeRespCache (RespCache *c)
+{
+  free(c->entry);
+  memset(c, 0, sizeof(RespCache));
+}
+/******************************************************************************/
@@ -0,0 +1,404 @@
+/******************************************************************************
+**  saoring.c - real-time ring buffers of channels in shared memory
+**              part of SAO system library -> see "lib/saosys.h"
+**
+**    Core functions:
+**  createRing(..)  - create shared memory segment with empty channels
+**  openRing(..)    - open existing segment for reading and writing
+**  closeRing(..)   - unmap segment and optionally remove it
+**  unlinkRing(..)  - remove segment name, mappings stay valid
+**  writeRing(..)   - add samples of a channel (channel is created once)
+**  attachRing(..)  - set cursor to a channel of the segment
+**  readRing(..)    - copy new samples of a cursor
+**  waitRing(..)    - wait for new samples of a cursor
+**
+**  Producer reserves sequences [from, to) by compare-and-swap of 'reserve',
+**  writes samples and waits until 'head' reaches 'from' (producers which
+**  reserved earlier published their samples), then sets 'head' to 'to'.
+**  With one producer per channel it never waits. Consumer copies samples
+**  below 'head' and checks 'reserve' after copying: samples which could be
+**  overwritten by producers meanwhile are dropped as lost, so consumers do
+**  not need any lock and can not slow down producers.
+*******************************************************************************/
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <fcntl.h>
+#include <sched.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#if defined(__linux__)
+#define SAO_FUTEX 1
+#include <limits.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+#endif
+
+#include "../../lib/saocore.h"
+#include "../../lib/saosys.h"
+
+
+
+#define RING_SPIN 64            // Spins before yielding while waiting
+#define RING_POLL 100000        // Polling interval without futex, ns
+
+
+
+/*******************************************************************************
+**    Name of shared memory object and layout of the segment
+*/
+static void
+shmName (char *buf, size_t size, const char *name)
+{
+  snprintf(buf, size, "/%s", (name[0] == '/') ? name + 1 : name);
+}
+
+static size_t
+tableSize (int nchan)
+{
+  size_t size = sizeof(RingHdr) + nchan * sizeof(RingChan);
+  return (size + 63) & ~(size_t)63;       // Samples start on a cache line
+}
+/******************************************************************************/
+
+
+
+/*******************************************************************************
+**    Create shared memory segment with empty channels
+**      OUT: SAO_OK, SAO_EFORMAT - incorrect sizes, SAO_EIO - can not create
+**      IN1: Pointer to SaoRing structure
+**      IN2: Name of the segment
+**      IN3: Maximum number of channels
+**      IN4: Samples of each channel ring, power of two
+**  Old segment of the same name is removed, processes which mapped it keep
+**  the old one until they open the name again
+*/
+int
+createRing (SaoRing *r, const char *name, int nchan, long cap)
+{
+  char path[256];   int fd, i;   size_t size;   RingHdr *h;
+
+  memset(r, 0, sizeof(SaoRing));
+  if (nchan < 1 || cap < 16 || (cap & (cap - 1)) != 0) return SAO_EFORMAT;
+  size = tableSize(nchan) + (size_t) nchan * cap * sizeof(float);
+  shmName(path, sizeof(path), name);
+  shm_unlink(path);
+  if ((fd = shm_open(path, O_CREAT | O_EXCL | O_RDWR, 0644)) < 0)
+    return SAO_EIO;
+  if (ftruncate(fd, size) != 0) {
+    close(fd);   shm_unlink(path);
+    return SAO_EIO;
+  }
+  h = (RingHdr*) mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close(fd);
+  if (h == MAP_FAILED) { shm_unlink(path);  return SAO_EIO; }
+
+  h->nchan = nchan;   h->cap = cap;
+  atomic_flag_clear(&h->lock);
+  for (i = 0; i < nchan; i++) {
+    h->chan[i].offset = tableSize(nchan) + (size_t) i * cap * sizeof(float);
+    atomic_init(&h->chan[i].state, 0);
+  }
+  atomic_thread_fence(memory_order_release);
+  h->magic = RING_MAGIC;
+  r->hdr = h;   r->size = size;
+  return SAO_OK;
+}
+/******************************************************************************/
+
+
+
+/*******************************************************************************
+**    Open existing segment for reading and writing
+**      OUT: SAO_OK, SAO_EIO - no segment, SAO_EFORMAT - not a ring segment
+**      IN1: Pointer to SaoRing structure
+**      IN2: Name of the segment
+*/
+int
+openRing (SaoRing *r, const char *name)
+{
+  char path[256];   int fd;   struct stat st;   RingHdr *h;
+
+  memset(r, 0, sizeof(SaoRing));
+  shmName(path, sizeof(path), name);
+  if ((fd = shm_open(path, O_RDWR, 0)) < 0) return SAO_EIO;
+  if (fstat(fd, &st) != 0 || st.st_size < (off_t) sizeof(RingHdr)) {
+    close(fd);
+    return SAO_EFORMAT;
+  }
+  h = (RingHdr*) mmap(NULL, st.st_size, PROT_READ | PROT_WRITE, MAP_SHARED,
+                      fd, 0);
+  close(fd);
+  if (h == MAP_FAILED) return SAO_EIO;
+  if (h->magic != RING_MAGIC || h->nchan < 1 || (size_t) st.st_size !=
+      tableSize(h->nchan) + (size_t) h->nchan * h->cap * sizeof(float)) {
+    munmap(h, st.st_size);
+    return SAO_EFORMAT;
+  }
+  atomic_thread_fence(memory_order_acquire);
+  r->hdr = h;   r->size = st.st_size;
+  return SAO_OK;
+}
+/******************************************************************************/
+
+
+
+/*******************************************************************************
+**    Unmap segment and optionally remove it
+**      IN1: Pointer to SaoRing structure, it is zero filled after the call
+**      IN2: Name of the segment to remove or NULL to keep it
+*/
+void
+closeRing (SaoRing *r, const char *name)
+{
+  if (r->hdr != NULL) munmap(r->hdr, r->size);
+  if (name != NULL) unlinkRing(name);
+  memset(r, 0, sizeof(SaoRing));
+}
+/******************************************************************************/
+
+
+
+/*******************************************************************************
+**    Remove name of the segment
+**      IN:  Name of the segment
+**  Mappings of the segment stay valid until they are unmapped or their
+**  processes exit, so threads still writing to the ring are safe.
+*/
+void
+unlinkRing (const char *name)
+{
+  char path[256];
+  shmName(path, sizeof(path), name);
+  shm_unlink(path);
+}
+/******************************************************************************/
+
+
+
+/*******************************************************************************
+**    Find ready channel by key or create it under the lock of the table
+*/
+static RingChan*
+findChan (RingHdr *h, const char *key)
+{
+  int i;
+  for (i = 0; i < h->nchan; i++)
+    if (atomic_load_explicit(&h->chan[i].state, memory_order_acquire) == 1 &&
+        strncmp(h->chan[i].key, key, SAO_KEY_LEN) == 0)
+      return &h->chan[i];
+  return NULL;
+}
+
+static RingChan*
+newChan (RingHdr *h, const char *key, double epoch, double delta)
+{
+  RingChan *c;   int i;
+  while (atomic_flag_test_and_set_explicit(&h->lock, memory_order_acquire))
+    sched_yield();
+  if ((c = findChan(h, key)) == NULL)
+    for (i = 0; i < h->nchan; i++) {
+      if (atomic_load_explicit(&h->chan[i].state, memory_order_relaxed) != 0)
+        continue;
+      c = &h->chan[i];
+      snprintf(c->key, SAO_KEY_LEN, "%s", key);
+      c->delta = delta;   c->t0 = epoch;
+      atomic_init(&c->reserve, 0);   atomic_init(&c->head, 0);
+      atomic_init(&c->wake, 0);      atomic_init(&c->waiters, 0);
+      atomic_store_explicit(&c->state, 1, memory_order_release);
+      break;
+    }
+  atomic_flag_clear_explicit(&h->lock, memory_order_release);
+  return c;
+}
+/******************************************************************************/
+
+
+
+/*******************************************************************************
+**    Copy samples into the ring from a sequence (NULL source fills NaN)
+*/
+static void
+putSamples (float *ring, uint64_t cap, uint64_t seq, const float *x, long n)
+{
+  long k = cap - (seq & (cap - 1)), i;   float *dst = ring + (seq & (cap - 1));
+  if (k > n) k = n;
+  if (x != NULL) {
+    memcpy(dst, x, k * sizeof(float));
+    memcpy(ring, x + k, (n - k) * sizeof(float));
+  }
+  else {
+    for (i = 0; i < k; i++) dst[i] = NAN;
+    for (i = 0; i < n - k; i++) ring[i] = NAN;
+  }
+}
+
+static void
+getSamples (const float *ring, uint64_t cap, uint64_t seq, float *x, long n)
+{
+  long k = cap - (seq & (cap - 1));
+  if (k > n) k = n;
+  memcpy(x, ring + (seq & (cap - 1)), k * sizeof(float));
+  memcpy(x + k, ring, (n - k) * sizeof(float));
+}
+/******************************************************************************/
+
+
+
+/*******************************************************************************
+**    Add samples of a channel
+**      OUT: SAO_OK, SAO_EFORMAT - sampling differs from the channel,
+**           SAO_ESPACE - no free channel in the table
+**      IN1: Pointer to SaoRing structure
+**      IN2: Channel key "NET.STA.LOC.CHA"
+**      IN3: Epoch time of the first sample
+**      IN4: Sampling interval, s
+**      IN5: Samples
+**      IN6: Number of samples
+**  Channel is created by its first samples. Position of samples is found
+**  by epoch time: samples before already written ones are dropped, a gap
+**  after them is filled with NaN.
+*/
+int
+writeRing (SaoRing *r, const char *key, double epoch, double delta,
+           const float *x, long n)
+{
+  RingHdr *h = r->hdr;   RingChan *c;   float *ring;   int spin = 0;
+  uint64_t cap = h->cap, from, to, first, s0;   int64_t s;
+
+  if (n <= 0) return SAO_OK;
+  if (!(delta > 0.0)) return SAO_EFORMAT;
+  if ((c = findChan(h, key)) == NULL &&
+      (c = newChan(h, key, epoch, delta)) == NULL)
+    return SAO_ESPACE;
+  if (fabs(c->delta - delta) > 1e-6 * delta) return SAO_EFORMAT;
+  s = llround((epoch - c->t0) / c->delta);
+  if (s < 0) {
+    if (s + n <= 0) return SAO_OK;
+    x -= s;   n += s;   s = 0;
+  }
+
+  to = s + n;
+  from = atomic_load_explicit(&c->reserve, memory_order_relaxed);
+  do {
+    if (to <= from) return SAO_OK;                  // Old samples
+  } while (!atomic_compare_exchange_weak(&c->reserve, &from, to));
+
+  ring = (float*)((char*) h + c->offset);
+  first = (to > cap && to - cap > from) ? to - cap : from;
+  s0 = ((uint64_t) s > first) ? (uint64_t) s : first;
+  if (s0 > first) putSamples(ring, cap, first, NULL, s0 - first);
+  putSamples(ring, cap, s0, x + (s0 - s), to - s0);
+
+  while (atomic_load_explicit(&c->head, memory_order_acquire) != from)
+    if (++spin > RING_SPIN) sched_yield();
+  atomic_store_explicit(&c->head, to, memory_order_release);
+  atomic_fetch_add(&c->wake, 1);
+#if defined(SAO_FUTEX)
+  if (atomic_load(&c->waiters) > 0)
+    syscall(SYS_futex, &c->wake, FUTEX_WAKE, INT_MAX, NULL, NULL, 0);
+#endif
+  return SAO_OK;
+}
+/******************************************************************************/
+
+
+
+/*******************************************************************************
+**    Set cursor to a channel of the segment
+**      OUT: SAO_OK or SAO_EFORMAT if there is no such channel (yet)
+**      IN1: Pointer to SaoRing structure
+**      IN2: Channel key "NET.STA.LOC.CHA"
+**      IN3: 1 - read only new samples, 0 - start from the oldest one kept
+**      OUT: Pointer to RingCursor structure
+*/
+int
+attachRing (const SaoRing *r, const char *key, int last, RingCursor *c)
+{
+  uint64_t head;
+  memset(c, 0, sizeof(RingCursor));
+  if ((c->chan = findChan(r->hdr, key)) == NULL) return SAO_EFORMAT;
+  c->ring = r;
+  head = atomic_load_explicit(&c->chan->head, memory_order_acquire);
+  if (last == 1) c->seq = head;
+  else c->seq = (head > (uint64_t) r->hdr->cap) ? head - r->hdr->cap : 0;
+  return SAO_OK;
+}
+/******************************************************************************/
+
+
+
+/*******************************************************************************
+**    Copy new samples of a cursor
+**      OUT: Number of copied samples (0 if there are no new ones)
+**      IN1: Pointer to RingCursor structure
+**      OUT: Buffer for samples
+**      IN3: Size of the buffer
+**      OUT: Epoch time of the first copied sample
+*/
+long
+readRing (RingCursor *c, float *x, long n, double *epoch)
+{
+  RingChan *ch = c->chan;   uint64_t cap = c->ring->hdr->cap, head, res, bad;
+  const float *ring = (const float*)((char*) c->ring->hdr + ch->offset);
+  long m;
+
+  head = atomic_load_explicit(&ch->head, memory_order_acquire);
+  if (c->seq + cap < head) {                     // Overwritten before reading
+    c->lost += head - cap - c->seq;
+    c->seq = head - cap;
+  }
+  m = (head - c->seq < (uint64_t) n) ? (long)(head - c->seq) : n;
+  if (m <= 0) return 0;
+  getSamples(ring, cap, c->seq, x, m);
+
+  atomic_thread_fence(memory_order_acquire);
+  res = atomic_load_explicit(&ch->reserve, memory_order_relaxed);
+  if (res > c->seq + cap) {                       // Overwritten while copying
+    bad = res - cap - c->seq;
+    if (bad > (uint64_t) m) bad = m;
+    memmove(x, x + bad, (m - bad) * sizeof(float));
+    c->lost += bad;   c->seq += bad;   m -= bad;
+  }
+  *epoch = ch->t0 + c->seq * ch->delta;
+  c->seq += m;
+  return m;
+}
+/******************************************************************************/
+
+
+
+/*******************************************************************************
+**    Wait for new samples of a cursor
+**      OUT: 1 - there are new samples, 0 - timeout
+**      IN1: Pointer to RingCursor structure
+**      IN2: Timeout in seconds
+*/
+int
+waitRing (RingCursor *c, double timeout)
+{
+  RingChan *ch = c->chan;   struct timespec ts;
+#if defined(SAO_FUTEX)
+  unsigned w = atomic_load(&ch->wake);
+  if (atomic_load(&ch->head) > c->seq) return 1;
+  atomic_fetch_add(&ch->waiters, 1);
+  if (atomic_load(&ch->head) == c->seq) {
+    ts.tv_sec = (time_t) timeout;
+    ts.tv_nsec = (long)((timeout - ts.tv_sec) * 1e9);
+    syscall(SYS_futex, &ch->wake, FUTEX_WAIT, w, &ts, NULL, 0);
+  }
+  atomic_fetch_sub(&ch->waiters, 1);
+#else
+  double t;
+  ts.tv_sec = 0;   ts.tv_nsec = RING_POLL;
+  for (t = 0.0; t < timeout && atomic_load(&ch->head) == c->seq;
+       t += 1e-9 * RING_POLL)
+    nanosleep(&ts, NULL);
+#endif
+  return (atomic_load(&ch->head) > c->seq) ? 1 : 0;
+}
+/******************************************************************************/
@@ -0,0 +1,293 @@
+/******************************************************************************
+**  saothr.c - functions for parallel processing on POSIX threads
+**              part of SAO system library -> see "lib/saosys.h"
+**
+**    Core functions:
+**  getNumThreads(..) - get number of online processors
+**  runParallel(..)   - run tasks on a number of threads and wait for them
+**  runStealing(..)   - run tasks with work stealing of index ranges
+**  arenaAlloc(..)    - allocate memory in an arena
+**  resetArena(..)    - free all allocations of an arena at once
+**  freeArena(..)     - free memory of an arena
+**
+*******************************************************************************/
+#include <stdlib.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <stdatomic.h>
+
+#include "../../lib/saocore.h"
+#include "../../lib/saosys.h"
+#include "../../lib/saoprof.h"
+
+
+
+#define ARENA_MIN   (1 << 20)   // Size of the first block of arena
+#define ARENA_ALIGN 64          // Alignment of allocations (cache line)
+
+/*  Shared state of one runParallel(..) call  */
+typedef struct {
+  SaoTask       task;
+  void         *ctx;
+  long          ntasks;
+  atomic_long   next;
+}  SaoJob;
+
+/*  Range of task indexes of one thread, [lo, hi) is changed under lock  */
+typedef struct {
+  pthread_mutex_t lock;
+  atomic_long   lo,  hi;
+  char          pad[64];        // Ranges of threads on separate cache lines
+}  StealRange;
+
+/*  Shared state of one runStealing(..) call and argument of its thread  */
+typedef struct {
+  SaoWorkTask   task;
+  void         *ctx;
+  int           nthreads;
+  StealRange   *range;
+}  StealJob;
+
+typedef struct {
+  StealJob     *job;
+  int           id;
+}  StealArg;
+
+
+
+/*******************************************************************************
+**    Get number of online processors
+**      OUT: Number of processors, at least 1
+*/
+int
+getNumThreads (void)
+{
+  long n = sysconf(_SC_NPROCESSORS_ONLN);
+  return (n > 0) ? (int)n : 1;
+}
+/******************************************************************************/
+
+
+
+/*******************************************************************************
+**    Worker loop - take next task index until all tasks are taken
+*/
+static void*
+runWorker (void *arg)
+{
+  SaoJob *job = (SaoJob*) arg;   long i;
+  while ((i = atomic_fetch_add(&job->next, 1)) < job->ntasks)
+    job->task(job->ctx, i);
+  return NULL;
+}
+/******************************************************************************/
+
+
+
+/*******************************************************************************
+**    Run tasks on a number of threads and wait for them
+**      OUT: 0 - success, -1 - some threads were not created
+**      IN1: Number of threads (0 or less means all processors)
+**      IN2: Number of tasks
+**      IN3: Task function called as task(ctx, i) for i in [0, ntasks)
+**      IN4: Context pointer passed to each task
+**  Calling thread works as well, so single thread means no thread creation
+**  If thread creation fails the rest of tasks is done by fewer threads
+*/
+int
+runParallel (int nthreads, long ntasks, SaoTask task, void *ctx)
+{
+  SaoJob job;   pthread_t *thr;   int i, nrun = 0, ret = 0;
+  job.task = task;  job.ctx = ctx;  job.ntasks = ntasks;
+  atomic_init(&job.next, 0);
+
+  if (nthreads <= 0) nthreads = getNumThreads();
+  if (nthreads > ntasks) nthreads = (ntasks > 0) ? (int)ntasks : 1;
+  thr = (pthread_t*) malloc(nthreads * sizeof(pthread_t));
+  if (thr == NULL) nthreads = 1;
+  for (i = 1; i < nthreads; i++) {
+    if (pthread_create(&thr[nrun], NULL, runWorker, &job) == 0) nrun++;
+    else ret = -1;
+  }
+  runWorker(&job);
+  for (i = 0; i < nrun; i++) pthread_join(thr[i], NULL);
+  free(thr);
+  return ret;
+}
+/******************************************************************************/
+
+
+
+/*******************************************************************************
+**    Take next task of a thread, steal upper half of the largest range of
+**  other threads if its own range is empty
+**      OUT: 1 - task is taken, 0 - all tasks are taken
+*/
+static int
+takeTask (StealJob *job, int id, long *i)
+{
+  StealRange *r = &job->range[id], *v;   long lo, hi, mid = 0, n, best;
+  int k, vic;
+
+  pthread_mutex_lock(&r->lock);
+  lo = atomic_load_explicit(&r->lo, memory_order_relaxed);
+  if (lo < atomic_load_explicit(&r->hi, memory_order_relaxed)) {
+    atomic_store_explicit(&r->lo, lo + 1, memory_order_relaxed);
+    pthread_mutex_unlock(&r->lock);
+    *i = lo;
+    return 1;
+  }
+  pthread_mutex_unlock(&r->lock);
+
+  for (;;) {
+    for (k = 0, vic = -1, best = 0; k < job->nthreads; k++) {
+      v = &job->range[k];
+      n = atomic_load_explicit(&v->hi, memory_order_relaxed) -
+          atomic_load_explicit(&v->lo, memory_order_relaxed);
+      if (n > best) { best = n;  vic = k; }
+    }
+    if (vic < 0) return 0;
+    v = &job->range[vic];
+    pthread_mutex_lock(&v->lock);
+    lo = atomic_load_explicit(&v->lo, memory_order_relaxed);
+    hi = atomic_load_explicit(&v->hi, memory_order_relaxed);
+    if (hi > lo) {
+      mid = lo + (hi - lo) / 2;
+      atomic_store_explicit(&v->hi, mid, memory_order_relaxed);
+    }
+    pthread_mutex_unlock(&v->lock);
+    if (hi > lo) {
+      pthread_mutex_lock(&r->lock);
+      atomic_store_explicit(&r->lo, mid + 1, memory_order_relaxed);
+      atomic_store_explicit(&r->hi, hi, memory_order_relaxed);
+      pthread_mutex_unlock(&r->lock);
+      *i = mid;
+      return 1;
+    }
+  }
+}
+
+static void*
+stealWorker (void *arg)
+{
+  StealArg *sa = (StealArg*) arg;   long i;
+  while (takeTask(sa->job, sa->id, &i) == 1)
+    sa->job->task(sa->job->ctx, i, sa->id);
+  return NULL;
+}
+/******************************************************************************/
+
+
+
+/*******************************************************************************
+**    Run tasks with work stealing of index ranges and wait for them
+**      OUT: 0 - success, -1 - some threads were not created
+**      IN1: Number of threads (0 or less means all processors)
+**      IN2: Number of tasks
+**      IN3: Task function called as task(ctx, i, thread) for i in [0, ntasks)
+**           and thread in [0, nthreads)
+**      IN4: Context pointer passed to each task
+**  Threads start with equal ranges, so neighbour tasks (e.g. files of one
+**  directory) are usually done by one thread. Calling thread is thread 0.
+*/
+int
+runStealing (int nthreads, long ntasks, SaoWorkTask task, void *ctx)
+{
+  StealJob job;   StealArg *arg;   pthread_t *thr;   int i, ret = 0;
+
+  if (nthreads <= 0) nthreads = getNumThreads();
+  if (nthreads > ntasks) nthreads = (ntasks > 0) ? (int)ntasks : 1;
+  job.task = task;   job.ctx = ctx;   job.nthreads = nthreads;
+  job.range = (StealRange*) malloc(nthreads * sizeof(StealRange));
+  arg = (StealArg*) malloc(nthreads * sizeof(StealArg));
+  thr = (pthread_t*) malloc(nthreads * sizeof(pthread_t));
+  if (job.range == NULL || arg == NULL || thr == NULL) {
+    free(job.range);   free(arg);   free(thr);
+    for (i = 0; i < ntasks; i++) task(ctx, i, 0);
+    return 0;
+  }
+  for (i = 0; i < nthreads; i++) {
+    pthread_mutex_init(&job.range[i].lock, NULL);
+    atomic_init(&job.range[i].lo, ntasks * i / nthreads);
+    atomic_init(&job.range[i].hi, ntasks * (i + 1) / nthreads);
+    arg[i].job = &job;   arg[i].id = i;
+  }
+  for (i = 1; i < nthreads; i++)
+    if (pthread_create(&thr[i], NULL, stealWorker, &arg[i]) != 0) {
+      arg[i].job = NULL;            // Its range is stolen by others
+      ret = -1;
+    }
+  stealWorker(&arg[0]);
+  for (i = 1; i < nthreads; i++)
+    if (arg[i].job != NULL) pthread_join(thr[i], NULL);
+  for (i = 0; i < nthreads; i++) pthread_mutex_destroy(&job.range[i].lock);
+  free(job.range);   free(arg);   free(thr);
+  return ret;
+}
+/******************************************************************************/
+
+
+
+/*******************************************************************************
+**    Allocate memory in an arena
+**      OUT: Pointer aligned to ARENA_ALIGN bytes or NULL if there is no memory
+**      IN1: Pointer to Arena structure (zero filled before first use)
+**      IN2: Size in bytes
+**  New block is at least twice larger than the current one
+*/
+void*
+arenaAlloc (Arena *a, size_t size)
+{
+  ArenaBlock *b = a->head;   size_t bs, hdr;   void *ptr;
+
+  hdr = (sizeof(ArenaBlock) + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1);
+  size = (size + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1);
+  if (b == NULL || b->used + size > b->size) {
+    bs = (b == NULL) ? ARENA_MIN : 2 * b->size;
+    if (bs < size) bs = size;
+    if (posix_memalign(&ptr, ARENA_ALIGN, hdr + bs) != 0) return NULL;
+    SAO_COUNT(SAO_ST_ALLOC, hdr + bs);
+    b = (ArenaBlock*) ptr;
+    b->next = a->head;   b->size = bs;   b->used = 0;
+    a->head = b;   a->total += bs;
+  }
+  ptr = (char*) b + hdr + b->used;
+  b->used += size;
+  return ptr;
+}
+/******************************************************************************/
+
+
+
+/*******************************************************************************
+**    Free all allocations of an arena at once
+**      IN:  Pointer to Arena structure
+**  Several blocks are replaced by one block of their total size, so the
+**  arena stops growing after the largest task
+*/
+void
+resetArena (Arena *a)
+{
+  size_t total = a->total;
+  if (a->head == NULL) return;
+  if (a->head->next == NULL) { a->head->used = 0;  return; }
+  freeArena(a);
+  if (arenaAlloc(a, total) != NULL) a->head->used = 0;
+}
+/******************************************************************************/
+
+
+
+/*******************************************************************************
+**    Free memory of an arena
+**      IN:  Pointer to Arena structure, it is zero filled after the call
+*/
+void
+freeArena (Arena *a)
+{
+  ArenaBlock *b, *next;
+  for (b = a->head; b != NULL; b = next) { next = b->next;  free(b); }
+  a->head = NULL;   a->total = 0;
+}
+/******************************************************************************/
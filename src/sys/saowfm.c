@@ -4,86 +4,275 @@
 **
 **    Core functions:
 **  readSacH(..)    - read header from SAC file into SacH structure
+**  scanSacH(..)    - read header from SAC file with status code
 **  getSacBegin(..) - get begining Moment from SacH structure
+**  sprintSacInfo(..) - write info from SacH into a caller's buffer
 **  writeSacInfo(..)  - get info from SacH as a string of specified format
+**  mapSac(..)      - map SAC file into memory for reading
+**  unmapSac(..)    - unmap SAC file
+**  writeSac(..)    - write header and samples into SAC file
+**  getSacKey(..)   - get channel key "NET.STA.LOC.CHA" from SacH structure
 **
 *******************************************************************************/
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
 #include <assert.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 #include "../../lib/saocore.h"
 #include "../../lib/saosys.h"
+#include "../../lib/saoprof.h"
 
 
 
 /*******************************************************************************
 **    Read header from SAC file into SacH structure
-**      OUT: New SacH structure
-**      IN:  String with path to SAC file
+**      OUT: New SacH structure, UNDEFINED_SACH if it can not be read
+**      IN:  SAC file stream
 */
 SacH
 readSacH(FILE *fsac)
 {
-  SacH hdr = UNDEFINED_SACH;
-  if (fsac != NULL)
-    fread(&hdr, sizeof(SacH), 1, fsac);
+  SacH hdr;
+  scanSacH(fsac, &hdr);
   return hdr;
 }
 /******************************************************************************/
 
 
 
+/*******************************************************************************
+**    Read header from SAC file with status code
+**      OUT: SAO_OK, SAO_EIO if header can not be read or SAO_ENOSAC if
+**           header version is not 6 (it is not a SAC file)
+**      IN1: SAC file stream
+**      OUT: Pointer to SacH structure, UNDEFINED_SACH if it can not be read
+*/
+int
+scanSacH(FILE *fsac, SacH *hdr)
+{
+  SAO_PROBE_START(t0);
+  if (fsac == NULL || fread(hdr, sizeof(SacH), 1, fsac) != 1) {
+    *hdr = UNDEFINED_SACH;
+    return SAO_EIO;
+  }
+  SAO_PROBE_STOP(SAO_ST_READSACH, t0, sizeof(SacH));
+  return (hdr->internal4 == 6) ? SAO_OK : SAO_ENOSAC;
+}
+/******************************************************************************/
+
+
+
 /*******************************************************************************
 **    Get begining Moment from SacH structure
-**      OUT: New Moment structure
-**      IN:  Pointer to SacH structure
-**  SAC files have
+**      OUT: New Moment structure, NOT_MOMENT for incorrect header
+**      IN:  SacH structure
+**  Reference moment of SAC file is kept in integer fields nz*, the first
+**  sample is 'b' seconds after it. Moment is built from fields directly.
 */
 Moment
 getSacBegin(SacH hdr)
 {
-  char* buf;  int len = 19;
-  buf = (char*) malloc((len + 1) * sizeof(char));
-  sprintf(buf, "%04d-%03d_%02d%02d%02d.%03d",
-          hdr.nzyear, hdr.nzjday, hdr.nzhour,
-          hdr.nzmin, hdr.nzsec, hdr.nzmsec);
-  Moment t = readMoment(buf);
-  t = addSecs(t, hdr.b);
-  return t;
+  Moment t = NOT_MOMENT;
+  t.year = hdr.nzyear;    t.yday = hdr.nzjday;
+  t.hour = hdr.nzhour;    t.min  = hdr.nzmin;
+  t.sec  = hdr.nzsec;     t.msec = hdr.nzmsec;
+  if (getMonthDay(&t.month, &t.day, t.year, t.yday) != SAO_OK ||
+      isMoment(t) == 0)
+    return NOT_MOMENT;
+  return addSecs(t, hdr.b);
 }
 /******************************************************************************/
 
 
 
 /*******************************************************************************
-**    Write info about SAC file in specific mode
-**      IN1: Path to file
-**      IN2: Mode of writing info
+**    Copy character field of SAC header without trailing blanks
+**      OUT: Pointer to the destination string
+**      IN1: Destination buffer of n + 1 bytes at least
+**      IN2: Character field (not terminated by zero)
+**      IN3: Size of the field
+*/
+static char*
+copyKField (char *dst, const char *src, int n)
+{
+  int len = 0;
+  while (len < n && src[len] != '\0') { dst[len] = src[len];  len++; }
+  while (len > 0 && dst[len-1] == ' ') len--;
+  dst[len] = '\0';
+  return dst;
+}
+/******************************************************************************/
+
+
+
+/*******************************************************************************
+**    Write info about SAC file in specific mode into a caller's buffer
+**      OUT: Length of the info or negative status code:
+**           SAO_EFORMAT - begining of data is incorrect in the header
+**           SAO_ESPACE  - buffer is too small, info is truncated
+**      IN1: Buffer for the info (SAO_SACINFO_LEN is enough)
+**      IN2: Size of the buffer
+**      IN3: SacH structure
+**      IN4: Mode of writing info
 **            0         - default, few lines of general info
 **            115 ('s') - short, one line with main info
-**            102 ('f') - full, long table with all header info
 */
-char*
-writeSacInfo (SacH hdr, int mode)
+int
+sprintSacInfo (char *buf, size_t size, SacH hdr, int mode)
 {
-  char *buf;
-  int len = 255;
+  char sb[SAO_MOMENT_LEN], se[SAO_MOMENT_LEN];
+  char net[9], sta[9], cmp[9];   int len;
+  Moment b = getSacBegin(hdr);
+  if (isMoment(b) == 0) return SAO_EFORMAT;
+  SAO_OUTER_START(t0);
+  copyKField(net, hdr.knetwk, 8);
+  copyKField(sta, hdr.kstnm, 8);
+  copyKField(cmp, hdr.kcmpnm, 8);
 
-  buf = (char*) malloc((len + 1) * sizeof(char));
   if (mode == 's'){
-    sprintf(buf, "%s,%d,%f,%s,%s,%s", writeMoment(getSacBegin(hdr), "ISO"),
-            hdr.npts, hdr.delta, hdr.knetwk, hdr.kstnm, hdr.kcmpnm);
-  }
-  else if (mode == 'f'){
-
+    sprintMoment(sb, sizeof(sb), b, "ISO");
+    len = snprintf(buf, size, "%s,%d,%f,%s,%s,%s",
+                   sb, hdr.npts, hdr.delta, net, sta, cmp);
   }
   else {
-    Moment b = getSacBegin(hdr);
     Moment e = addSecs(b, (hdr.npts * hdr.delta));
-    sprintf(buf, "Station |%s| of |%s| network\nLocated at (%f,%f,%f)\nChannel |%s| sampling frequency: %f\nData for period: %s - %s\n", hdr.kstnm, hdr.knetwk, hdr.stla, hdr.stlo, hdr.stel, hdr.kcmpnm, 1/hdr.delta, writeMoment(b, "SAO"), writeMoment(e, "SAO"));
+    sprintMoment(sb, sizeof(sb), b, "SAO");
+    sprintMoment(se, sizeof(se), e, "SAO");
+    len = snprintf(buf, size, "Station |%s| of |%s| network\nLocated at (%f,%f,%f)\nChannel |%s| sampling frequency: %f\nData for period: %s - %s\n", sta, net, hdr.stla, hdr.stlo, hdr.stel, cmp, 1/hdr.delta, sb, se);
   }
+  SAO_OUTER_STOP(SAO_ST_FORMAT, t0, len);
+  return (len < (int)size) ? len : SAO_ESPACE;
+}
+/******************************************************************************/
+
+
+
+/*******************************************************************************
+**    Write info about SAC file in specific mode
+**      OUT: Pointer to the new string (caller frees it) or NULL
+**      IN1: SacH structure
+**      IN2: Mode of writing info, see sprintSacInfo(..)
+**  Allocating wrapper of sprintSacInfo(..)
+*/
+char*
+writeSacInfo (SacH hdr, int mode)
+{
+  char *buf = (char*) malloc(SAO_SACINFO_LEN * sizeof(char));
+  SAO_COUNT(SAO_ST_ALLOC, SAO_SACINFO_LEN);
+  if (buf != NULL && sprintSacInfo(buf, SAO_SACINFO_LEN, hdr, mode) < 0)
+    buf[0] = '\0';
   return buf;
 }
 /******************************************************************************/
+
+
+
+/*******************************************************************************
+**    Map SAC file into memory for reading
+**      OUT: SAO_OK, SAO_EIO - can not map file, SAO_ENOSAC - not a SAC file
+**      IN1: Path to SAC file
+**      OUT: Pointer to SacMap structure
+**  Mapping is read-only and private, pages are loaded by kernel on demand
+**  Number of samples is limited by the file size for truncated files
+*/
+int
+mapSac (const char *path, SacMap *map)
+{
+  struct stat st;   void *ptr;   int fd;
+  SAO_PROBE_START(t0);
+  memset(map, 0, sizeof(SacMap));
+  if ((fd = open(path, O_RDONLY)) < 0) return SAO_EIO;
+  if (fstat(fd, &st) != 0 || st.st_size < (off_t)sizeof(SacH)) {
+    close(fd);
+    return SAO_ENOSAC;
+  }
+  ptr = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (ptr == MAP_FAILED) return SAO_EIO;
+  map->hdr  = (SacH*) ptr;
+  map->data = (float*) ((char*)ptr + sizeof(SacH));
+  map->size = st.st_size;
+  map->npts = (st.st_size - sizeof(SacH)) / sizeof(float);
+  if (map->hdr->internal4 != 6) { unmapSac(map);  return SAO_ENOSAC; }
+  if (map->hdr->npts >= 0 && map->hdr->npts < map->npts)
+    map->npts = map->hdr->npts;
+  SAO_PROBE_STOP(SAO_ST_MAPSAC, t0, map->size);
+  return SAO_OK;
+}
+/******************************************************************************/
+
+
+
+/*******************************************************************************
+**    Unmap SAC file
+**      IN:  Pointer to SacMap structure from mapSac(..)
+*/
+void
+unmapSac (SacMap *map)
+{
+  if (map->hdr != NULL) munmap(map->hdr, map->size);
+  memset(map, 0, sizeof(SacMap));
+}
+/******************************************************************************/
+
+
+
+/*******************************************************************************
+**    Write header and samples into SAC file
+**      OUT: SAO_OK or SAO_EIO if file can not be written
+**      IN1: Path to SAC file (it is replaced if exists)
+**      IN2: Pointer to SacH structure, 'npts' samples are written
+**      IN3: Samples
+**  File is written under temporary name and renamed at the end, so readers
+**  never see a partially written file
+*/
+int
+writeSac (const char *path, const SacH *hdr, const float *data)
+{
+  size_t len = strlen(path);   char *tmp;   FILE *f;   int ret = SAO_EIO;
+  SAO_PROBE_START(t0);
+  if (hdr->npts < 0 || (tmp = (char*) malloc(len + 5)) == NULL) return SAO_EIO;
+  memcpy(tmp, path, len);   memcpy(tmp + len, ".tmp", 5);
+  if ((f = fopen(tmp, "wb")) != NULL) {
+    if (fwrite(hdr, sizeof(SacH), 1, f) == 1 &&
+        fwrite(data, sizeof(float), hdr->npts, f) == (size_t)hdr->npts &&
+        fclose(f) == 0) {
+      if (rename(tmp, path) == 0) ret = SAO_OK;
+    }
+    else fclose(f);
+    if (ret != SAO_OK) unlink(tmp);
+  }
+  free(tmp);
+  SAO_PROBE_STOP(SAO_ST_OUTPUT, t0, sizeof(SacH) + hdr->npts * sizeof(float));
+  return ret;
+}
+/******************************************************************************/
+
+
+
+/*******************************************************************************
+**    Get channel key "NET.STA.LOC.CHA" from SacH structure
+**      OUT: Length of the key or SAO_ESPACE if buffer is too small
+**      IN1: Buffer for the key (SAO_KEY_LEN is enough)
+**      IN2: Size of the buffer
+**      IN3: Pointer to SacH structure
+**  Undefined location "-12345" and "--" are written as empty string
+*/
+int
+getSacKey (char *buf, size_t size, const SacH *hdr)
+{
+  char net[9], sta[9], loc[9], cha[9];   int len;
+  copyKField(net, hdr->knetwk, 8);
+  copyKField(sta, hdr->kstnm, 8);
+  copyKField(loc, hdr->khole, 8);
+  copyKField(cha, hdr->kcmpnm, 8);
+  if (strcmp(loc, "-12345") == 0 || strcmp(loc, "--") == 0) loc[0] = '\0';
+  len = snprintf(buf, size, "%s.%s.%s.%s", net, sta, loc, cha);
+  return (len < (int)size) ? len : SAO_ESPACE;
+}
+/******************************************************************************/
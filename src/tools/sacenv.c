@@ -0,0 +1,187 @@
+/*******************************************************************************
+**  sacenv.c - SAC file(s) Envelope Tool for fast plotting
+**      Part of Seismicity Analysis Organizer
+**
+**  This program is based on 'saoenv.c' (part of SAO core library) and
+**  'saolod.c' (part of SAO system library)
+**  Program info and usage described in programInfo(..) functions
+**  The <unistd.h> is required for getopt(..) function
+*******************************************************************************/
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <stdatomic.h>
+
+#include "../../lib/saocore.h"
+#include "../../lib/saosys.h"
+
+
+
+/*******************************************************************************
+**    Print program info and usage
+**      IN: 0 - program usage and info, 1 - full list of options
+*/
+void
+programInfo (int full)
+{
+  char *fullinfo =
+  "SAC file(s) Envelope Tool.\n"
+  "Build min/max envelope pyramid of each FILE at power-of-two decimations\n"
+  "and store it next to FILE as 'FILE.lod' sidecar file. Plotting of a long\n"
+  "record then takes only two values per pixel from a proper level.\n\n"
+  "Options:\n"
+  "  no options     build sidecar files for FILE(S) if outdated or missing\n"
+  "  -f             force rebuilding of sidecar files\n"
+  "  -b=BASE        samples per block of the finest level, default 16\n"
+  "  -j=THREADS     number of threads, default all processors\n"
+  "  -q=FROM,TO,W   print envelope of FILE for time range and W pixels\n"
+  "  -h             display this help and exit\n\n"
+  "Query output is 'time,min,max' lines, time is epoch time of the block.\n"
+  "If there are less samples per pixel than BASE, samples are printed.\n"
+  "Files which sidecar files can not be built for are listed to stderr,\n"
+  "exit status is 1 if there is at least one of them.\n\n"
+  "Examples:\n"
+  "  $ sacenv /data/2018/*.sac\n"
+  "  $ sacenv -q 2018-04-12_000000,2018-04-13_000000,1600 station.sac\n\n"
+  "Seismicity Analysis Organizer <https://github.com/ScibRam/SAO>.\n";
+
+  printf("Usage: sacenv [OPTION]... FILE...\n");
+  if (full == 1) printf("%s\n", fullinfo);
+  else printf("Try 'sacenv -h' for full list of options and examples\n");
+  return ;
+}
+/******************************************************************************/
+
+
+
+/*******************************************************************************
+**    Build task - one sidecar file for each index
+*/
+typedef struct {
+  char  **files;
+  int     base, force;
+  atomic_int failed;            // 1 if some sidecar file was not built
+}  BuildCtx;
+
+void
+buildTask (void *ctx, long i)
+{
+  BuildCtx *bc = (BuildCtx*) ctx;   EnvMap emap;
+  if (bc->force == 0 && mapEnvelope(bc->files[i], &emap) == 0) {
+    if (emap.env.base == bc->base) { unmapEnvelope(&emap);  return ; }
+    unmapEnvelope(&emap);
+  }
+  if (writeEnvelope(bc->files[i], bc->base) != 0) {
+    fprintf(stderr, "%s - can not build envelope\n", bc->files[i]);
+    atomic_store(&bc->failed, 1);
+  }
+}
+/******************************************************************************/
+
+
+
+/*******************************************************************************
+**    Print envelope of SAC file for time range and plot width
+**      OUT: 0 - success, -1 - error
+**      IN1: Path to SAC file
+**      IN2: Query string 'FROM,TO,WIDTH'
+**      IN3: Samples per block for building of missing sidecar file
+*/
+int
+queryEnvelope (const char *path, char *query, int base)
+{
+  EnvMap emap;   SacMap sac;   Moment t1, t2;
+  char *s1, *s2, *sw;   int k, width;   long i, first, count;
+  double blk;   float *pair;
+
+  s1 = strtok(query, ",");   s2 = strtok(NULL, ",");   sw = strtok(NULL, ",");
+  if (s1 == NULL || s2 == NULL || sw == NULL) return -1;
+  t1 = readMoment(s1);   t2 = readMoment(s2);   width = atoi(sw);
+  if (isMoment(t1) == 0 || isMoment(t2) == 0 || width <= 0) return -1;
+
+  if (mapEnvelope(path, &emap) != 0)
+    if (writeEnvelope(path, base) != 0 || mapEnvelope(path, &emap) != 0)
+      return -1;
+  k = pickEnvelope(&emap.env, toEpoch(t1), toEpoch(t2), width,
+                   &first, &count);
+  if (k >= 0) {
+    blk = emap.env.delta * ((long)emap.env.base << k);
+    pair = emap.env.lev[k] + 2 * first;
+    for (i = 0; i < count; i++)
+      fprintf(stdout, "%.3f,%g,%g\n", emap.env.b + (first + i) * blk,
+              pair[2*i], pair[2*i+1]);
+  }
+  else if (count > 0 && mapSac(path, &sac) == 0) {
+    for (i = first; i < first + count && i < sac.npts; i++)
+      fprintf(stdout, "%.3f,%g,%g\n", emap.env.b + i * emap.env.delta,
+              sac.data[i], sac.data[i]);
+    unmapSac(&sac);
+  }
+  unmapEnvelope(&emap);
+  return 0;
+}
+/******************************************************************************/
+
+
+
+/*******************************************************************************
+**    Main function - detecting options and defining program mode
+**  Program modes:
+**      build   no options    - build sidecar files for all files in parallel
+**      query   (-q) option   - print envelope for the first file
+*/
+int main (int argc, char *argv[])
+{
+  char *options = "hfb:j:q:";   int opt;
+  int optdone = 0;              int nthreads = 0;
+  char *query = NULL;           BuildCtx bc;
+
+  bc.base = 16;   bc.force = 0;   atomic_init(&bc.failed, 0);
+  while (optdone != 1) {
+    if ((opt = getopt(argc, argv, options)) != -1) {
+      switch (opt) {
+        case 'h':
+          programInfo(1);
+          exit(0);
+        case 'f':
+          bc.force = 1;
+          break;
+        case 'b':
+          bc.base = atoi(optarg);
+          break;
+        case 'j':
+          nthreads = atoi(optarg);
+          break;
+        case 'q':
+          query = optarg;
+          break;
+        default:
+          programInfo(0);
+          exit(1);
+      }
+    }
+    else optdone = 1;
+  }
+  if (bc.base < 4 || (bc.base & (bc.base - 1)) != 0) {
+    fprintf(stderr, "BASE should be a power of two not less than 4\n");
+    exit(1);
+  }
+
+  if (optind < argc) {
+    if (query != NULL) {
+      if (queryEnvelope(argv[optind], query, bc.base) != 0) {
+        fprintf(stderr, "%s - can not query envelope\n", argv[optind]);
+        exit(1);
+      }
+    }
+    else {
+      bc.files = argv + optind;
+      runParallel(nthreads, argc - optind, buildTask, &bc);
+      return atomic_load(&bc.failed);
+    }
+  }
+  else programInfo(0);
+  return 0;
+}
+/******************************************************************************/
@@ -0,0 +1,350 @@
+/*******************************************************************************
+**  sacfk.c - SAC files Array Beamforming and FK Analysis Tool
+**      Part of Seismicity Analysis Organizer
+**
+**  This program is based on 'saoarray.c' (part of SAO core library) and
+**  'saowfm.c' and 'saothr.c' (part of SAO system library)
+**  Program info and usage described in programInfo(..) functions
+**  The <unistd.h> is required for getopt(..) function
+*******************************************************************************/
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <limits.h>
+#include <unistd.h>
+#include <stdatomic.h>
+
+#include "../../lib/saocore.h"
+#include "../../lib/saosys.h"
+#include "../../lib/saoprof.h"
+
+
+
+/*******************************************************************************
+**    Print program info and usage
+**      IN: 0 - program usage and info, 1 - full list of options
+*/
+void
+programInfo (int full)
+{
+  char *fullinfo =
+  "SAC files Array Beamforming and FK Analysis Tool.\n"
+  "Take traces of array stations (one FILE per station, the same sampling)\n"
+  "over their common time range and find slowness of the strongest plane\n"
+  "wave in sliding windows by frequency-wavenumber analysis. Station\n"
+  "coordinates are taken from STLA and STLO of headers.\n\n"
+  "Options:\n"
+  "  -s=SMAX        maximum slowness of the grid, s/km, default 0.5\n"
+  "  -n=NODES       grid nodes along each slowness axis, default 51\n"
+  "  -w=WIN         window length in seconds, default 2\n"
+  "  -t=STEP        window step in seconds, default half of window\n"
+  "  -f=F1,F2       frequency band in Hz, default 1,8\n"
+  "  -m             print power map (NODES lines of NODES values) after\n"
+  "                 each window, rows go from -SMAX to SMAX north\n"
+  "  -b=BAZ,SLOW    write delay-and-sum beam for back azimuth BAZ (degrees)\n"
+  "                 and slowness SLOW (s/km) instead of FK analysis\n"
+  "  -o=FILE        output SAC file of the beam, default 'beam.sac'\n"
+  "  -j=THREADS     number of threads, default all processors\n"
+  "  --stats        print JSON summary of time spent in stages to stderr\n"
+  "  -h             display this help and exit\n\n"
+  "FK output is 'time,relpow,abspow,baz,slow' lines: beginning of window,\n"
+  "relative (0..1) and absolute beam power, back azimuth in degrees and\n"
+  "slowness in s/km of the maximum.\n\n"
+  "Examples:\n"
+  "  $ sacfk -s 0.4 -w 3 -f 2,6 /data/array/*.BHZ.sac\n"
+  "  $ sacfk -b 75.5,0.12 -o beam.sac /data/array/*.BHZ.sac\n\n"
+  "Seismicity Analysis Organizer <https://github.com/ScibRam/SAO>.\n";
+
+  printf("Usage: sacfk [OPTION]... FILE FILE...\n");
+  if (full == 1) printf("%s\n", fullinfo);
+  else printf("Try 'sacfk -h' for full list of options and examples\n");
+  return ;
+}
+/******************************************************************************/
+
+
+
+/*******************************************************************************
+**    Array of stations mapped into memory over the common time range
+*/
+typedef struct {
+  int       nsta;
+  SacMap   *maps;
+  const float **tr;             // Samples of stations from the common start
+  double   *x,  *y;             // Offsets of stations from the center, km
+  long      npts;               // Samples in the common time range
+  double    begin,  delta;      // Epoch time of the common start
+  long      first0;             // Offset of the common start in first file
+}  Array;
+
+/*  Map files and find the common time range
+**    OUT: 0 - success, -1 - error (reported to stderr)  */
+int
+openArray (Array *ar, char **files, int nsta)
+{
+  double *lat, *lon, b0 = 0.0;   SacH *h;   int j;
+  long *shift, first = LONG_MIN, last = LONG_MAX;
+
+  memset(ar, 0, sizeof(Array));
+  ar->maps = (SacMap*) calloc(nsta, sizeof(SacMap));
+  ar->tr   = (const float**) calloc(nsta, sizeof(float*));
+  ar->x    = (double*) calloc(5 * nsta, sizeof(double));
+  if (ar->maps == NULL || ar->tr == NULL || ar->x == NULL) {
+    fprintf(stderr, "Not enough memory\n");
+    return -1;
+  }
+  shift = (long*)(ar->x + 4 * nsta);
+  ar->y = ar->x + nsta;   lat = ar->y + nsta;   lon = lat + nsta;
+  for (j = 0; j < nsta; j++) {
+    if (mapSac(files[j], &ar->maps[j]) != SAO_OK) {
+      fprintf(stderr, "%s - not a SAC file\n", files[j]);
+      return -1;
+    }
+    ar->nsta = j + 1;   h = ar->maps[j].hdr;
+    SAO_COUNT(SAO_ST_FILE, 0);
+    if (h->leven != 1 || !(h->delta > 0.0) || ar->maps[j].npts < 1 ||
+        isMoment(getSacBegin(*h)) == 0) {
+      fprintf(stderr, "%s - not an evenly sampled time series\n", files[j]);
+      return -1;
+    }
+    if (j == 0) ar->delta = h->delta;
+    else if (fabs(h->delta - ar->delta) > 1e-4 * ar->delta) {
+      fprintf(stderr, "%s - sampling differs from '%s'\n", files[j], files[0]);
+      return -1;
+    }
+    if (h->stla == -12345.0 || h->stlo == -12345.0) {
+      fprintf(stderr, "%s - no station coordinates\n", files[j]);
+      return -1;
+    }
+    lat[j] = h->stla;   lon[j] = h->stlo;
+    if (j == 0) b0 = toEpoch(getSacBegin(*h));   // Samples of the first file
+    shift[j] = lround((toEpoch(getSacBegin(*h)) - b0) / ar->delta);
+    if (shift[j] > first) first = shift[j];
+    if (shift[j] + ar->maps[j].npts - 1 < last)
+      last = shift[j] + ar->maps[j].npts - 1;
+  }
+  if (last < first) {
+    fprintf(stderr, "Files have no common time range\n");
+    return -1;
+  }
+  ar->npts = last - first + 1;   ar->begin = b0 + first * ar->delta;
+  for (j = 0; j < nsta; j++)
+    ar->tr[j] = ar->maps[j].data + (first - shift[j]);
+  ar->first0 = first;
+  arrayOffsets(nsta, lat, lon, ar->x, ar->y);
+  return 0;
+}
+
+void
+closeArray (Array *ar)
+{
+  int j;
+  for (j = 0; j < ar->nsta; j++) unmapSac(&ar->maps[j]);
+  free(ar->maps);   free(ar->tr);   free(ar->x);
+}
+/******************************************************************************/
+
+
+
+/*******************************************************************************
+**    FK task - each thread keeps its own FkWork and takes windows one by
+**  one, plan with steering vectors is shared
+*/
+typedef struct {
+  const Array  *ar;
+  FkPlan        plan;
+  long          nwin,  step;    // Number of windows and step in samples
+  atomic_long   next;
+  FkPeak       *peaks;
+  float        *maps;           // Power maps of windows or NULL
+  int           status;
+}  FkCtx;
+
+void
+fkTask (void *ctx, long id)
+{
+  FkCtx *fc = (FkCtx*) ctx;   FkWork w;   long i, ng;
+  ng = (long) fc->plan.nodes * fc->plan.nodes;
+  memset(&w, 0, sizeof(FkWork));
+  while ((i = atomic_fetch_add(&fc->next, 1)) < fc->nwin)
+    if (fkWindow(&fc->plan, &w, fc->ar->tr, i * fc->step,
+                 (fc->maps != NULL) ? fc->maps + i * ng : NULL,
+                 &fc->peaks[i]) != SAO_OK)
+      fc->status = SAO_ESPACE;
+  freeFkWork(&w);
+}
+/******************************************************************************/
+
+
+
+/*******************************************************************************
+**    FK analysis in sliding windows
+**      OUT: 0 - success, -1 - error
+*/
+int
+runFk (const Array *ar, double smax, int nodes, double win, double step,
+       double fmin, double fmax, int printmap, int nthreads)
+{
+  FkCtx fc;   char tbuf[SAO_MOMENT_LEN];   long i, g, ng;   int ret;
+  double t;
+
+  memset(&fc, 0, sizeof(FkCtx));
+  fc.ar = ar;
+  fc.step = lround(step / ar->delta);
+  ret = initFkPlan(&fc.plan, ar->nsta, ar->x, ar->y, smax, nodes,
+                   lround(win / ar->delta), ar->delta, fmin, fmax);
+  if (ret != SAO_OK || fc.step < 1) {
+    fprintf(stderr, (ret == SAO_ESPACE) ? "Not enough memory\n" :
+                    "Incorrect grid, window or frequency band\n");
+    return -1;
+  }
+  if (ar->npts < fc.plan.nwin) {
+    fprintf(stderr, "Common time range is shorter than window\n");
+    freeFkPlan(&fc.plan);
+    return -1;
+  }
+  fc.nwin = (ar->npts - fc.plan.nwin) / fc.step + 1;
+  ng = (long) nodes * nodes;
+  fc.peaks = (FkPeak*) malloc(fc.nwin * sizeof(FkPeak));
+  if (printmap == 1) fc.maps = (float*) malloc(fc.nwin * ng * sizeof(float));
+  if (fc.peaks == NULL || (printmap == 1 && fc.maps == NULL)) {
+    fprintf(stderr, "Not enough memory\n");
+    free(fc.peaks);   free(fc.maps);   freeFkPlan(&fc.plan);
+    return -1;
+  }
+  atomic_init(&fc.next, 0);
+  runParallel(nthreads, nthreads, fkTask, &fc);
+
+  if (fc.status == SAO_OK) {
+    SAO_PROBE_START(t0);
+    for (i = 0; i < fc.nwin; i++) {
+      t = ar->begin + i * fc.step * ar->delta;     // Milliseconds of Moment
+      sprintMoment(tbuf, SAO_MOMENT_LEN, fromEpoch(round(t * 1e3) / 1e3),
+                   "ISO");
+      fprintf(stdout, "%s,%.4f,%.6g,%.2f,%.4f\n", tbuf, fc.peaks[i].relpow,
+              fc.peaks[i].abspow, fc.peaks[i].baz, fc.peaks[i].slow);
+      if (fc.maps != NULL)
+        for (g = 0; g < ng; g++)
+          fprintf(stdout, "%.4f%c", fc.maps[i * ng + g],
+                  (g % nodes == nodes - 1) ? '\n' : ' ');
+    }
+    SAO_PROBE_STOP(SAO_ST_OUTPUT, t0, 0);
+  }
+  else fprintf(stderr, "Not enough memory\n");
+  free(fc.peaks);   free(fc.maps);   freeFkPlan(&fc.plan);
+  return (fc.status == SAO_OK) ? 0 : -1;
+}
+/******************************************************************************/
+
+
+
+/*******************************************************************************
+**    Delay-and-sum beam written as SAC file with header of the first file
+**      OUT: 0 - success, -1 - error
+*/
+int
+writeBeam (const Array *ar, double baz, double slow, const char *path)
+{
+  SacH hdr = *ar->maps[0].hdr;   DataStat ds;   float *beam;   int ret;
+  double sx = -slow * sin(baz * M_PI / 180.0);
+  double sy = -slow * cos(baz * M_PI / 180.0);
+
+  if ((beam = (float*) malloc(ar->npts * sizeof(float))) == NULL) {
+    fprintf(stderr, "Not enough memory\n");
+    return -1;
+  }
+  delayAndSum(ar->tr, ar->nsta, ar->npts, ar->x, ar->y, sx, sy,
+              ar->delta, beam);
+  scanData(beam, ar->npts, &ds);
+  hdr.npts = ar->npts;
+  hdr.b += ar->first0 * hdr.delta;   hdr.e = hdr.b + (ar->npts - 1) * hdr.delta;
+  hdr.depmin = ds.min;   hdr.depmax = ds.max;   hdr.depmen = ds.mean;
+  hdr.baz = baz;   hdr.user0 = slow;
+  memcpy(hdr.kstnm, "BEAM    ", 8);
+  ret = writeSac(path, &hdr, beam);
+  free(beam);
+  if (ret != SAO_OK) fprintf(stderr, "%s - can not write output\n", path);
+  return (ret == SAO_OK) ? 0 : -1;
+}
+/******************************************************************************/
+
+
+
+/*******************************************************************************
+**    Main function - detecting options and defining program mode
+**  Program modes:
+**      fk      no options    - FK analysis in sliding windows
+**      beam    (-b) option   - delay-and-sum beam into SAC file
+*/
+int main (int argc, char *argv[])
+{
+  char *options = "hs:n:w:t:f:mb:o:j:";   int opt;
+  int optdone = 0;              int nthreads = 0;
+  double smax = 0.5, win = 2.0, step = 0.0, fmin = 1.0, fmax = 8.0;
+  double baz = 0.0, slow = -1.0;   int nodes = 51, printmap = 0, ret;
+  char *out = "beam.sac";       Array ar;
+  int stats = saoStatsArg(&argc, argv);
+
+  while (optdone != 1) {
+    if ((opt = getopt(argc, argv, options)) != -1) {
+      switch (opt) {
+        case 'h':
+          programInfo(1);
+          exit(0);
+        case 's':
+          smax = atof(optarg);
+          break;
+        case 'n':
+          nodes = atoi(optarg);
+          break;
+        case 'w':
+          win = atof(optarg);
+          break;
+        case 't':
+          step = atof(optarg);
+          break;
+        case 'f':
+          if (sscanf(optarg, "%lf,%lf", &fmin, &fmax) != 2) {
+            fprintf(stderr, "Incorrect frequency band '%s'\n", optarg);
+            exit(1);
+          }
+          break;
+        case 'm':
+          printmap = 1;
+          break;
+        case 'b':
+          if (sscanf(optarg, "%lf,%lf", &baz, &slow) != 2 || slow < 0.0) {
+            fprintf(stderr, "Incorrect beam direction '%s'\n", optarg);
+            exit(1);
+          }
+          break;
+        case 'o':
+          out = optarg;
+          break;
+        case 'j':
+          nthreads = atoi(optarg);
+          break;
+        default:
+          programInfo(0);
+          exit(1);
+      }
+    }
+    else optdone = 1;
+  }
+  if (argc - optind < 2) { programInfo(0);  exit(0); }
+  if (step <= 0.0) step = win / 2.0;
+  if (nthreads <= 0) nthreads = getNumThreads();
+
+  if (openArray(&ar, argv + optind, argc - optind) != 0) {
+    closeArray(&ar);
+    exit(1);
+  }
+  if (slow >= 0.0) ret = writeBeam(&ar, baz, slow, out);
+  else ret = runFk(&ar, smax, nodes, win, step, fmin, fmax, printmap,
+                   nthreads);
+  closeArray(&ar);
+  if (stats == 1) saoStatsReport(stderr, "sacfk");
+  return (ret == 0) ? 0 : 1;
+}
+/******************************************************************************/
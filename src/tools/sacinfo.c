@@ -10,10 +10,13 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
+#include <math.h>
 #include <unistd.h>
+#include <sys/mman.h>
 
 #include "../../lib/saocore.h"
 #include "../../lib/saosys.h"
+#include "../../lib/saoprof.h"
 
 
 
@@ -29,11 +32,36 @@ programInfo (int full)
   "Options:\n"
   "  no options     show info about FILE(S)\n"
   "  -s             print main info to one line for (each) FILE\n"
-//  "  -c             check data to header conformity\n"
+  "  -c             check data to header conformity\n"
+  "  -j=THREADS     number of threads for checking (default all processors)\n"
+  "                 or reading headers without io_uring (default 4 per one)\n"
+  "  -R=DIR         take all files from DIR and its subdirectories (FILE\n"
+  "                 arguments are not used), files are listed in sorted order\n"
+  "  -g=GLOB        with -R take only files with names matching GLOB\n"
+  "  -x=REGEX       with -R take only files with path relative to DIR\n"
+  "                 matching extended regular expression REGEX\n"
+  "  --stats        print JSON summary of time spent in stages to stderr\n"
 //  "  -f             show full info with description\n\n"
+  "\n"
+  "Check (-c) prints one line of comma separated values for each FILE:\n"
+  "  file,status,size,expected size,npts,nan,inf,zero,longest run,\n"
+  "  run value,at min,at max,min,max,mean,problems\n"
+  "Status is OK or FAIL, problems are listed with ';' separator:\n"
+  "  SIZE    file size does not match npts and leven\n"
+  "  NAN     there are not-a-number samples\n"
+  "  INF     there are infinite samples\n"
+  "  RUN     constant (or zero) run is longer than 100 samples\n"
+  "  CLIP    more than 5 samples hit minimum or maximum value and at least\n"
+  "          3 of them follow each other (flat top of clipped signal)\n"
+  "  DEPMIN, DEPMAX, DEPMEN - header value does not match data\n"
+  "  NOSAC   file is not readable or not a SAC file\n\n"
+  "Examples:\n"
+  "  $ sacinfo -s -R /data/sds -g '*.BH?.D.*'\n"
+  "  $ sacinfo -c -R /data/sds -x '^2019/IU/(ANMO|COLA)/'\n\n"
   "Seismicity Analysis Organizer <https://github.com/ScibRam/SAO>.\n";
 
   printf("Usage: sacinfo [OPTION] FILE...\n");
+  printf("  or:  sacinfo [OPTION] -R DIR\n");
   if (full == 1) printf("%s\n", fullinfo);
   else printf("Try 'sacinfo -h' for full list of options and examples\n");
   return ;
@@ -42,17 +70,184 @@ programInfo (int full)
 
 
 
+/*******************************************************************************
+**    Data to header conformity check of one file
+**  Check limits:
+**    RUN_LIMIT   - samples in the longest run of equal values to fail
+**    CLIP_LIMIT  - samples at minimum or maximum to consider it clipped
+**    CLIP_RUN    - consecutive samples at minimum or maximum (plateau), so
+**                  quantized traces hitting their range often are not clipped
+**    DEP_TOL     - relative tolerance for depmin, depmax and depmen
+*/
+#define RUN_LIMIT   100
+#define CLIP_LIMIT  5
+#define CLIP_RUN    3
+#define DEP_TOL     1e-4
+
+#define CHK_NOSAC   0x001
+#define CHK_SIZE    0x002
+#define CHK_NAN     0x004
+#define CHK_INF     0x008
+#define CHK_RUN     0x010
+#define CHK_CLIP    0x020
+#define CHK_DEPMIN  0x040
+#define CHK_DEPMAX  0x080
+#define CHK_DEPMEN  0x100
+
+static const char*
+CHK_NAMES[] = { "NOSAC", "SIZE", "NAN", "INF", "RUN", "CLIP",
+                "DEPMIN", "DEPMAX", "DEPMEN" };
+
+typedef struct {
+  long      size, expsize;      // Actual and expected size of file
+  long      npts;               // Number of samples in header
+  DataStat  ds;                 // Statistics of samples
+  int       flags;              // Detected problems
+}  SacCheck;
+
+/*  Compare header value with calculated one, undefined value is skipped  */
+int
+isDepOk (float hdr, double val, double scale)
+{
+  if (hdr == -12345.0f) return 1;
+  return fabs(hdr - val) <= DEP_TOL * scale;
+}
+
+/*  Map file, check size and scan samples in one pass  */
+void
+checkSac (const char *path, SacCheck *chk)
+{
+  SacMap map;   double scale;   int ncomp = 1;
+  SAO_COUNT(SAO_ST_FILE, 0);
+  memset(chk, 0, sizeof(SacCheck));
+  if (mapSac(path, &map) != 0) { chk->flags = CHK_NOSAC;  return ; }
+  madvise(map.hdr, map.size, MADV_SEQUENTIAL);
+
+  if (map.hdr->leven == 0 || map.hdr->iftype == 2 || map.hdr->iftype == 3)
+    ncomp = 2;
+  chk->npts = map.hdr->npts;
+  chk->size = map.size;
+  chk->expsize = sizeof(SacH) + ncomp * sizeof(float) * (long)chk->npts;
+  if (chk->size != chk->expsize) chk->flags |= CHK_SIZE;
+
+  scanData(map.data, map.npts, &chk->ds);
+  scale = fmax(fabs(chk->ds.min), fabs(chk->ds.max));
+  if (chk->ds.nnan > 0) chk->flags |= CHK_NAN;
+  if (chk->ds.ninf > 0) chk->flags |= CHK_INF;
+  if (chk->ds.maxrun > RUN_LIMIT) chk->flags |= CHK_RUN;
+  if (chk->ds.min < chk->ds.max &&
+      ((chk->ds.nmin > CLIP_LIMIT && chk->ds.runmin >= CLIP_RUN) ||
+       (chk->ds.nmax > CLIP_LIMIT && chk->ds.runmax >= CLIP_RUN)))
+    chk->flags |= CHK_CLIP;
+  if (!isDepOk(map.hdr->depmin, chk->ds.min, scale)) chk->flags |= CHK_DEPMIN;
+  if (!isDepOk(map.hdr->depmax, chk->ds.max, scale)) chk->flags |= CHK_DEPMAX;
+  if (!isDepOk(map.hdr->depmen, chk->ds.mean, scale)) chk->flags |= CHK_DEPMEN;
+  unmapSac(&map);
+}
+
+/*  Print result of the check as one line  */
+void
+printCheck (const char *path, const SacCheck *chk)
+{
+  int i, n = 0;
+  fprintf(stdout, "%s,%s,%ld,%ld,%ld,%ld,%ld,%ld,%ld,%g,%ld,%ld,%g,%g,%g,",
+          path, (chk->flags == 0) ? "OK" : "FAIL", chk->size, chk->expsize,
+          chk->npts, chk->ds.nnan, chk->ds.ninf, chk->ds.nzero,
+          chk->ds.maxrun, chk->ds.runval, chk->ds.nmin, chk->ds.nmax,
+          chk->ds.min, chk->ds.max, chk->ds.mean);
+  for (i = 0; i < 9; i++)
+    if (chk->flags & (1 << i))
+      fprintf(stdout, "%s%s", (n++ > 0) ? ";" : "", CHK_NAMES[i]);
+  fprintf(stdout, "\n");
+}
+/******************************************************************************/
+
+
+
+/*******************************************************************************
+**    Check task - files are checked in parallel by chunks, results of a chunk
+**  are printed in order of files before the next chunk starts
+*/
+#define CHECK_CHUNK 4096
+
+typedef struct {
+  char    **files;
+  SacCheck *chk;
+}  CheckCtx;
+
+void
+checkTask (void *ctx, long i)
+{
+  CheckCtx *cc = (CheckCtx*) ctx;
+  checkSac(cc->files[i], &cc->chk[i]);
+}
+
+void
+checkFiles (char **files, long nfiles, int nthreads)
+{
+  CheckCtx cc;   long i, n;
+  cc.chk = (SacCheck*) malloc(CHECK_CHUNK * sizeof(SacCheck));
+  if (cc.chk == NULL) { fprintf(stderr, "Not enough memory\n");  exit(1); }
+  SAO_COUNT(SAO_ST_ALLOC, CHECK_CHUNK * sizeof(SacCheck));
+  for (; nfiles > 0; files += n, nfiles -= n) {
+    n = (nfiles < CHECK_CHUNK) ? nfiles : CHECK_CHUNK;
+    cc.files = files;
+    runParallel(nthreads, n, checkTask, &cc);
+    SAO_PROBE_START(t0);
+    for (i = 0; i < n; i++) printCheck(files[i], &cc.chk[i]);
+    SAO_PROBE_STOP(SAO_ST_OUTPUT, t0, 0);
+  }
+  free(cc.chk);
+}
+/******************************************************************************/
+
+
+
+/*******************************************************************************
+**    Info task - headers are read in batch, callback prints info of each one
+**  in order of files
+*/
+typedef struct {
+  char    **files;
+  int       mode;
+}  InfoCtx;
+
+void
+printInfo (void *ctx, long i, int status, const SacH *hdr)
+{
+  InfoCtx *ic = (InfoCtx*) ctx;   char **files = ic->files;
+  char buf[SAO_SACINFO_LEN];   int mode = ic->mode, len = -1;
+  SAO_COUNT(SAO_ST_FILE, 0);
+  if (status == SAO_OK) len = sprintSacInfo(buf, sizeof(buf), *hdr, mode);
+  SAO_PROBE_START(t0);
+  if (status == SAO_EIO)
+    printf("%s - can not open file\n", files[i]);
+  else if (len < 0)
+    printf("%s - incorrect SAC file\n", files[i]);
+  else if (mode == 's')
+    printf("%s,%s\n", files[i], buf);
+  else
+    printf("File '%s' is a valid SAC file\n%s\n", files[i], buf);
+  SAO_PROBE_STOP(SAO_ST_OUTPUT, t0, 0);
+}
+/******************************************************************************/
+
+
+
 /*********************************************************************************    Main function - detecting options and defining program and output modes
 **  Program modes (int mode):
 **      0       no options    - print info about file(s)
 **      115     (-s) option   - print main info in line with commas
+**       99     (-c) option   - check data to header conformity in parallel
 */
 int main (int argc, char *argv[])
 {
-  char *options = "hs";    int   opt;
+  char *options = "hscj:R:g:x:";  int   opt;
   int   optdone = 0;        int   mode = 0;
-  FILE *fsac;               SacH  hdr;
-  char* buf;
+  InfoCtx ic;               int   nthreads = 0;
+  char *root = NULL,  *glob = NULL,  *regex = NULL;
+  char **files = NULL;      long  nfiles = 0;
+  int   stats = saoStatsArg(&argc, argv);
 
   while (optdone != 1) {
     if ((opt = getopt(argc, argv, options)) != -1) {
@@ -63,6 +258,21 @@ int main (int argc, char *argv[])
         case 's':
           mode = 's';
           break;
+        case 'c':
+          mode = 'c';
+          break;
+        case 'j':
+          nthreads = atoi(optarg);
+          break;
+        case 'R':
+          root = optarg;
+          break;
+        case 'g':
+          glob = optarg;
+          break;
+        case 'x':
+          regex = optarg;
+          break;
         default:
           optdone = 1;
           break;
@@ -71,26 +281,32 @@ int main (int argc, char *argv[])
     else optdone = 1;
   }
   //printf("Arguments count: %d, optind = %d\n", argc, optind);
-  if (optind < argc) {
-    while (optind < argc) {
-      if ((fsac = fopen(argv[optind], "rb")))
-      {
-        hdr = readSacH(fsac);
-        if (hdr.internal4 != 6)
-          printf("%s - incorrect SAC file\n", argv[optind]);
-        else {
-          buf = writeSacInfo(hdr, mode);
-          if (mode == 's')
-            printf("%s,%s\n", argv[optind], buf);
-          else
-            printf("File '%s' is a valid SAC file\n%s\n", argv[optind], buf);
-        }
-        optind++;
-        fclose(fsac);
-      }
+  if (root != NULL) {
+    nfiles = findFiles(root, glob, regex, nthreads, &files);
+    if (nfiles == SAO_EIO)
+      fprintf(stderr, "Can not read directory '%s'\n", root);
+    else if (nfiles == SAO_EFORMAT)
+      fprintf(stderr, "Incorrect regular expression '%s'\n", regex);
+    else if (nfiles < 0) fprintf(stderr, "Not enough memory\n");
+    if (nfiles < 0) exit(1);
+  }
+  else if (optind < argc) { files = argv + optind;  nfiles = argc - optind; }
+
+  if (nfiles > 0 && mode == 'c') {
+    fprintf(stdout, "# file,status,size,expected size,npts,nan,inf,zero,"
+            "longest run,run value,at min,at max,min,max,mean,problems\n");
+    checkFiles(files, nfiles, nthreads);
+  }
+  else if (nfiles > 0) {
+    ic.files = files;   ic.mode = mode;
+    if (readSacHs(files, nfiles, nthreads, printInfo, &ic) < 0) {
+      fprintf(stderr, "Not enough memory\n");
+      exit(1);
     }
   }
-  else programInfo(0);
+  else if (root == NULL) programInfo(0);
+  if (root != NULL) freeFiles(files, nfiles);
+  if (stats == 1) saoStatsReport(stderr, "sacinfo");
   return 0;
 }
 /******************************************************************************/
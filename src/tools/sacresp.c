@@ -0,0 +1,262 @@
+/*******************************************************************************
+**  sacresp.c - SAC file(s) Instrument Response Removal Tool
+**      Part of Seismicity Analysis Organizer
+**
+**  This program is based on 'saoresp.c' and 'saofft.c' (part of SAO core
+**  library) and 'saopz.c' (part of SAO system library)
+**  Program info and usage described in programInfo(..) functions
+**  The <unistd.h> is required for getopt(..) function
+*******************************************************************************/
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <stdatomic.h>
+
+#include "../../lib/saocore.h"
+#include "../../lib/saosys.h"
+#include "../../lib/saoprof.h"
+
+
+
+/*******************************************************************************
+**    Print program info and usage
+**      IN: 0 - program usage and info, 1 - full list of options
+*/
+void
+programInfo (int full)
+{
+  char *fullinfo =
+  "SAC file(s) Instrument Response Removal Tool.\n"
+  "Remove poles and zeros response from each FILE by spectral division and\n"
+  "write displacement, velocity or acceleration (meters and seconds).\n"
+  "Response of a trace is found by network, station, location, channel\n"
+  "and beginning of the trace among responses of SAC PZ files.\n\n"
+  "Options:\n"
+  "  -p=PZ          SAC PZ file or directory with them (may be repeated)\n"
+  "  -u=UNITS       output: d - displacement (default), v - velocity,\n"
+  "                 a - acceleration\n"
+  "  -w=LEVEL       water level in dB below maximum of response, default 60,\n"
+  "                 negative LEVEL switches it off\n"
+  "  -f=F1,F2,F3,F4 pre-filter, cosine taper from F1 to F2 and F3 to F4 Hz\n"
+  "  -o=DIR         write corrected files into DIR with the same names,\n"
+  "                 by default 'FILE.rm' is written next to FILE\n"
+  "  -R=DIR         take all files from DIR and its subdirectories\n"
+  "  -g=GLOB        with -R take only files with names matching GLOB\n"
+  "  -j=THREADS     number of threads, default all processors\n"
+  "  --stats        print JSON summary of time spent in stages to stderr\n"
+  "  -h             display this help and exit\n\n"
+  "Files which can not be corrected are listed with a reason to stderr,\n"
+  "exit status is 1 if there is at least one of them.\n\n"
+  "Examples:\n"
+  "  $ sacresp -p SAC_PZs_IU_ANMO_BHZ_00 -u v -f 0.005,0.01,8,10 *.sac\n"
+  "  $ sacresp -p /data/pz -o /data/vel -u v -R /data/sds -g '*.BH?.*'\n\n"
+  "Seismicity Analysis Organizer <https://github.com/ScibRam/SAO>.\n";
+
+  printf("Usage: sacresp [OPTION]... -p PZ FILE...\n");
+  printf("  or:  sacresp [OPTION]... -p PZ -R DIR\n");
+  if (full == 1) printf("%s\n", fullinfo);
+  else printf("Try 'sacresp -h' for full list of options and examples\n");
+  return ;
+}
+/******************************************************************************/
+
+
+
+/*******************************************************************************
+**    Results of correction of a file
+*/
+enum { RM_OK, RM_NOSAC, RM_FORMAT, RM_NORESP, RM_NOMEM, RM_WRITE };
+
+static const char*
+RM_NAMES[] = { "", "not a SAC file", "not an evenly sampled time series",
+               "no response", "not enough memory", "can not write output" };
+
+
+
+/*******************************************************************************
+**    Correction task - each thread keeps its own RespWork and sample buffer
+**  and takes files one by one, so buffers and inverse response are reused
+**  by the following traces of the same length and channel
+*/
+typedef struct {
+  char        **files;
+  long          nfiles;
+  atomic_long   next;
+  char         *status;
+  const char   *outdir;
+  RespCache     cache;
+  RespOpts      opts;
+}  RespCtx;
+
+/*  Path of the output file (caller frees it)  */
+char*
+outputPath (const char *path, const char *outdir)
+{
+  const char *name = strrchr(path, '/');   char *out;
+  name = (name == NULL) ? path : name + 1;
+  if (outdir == NULL) {
+    if ((out = (char*) malloc(strlen(path) + 4)) != NULL)
+      sprintf(out, "%s.rm", path);
+  }
+  else if ((out = (char*) malloc(strlen(outdir) + strlen(name) + 2)) != NULL)
+    sprintf(out, "%s/%s", outdir, name);
+  return out;
+}
+
+/*  Correct one file  */
+int
+correctSac (RespCtx *rc, const char *path, RespWork *w, float **buf, long *cap)
+{
+  SacMap map;   SacH hdr;   DataStat ds;   const Response *r = NULL;
+  char key[SAO_KEY_LEN], *out;   float *tmp;   int ret = RM_OK;
+
+  if (mapSac(path, &map) != SAO_OK) return RM_NOSAC;
+  hdr = *map.hdr;
+  if (hdr.leven != 1 || (hdr.iftype != 1 && hdr.iftype != -12345))
+    ret = RM_FORMAT;
+  else {
+    getSacKey(key, sizeof(key), &hdr);
+    r = findResponse(&rc->cache, key, toEpoch(getSacBegin(hdr)));
+    if (r == NULL) ret = RM_NORESP;
+  }
+  if (ret == RM_OK && map.npts > *cap) {
+    if ((tmp = (float*) realloc(*buf, map.npts * sizeof(float))) == NULL)
+      ret = RM_NOMEM;
+    else { *buf = tmp;   *cap = map.npts; }
+  }
+  if (ret == RM_OK) {
+    memcpy(*buf, map.data, map.npts * sizeof(float));
+    hdr.npts = map.npts;
+  }
+  unmapSac(&map);
+  if (ret != RM_OK) return ret;
+
+  ret = removeResponse(w, r, &rc->opts, *buf, hdr.npts, hdr.delta);
+  if (ret != SAO_OK) return (ret == SAO_ESPACE) ? RM_NOMEM : RM_FORMAT;
+  scanData(*buf, hdr.npts, &ds);
+  hdr.idep = 6 + rc->opts.units;        // IDISP, IVEL or IACC
+  hdr.depmin = ds.min;   hdr.depmax = ds.max;   hdr.depmen = ds.mean;
+  if ((out = outputPath(path, rc->outdir)) == NULL) return RM_NOMEM;
+  ret = (writeSac(out, &hdr, *buf) == SAO_OK) ? RM_OK : RM_WRITE;
+  free(out);
+  return ret;
+}
+
+void
+correctTask (void *ctx, long id)
+{
+  RespCtx *rc = (RespCtx*) ctx;   RespWork w;
+  float *buf = NULL;   long i, cap = 0;
+  memset(&w, 0, sizeof(RespWork));
+  while ((i = atomic_fetch_add(&rc->next, 1)) < rc->nfiles) {
+    SAO_COUNT(SAO_ST_FILE, 0);
+    rc->status[i] = correctSac(rc, rc->files[i], &w, &buf, &cap);
+  }
+  freeRespWork(&w);
+  free(buf);
+}
+/******************************************************************************/
+
+
+
+/*******************************************************************************
+**    Main function - detecting options, loading responses and correcting
+**  files in parallel
+*/
+int main (int argc, char *argv[])
+{
+  char *options = "hp:u:w:f:o:R:g:j:";   int opt;
+  int optdone = 0;              int nthreads = 0;
+  char *root = NULL,  *glob = NULL;   char **files = NULL;
+  long nfiles = 0, npz = 0, n, i;     RespCtx rc;
+  int stats = saoStatsArg(&argc, argv), failed = 0;
+
+  memset(&rc, 0, sizeof(RespCtx));
+  rc.opts.wlevel = 60.0;
+  while (optdone != 1) {
+    if ((opt = getopt(argc, argv, options)) != -1) {
+      switch (opt) {
+        case 'h':
+          programInfo(1);
+          exit(0);
+        case 'p':
+          if ((n = loadPZ(&rc.cache, optarg)) < 0) {
+            fprintf(stderr, "%s - can not load responses\n", optarg);
+            exit(1);
+          }
+          npz += n;
+          break;
+        case 'u':
+          if (strcmp(optarg, "d") == 0) rc.opts.units = 0;
+          else if (strcmp(optarg, "v") == 0) rc.opts.units = 1;
+          else if (strcmp(optarg, "a") == 0) rc.opts.units = 2;
+          else { fprintf(stderr, "Incorrect UNITS '%s'\n", optarg);  exit(1); }
+          break;
+        case 'w':
+          rc.opts.wlevel = atof(optarg);
+          break;
+        case 'f':
+          if (sscanf(optarg, "%lf,%lf,%lf,%lf", &rc.opts.pre[0],
+                     &rc.opts.pre[1], &rc.opts.pre[2], &rc.opts.pre[3]) != 4 ||
+              !(rc.opts.pre[0] < rc.opts.pre[1] &&
+                rc.opts.pre[1] <= rc.opts.pre[2] &&
+                rc.opts.pre[2] < rc.opts.pre[3])) {
+            fprintf(stderr, "Incorrect pre-filter '%s'\n", optarg);
+            exit(1);
+          }
+          break;
+        case 'o':
+          rc.outdir = optarg;
+          break;
+        case 'R':
+          root = optarg;
+          break;
+        case 'g':
+          glob = optarg;
+          break;
+        case 'j':
+          nthreads = atoi(optarg);
+          break;
+        default:
+          programInfo(0);
+          exit(1);
+      }
+    }
+    else optdone = 1;
+  }
+
+  if (root != NULL) {
+    if ((nfiles = findFiles(root, glob, NULL, nthreads, &files)) < 0) {
+      fprintf(stderr, "Can not read directory '%s'\n", root);
+      exit(1);
+    }
+  }
+  else if (optind < argc) { files = argv + optind;  nfiles = argc - optind; }
+  else { programInfo(0);  exit(0); }
+  if (npz == 0) {
+    fprintf(stderr, "No responses, use -p to load SAC PZ files\n");
+    exit(1);
+  }
+
+  rc.files = files;   rc.nfiles = nfiles;
+  atomic_init(&rc.next, 0);
+  if ((rc.status = (char*) malloc(nfiles + 1)) == NULL) {
+    fprintf(stderr, "Not enough memory\n");
+    exit(1);
+  }
+  if (nthreads <= 0) nthreads = getNumThreads();
+  runParallel(nthreads, nthreads, correctTask, &rc);
+  for (i = 0; i < nfiles; i++)
+    if (rc.status[i] != RM_OK) {
+      fprintf(stderr, "%s - %s\n", files[i], RM_NAMES[(int)rc.status[i]]);
+      failed = 1;
+    }
+
+  free(rc.status);
+  freeRespCache(&rc.cache);
+  if (root != NULL) freeFiles(files, nfiles);
+  if (stats == 1) saoStatsReport(stderr, "sacresp");
+  return failed;
+}
+/******************************************************************************/
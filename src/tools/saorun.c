@@ -0,0 +1,719 @@
+/*******************************************************************************
+**  saorun.c - SAC files Processing Pipeline Driver
+**      Part of SAO (Seismicity Analysis Organizer)
+**
+**  This program is based on 'saofilt.c', 'saotrig.c' and 'saopick.c' (part
+**  of SAO core library) and 'saowfm.c', 'saothr.c' and 'saodir.c' (part of
+**  SAO system library). All stages of a file are done in one process and one
+**  thread, trace is kept in an arena of the thread between stages. Only
+**  pick windows of a file are split among threads when there are fewer
+**  files than threads.
+**  Program info and usage described in programInfo(..) functions
+**  The <unistd.h> is required for getopt(..) function
+*******************************************************************************/
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <stddef.h>
+#include <unistd.h>
+
+#include "../../lib/saocore.h"
+#include "../../lib/saosys.h"
+#include "../../lib/saoprof.h"
+
+
+
+#define MAX_STAGES  32          // Stages of pipeline
+#define PICK_ORDER  8           // Order of AR models of picker
+
+
+
+/*******************************************************************************
+**    Print program info and usage
+**      IN: 0 - program usage and info, 1 - full list of options
+*/
+void
+programInfo (int full)
+{
+  char *fullinfo =
+  "SAC files Processing Pipeline Driver.\n"
+  "Run a pipeline of stages for each FILE in one process on a pool of\n"
+  "threads with work stealing. Trace is kept in memory between stages,\n"
+  "only 'write' stage writes a SAC file. With fewer files than threads pick\n"
+  "windows of each file are shared by its part of threads.\n\n"
+  "Options:\n"
+  "  -p=PIPELINE    stages separated by '|', see below\n"
+  "  -f=FILE        read pipeline from FILE (one stage per line, '#' starts\n"
+  "                 a comment)\n"
+  "  -i=LIST        take files from LIST (one path per line, '-' for stdin)\n"
+  "  -R=DIR         take all files from DIR and its subdirectories\n"
+  "  -g=GLOB        with -R take only files with names matching GLOB\n"
+  "  -x=REGEX       with -R take only files with relative paths matching\n"
+  "                 extended REGEX\n"
+  "  -S=K/N         process only shard K (0..N-1) of N equal parts of files\n"
+  "  -j=THREADS     number of threads, default all processors\n"
+  "  --stats        print JSON summary of time spent in stages to stderr\n"
+  "  -h             display this help and exit\n\n"
+  "Stages:\n"
+  "  read                    map SAC file and copy trace (always first)\n"
+  "  cut:T1,T2               keep samples from T1 to T2 seconds of reference\n"
+  "                          time (as B and E of the header)\n"
+  "  filter:lp|hp,F,ORD[,zp] Butterworth low-pass or high-pass, corner F Hz\n"
+  "  filter:bp,F1,F2,ORD[,zp]  Butterworth band-pass F1-F2 Hz, 'zp' makes\n"
+  "                          filter zero-phase\n"
+  "  detect:STA,LTA,ON,OFF   STA/LTA triggers, windows in seconds\n"
+  "  pick:PH,SRC,PRE,POST,KW[,MARK]  pick onset of phase PH (P or S) in\n"
+  "                          windows from PRE seconds before to POST seconds\n"
+  "                          after SRC: 'trig' for each trigger of the last\n"
+  "                          detect stage or header marker (a, t0..t9) of\n"
+  "                          theoretical arrival. Onset is refined by AR-AIC\n"
+  "                          near the maximum of kurtosis in KW seconds\n"
+  "                          window. The best pick is stored into MARK (a,\n"
+  "                          t0..t9) and its name like 'IP0' (K-field)\n"
+  "  write[:DIR]             write trace to DIR with the same name, by\n"
+  "                          default 'FILE.run' is written next to FILE\n\n"
+  "Triggers are printed as 'FILE,on,off,peak' lines in order of files.\n"
+  "With pick stages picks are printed instead as 'FILE,phase,time,snr,weight'\n"
+  "lines, weight is SAC quality 0 (best) to 4 given by SNR.\n"
+  "Files which can not be processed are listed with a reason to stderr,\n"
+  "exit status is 1 if there is at least one of them.\n\n"
+  "Examples:\n"
+  "  $ saorun -p 'cut:0,3600|filter:bp,1,10,4|detect:1,10,3.5,1.5' *.sac\n"
+  "  $ saorun -f detect.pipe -R /data/sds -g '*.HHZ.*' \\\n"
+  "           -S $SLURM_ARRAY_TASK_ID/$SLURM_ARRAY_TASK_COUNT\n"
+  "  $ saorun -p 'filter:bp,1,20,2|detect:0.5,10,4,1.5|pick:P,trig,2,3,.5'\n"
+  "           -i events.lst\n"
+  "  $ saorun -p 'pick:S,t1,3,3,0.3,t2|write:picked' *.HHE.sac\n\n"
+  "Seismicity Analysis Organizer <https://github.com/ScibRam/SAO>.\n";
+
+  printf("Usage: saorun [OPTION]... -p PIPELINE FILE...\n");
+  printf("  or:  saorun [OPTION]... -p PIPELINE -i LIST|-R DIR\n");
+  if (full == 1) printf("%s\n", fullinfo);
+  else printf("Try 'saorun -h' for full list of options and examples\n");
+  return ;
+}
+/******************************************************************************/
+
+
+
+/*******************************************************************************
+**    Stages of pipeline and results of processing of a file
+*/
+enum { ST_READ, ST_CUT, ST_FILTER, ST_DETECT, ST_PICK, ST_WRITE };
+
+static const char*
+STAGE_NAMES[] = { "read", "cut", "filter", "detect", "pick", "write" };
+
+enum { RUN_OK, RUN_NOSAC, RUN_FORMAT, RUN_CUT, RUN_PARAM, RUN_MARK,
+       RUN_NOMEM, RUN_WRITE };
+
+static const char*
+RUN_NAMES[] = { "", "not a SAC file", "not an evenly sampled time series",
+                "no samples in the window", "parameters do not suit sampling",
+                "no arrival marker in the header", "not enough memory",
+                "can not write output" };
+
+/*  Header markers of pick stage: a, t0..t9 or triggers of detect stage  */
+enum { MARK_NONE = -3, MARK_TRIG = -2, MARK_A = -1 };
+
+typedef struct {
+  int       type;
+  int       ftype,  order,  zp; // Filter type, order and zero-phase flag
+  double    arg[4];             // Times, corners, STA/LTA or pick windows
+  char     *dir;                // Output directory of write stage or NULL
+  char      phase;              // Phase of pick stage
+  int       src,    mark;       // Source of windows and marker of pick
+}  Stage;
+
+typedef struct {
+  double    time;               // Epoch time of onset
+  float     snr;
+  char      phase,  weight;
+}  RunPick;
+
+typedef struct {
+  char      status,  stage;     // RUN_* and failed stage
+  int       ntrig;              // Triggers of the last detect stage
+  Trigger  *trig;
+  double    b,  delta;          // Epoch time of the first sample of detection
+  long      npick,  maxpick;    // Picks of all pick stages
+  RunPick  *pick;
+}  RunResult;
+
+/*  Trace of a file between stages, samples are in the arena of thread  */
+typedef struct {
+  SacH      hdr;
+  float    *data;
+  long      npts;
+}  RunTrace;
+
+typedef struct {
+  Stage     stage[MAX_STAGES];
+  int       nstage,  picking;   // Picking is 1 if there is a pick stage
+  char    **files;
+  RunResult *res;
+  Arena    *arena;              // One arena for each thread
+  int       wthreads;           // Threads for pick windows of one file
+}  RunCtx;
+
+/*  Windows of equal length of one pick stage, groups of PICK_LANES of them
+**  are tasks of runStealing(..) with work arrays of threads  */
+typedef struct {
+  const float *x;
+  const long *start;
+  long      nb,  len,  nwin;
+  float    *work;
+  Pick     *batch;
+}  PickGroups;
+/******************************************************************************/
+
+
+
+/*******************************************************************************
+**    Header markers of picks
+**      OUT: MARK_A, 0..9 for t0..t9, MARK_TRIG or MARK_NONE (incorrect)
+*/
+int
+parseMark (const char *name)
+{
+  if (strcmp(name, "a") == 0) return MARK_A;
+  if (strcmp(name, "trig") == 0) return MARK_TRIG;
+  if (name[0] == 't' && name[1] >= '0' && name[1] <= '9' && name[2] == '\0')
+    return name[1] - '0';
+  return MARK_NONE;
+}
+
+/*  Marker time (a or t0..t9) and its K-field (ka or kt0..kt9) of header,
+**  the fields follow each other in SAC header  */
+float*
+markTime (SacH *hdr, int mark)
+{
+  return (mark == MARK_A) ? &hdr->a :
+         (float*)((char*) hdr + offsetof(SacH, t0)) + mark;
+}
+
+char*
+markName (SacH *hdr, int mark)
+{
+  return (mark == MARK_A) ? hdr->ka :
+         (char*) hdr + offsetof(SacH, kt0) + 8 * mark;
+}
+/******************************************************************************/
+
+
+
+/*******************************************************************************
+**    Parse one stage 'name[:arg,arg...]'
+**      OUT: 0 - success, -1 - incorrect stage
+*/
+int
+parseStage (char *spec, Stage *st)
+{
+  char *args = strchr(spec, ':'), ft[8], zp[4] = "", ph[2];   int n;
+  size_t len = (args != NULL) ? (size_t)(args++ - spec) : strlen(spec);
+
+  memset(st, 0, sizeof(Stage));
+  for (st->type = ST_READ; st->type <= ST_WRITE; st->type++)
+    if (strlen(STAGE_NAMES[st->type]) == len &&
+        strncmp(spec, STAGE_NAMES[st->type], len) == 0) break;
+
+  switch (st->type) {
+    case ST_READ:
+      return (args == NULL) ? 0 : -1;
+    case ST_CUT:
+      if (args == NULL || sscanf(args, "%lf,%lf%n", &st->arg[0], &st->arg[1],
+                                 &n) != 2 || args[n] != '\0')
+        return -1;
+      return (st->arg[0] < st->arg[1]) ? 0 : -1;
+    case ST_FILTER:
+      if (args == NULL || sscanf(args, "%2[a-z],%n", ft, &n) != 1) return -1;
+      args += n;
+      if (strcmp(ft, "bp") == 0) {
+        st->ftype = FILT_BP;
+        n = sscanf(args, "%lf,%lf,%d,%2s", &st->arg[0], &st->arg[1],
+                   &st->order, zp);
+        if (n < 3) return -1;
+      }
+      else {
+        st->ftype = (strcmp(ft, "lp") == 0) ? FILT_LP :
+                    (strcmp(ft, "hp") == 0) ? FILT_HP : -1;
+        n = sscanf(args, "%lf,%d,%2s", &st->arg[0], &st->order, zp);
+        if (st->ftype < 0 || n < 2) return -1;
+      }
+      if (zp[0] != '\0' && strcmp(zp, "zp") != 0) return -1;
+      st->zp = (zp[0] != '\0') ? 1 : 0;
+      return (st->order >= 1 && st->order <= FILT_MAXORD) ? 0 : -1;
+    case ST_DETECT:
+      if (args == NULL || sscanf(args, "%lf,%lf,%lf,%lf", &st->arg[0],
+                                 &st->arg[1], &st->arg[2], &st->arg[3]) != 4)
+        return -1;
+      return (st->arg[0] > 0.0 && st->arg[1] > st->arg[0] &&
+              st->arg[3] <= st->arg[2]) ? 0 : -1;
+    case ST_PICK:
+      if (args == NULL || sscanf(args, "%1[PS],%4[a-z0-9],%lf,%lf,%lf%n",
+                                 ph, ft, &st->arg[0], &st->arg[1],
+                                 &st->arg[2], &n) != 5)
+        return -1;
+      st->phase = ph[0];   st->src = parseMark(ft);   st->mark = MARK_NONE;
+      if (args[n] == ',') st->mark = parseMark(args + n + 1);
+      else if (args[n] != '\0') return -1;
+      return (st->src != MARK_NONE && st->mark != MARK_TRIG &&
+              (args[n] == '\0' || st->mark != MARK_NONE) &&
+              st->arg[0] >= 0.0 && st->arg[1] > 0.0 && st->arg[2] > 0.0 &&
+              st->arg[0] + st->arg[1] >= 3.0 * st->arg[2]) ? 0 : -1;
+    case ST_WRITE:
+      st->dir = (args != NULL && args[0] != '\0') ? strdup(args) : NULL;
+      return 0;
+  }
+  return -1;
+}
+
+/*  Parse stages separated by '|' or new lines, '#' comments are skipped
+**    OUT: 0 - success, -1 - error (reported to stderr)  */
+int
+parsePipeline (char *text, RunCtx *rc)
+{
+  char *line, *spec, *save1, *save2, *end;   Stage *st;   int detect = 0;
+
+  rc->nstage = 0;
+  for (line = strtok_r(text, "\n", &save1); line != NULL;
+       line = strtok_r(NULL, "\n", &save1)) {
+    if ((end = strchr(line, '#')) != NULL) *end = '\0';
+    for (spec = strtok_r(line, "|", &save2); spec != NULL;
+         spec = strtok_r(NULL, "|", &save2)) {
+      while (*spec == ' ' || *spec == '\t') spec++;
+      end = spec + strlen(spec);
+      while (end > spec && (end[-1] == ' ' || end[-1] == '\t' ||
+                            end[-1] == '\r')) *--end = '\0';
+      if (*spec == '\0') continue;
+      if (rc->nstage == 0 && strcmp(spec, "read") != 0)
+        rc->stage[rc->nstage++].type = ST_READ;     // Implicit first stage
+      if (rc->nstage == MAX_STAGES) {
+        fprintf(stderr, "Too many stages\n");
+        return -1;
+      }
+      st = &rc->stage[rc->nstage];
+      if (parseStage(spec, st) != 0 || (st->type == ST_READ && rc->nstage > 0)
+          || (st->type == ST_PICK && st->src == MARK_TRIG && detect == 0)) {
+        fprintf(stderr, "Incorrect stage '%s'\n", spec);
+        return -1;
+      }
+      if (st->type == ST_DETECT) detect = 1;
+      if (st->type == ST_PICK) rc->picking = 1;
+      rc->nstage++;
+    }
+  }
+  if (rc->nstage == 0) {
+    fprintf(stderr, "Empty pipeline\n");
+    return -1;
+  }
+  return 0;
+}
+/******************************************************************************/
+
+
+
+/*******************************************************************************
+**    Read whole text file or list of lines
+**      OUT: Text (caller frees it) or NULL
+*/
+char*
+readText (const char *path)
+{
+  FILE *f = (strcmp(path, "-") == 0) ? stdin : fopen(path, "r");
+  char *text = NULL, *tmp;   size_t len = 0, cap = 0, k;
+
+  if (f == NULL) return NULL;
+  do {
+    if (len + 4096 + 1 > cap) {
+      cap = 2 * cap + 4096 + 1;
+      if ((tmp = (char*) realloc(text, cap)) == NULL) {
+        free(text);   text = NULL;
+        break;
+      }
+      text = tmp;
+    }
+    k = fread(text + len, 1, 4096, f);   len += k;
+  } while (k > 0);
+  if (f != stdin) fclose(f);
+  if (text != NULL) text[len] = '\0';
+  return text;
+}
+
+/*  Split text into non-empty lines (pointers into the text)
+**    OUT: Number of lines or -1 if there is no memory  */
+long
+splitLines (char *text, char ***lines)
+{
+  char *line, *save, **tmp;   long n = 0, cap = 0;
+  *lines = NULL;
+  for (line = strtok_r(text, "\r\n", &save); line != NULL;
+       line = strtok_r(NULL, "\r\n", &save)) {
+    if (n == cap) {
+      cap = 2 * cap + 1024;
+      if ((tmp = (char**) realloc(*lines, cap * sizeof(char*))) == NULL)
+        return -1;
+      *lines = tmp;
+    }
+    (*lines)[n++] = line;
+  }
+  return n;
+}
+/******************************************************************************/
+
+
+
+/*******************************************************************************
+**    Stages of a trace
+**      OUT: RUN_OK or RUN_* code of failure
+*/
+int
+readStage (RunTrace *tr, const char *path, Arena *a)
+{
+  SacMap map;
+  if (mapSac(path, &map) != SAO_OK) return RUN_NOSAC;
+  if (map.hdr->leven != 1 || !(map.hdr->delta > 0.0) || map.npts < 1) {
+    unmapSac(&map);
+    return RUN_FORMAT;
+  }
+  if ((tr->data = (float*) arenaAlloc(a, map.npts * sizeof(float))) == NULL) {
+    unmapSac(&map);
+    return RUN_NOMEM;
+  }
+  memcpy(tr->data, map.data, map.npts * sizeof(float));
+  tr->hdr = *map.hdr;   tr->npts = map.npts;   tr->hdr.npts = map.npts;
+  unmapSac(&map);
+  return RUN_OK;
+}
+
+int
+cutStage (RunTrace *tr, const Stage *st)
+{
+  double delta = tr->hdr.delta;   long i1, i2;
+  i1 = (long) ceil((st->arg[0] - tr->hdr.b) / delta - 1e-2);
+  i2 = (long) floor((st->arg[1] - tr->hdr.b) / delta + 1e-2);
+  if (i1 < 0) i1 = 0;
+  if (i2 > tr->npts - 1) i2 = tr->npts - 1;
+  if (i1 > i2) return RUN_CUT;
+  tr->data += i1;   tr->npts = i2 - i1 + 1;   tr->hdr.npts = tr->npts;
+  tr->hdr.b += i1 * delta;   tr->hdr.e = tr->hdr.b + (tr->npts - 1) * delta;
+  return RUN_OK;
+}
+
+int
+filterStage (RunTrace *tr, const Stage *st)
+{
+  Filter f;
+  if (designFilter(&f, st->ftype, st->arg[0], st->arg[1], st->order, st->zp,
+                   tr->hdr.delta) != SAO_OK)
+    return RUN_PARAM;
+  applyFilter(&f, tr->data, tr->npts);
+  return RUN_OK;
+}
+
+int
+detectStage (RunTrace *tr, const Stage *st, Arena *a, RunResult *res)
+{
+  float *cf;   long k;   double delta = tr->hdr.delta;
+  if ((cf = (float*) arenaAlloc(a, tr->npts * sizeof(float))) == NULL)
+    return RUN_NOMEM;
+  if (staLta(tr->data, tr->npts, lround(st->arg[0] / delta),
+             lround(st->arg[1] / delta), cf) != SAO_OK)
+    return RUN_PARAM;
+  // First pass only counts triggers, so none of them is dropped
+  k = findTriggers(cf, tr->npts, st->arg[2], st->arg[3], NULL, 0);
+  free(res->trig);
+  res->trig = NULL;   res->ntrig = 0;
+  if (k > 0) {
+    if ((res->trig = (Trigger*) malloc(k * sizeof(Trigger))) == NULL)
+      return RUN_NOMEM;
+    res->ntrig = findTriggers(cf, tr->npts, st->arg[2], st->arg[3],
+                              res->trig, k);
+  }
+  res->b = toEpoch(getSacBegin(tr->hdr));   res->delta = delta;
+  return RUN_OK;
+}
+
+void
+pickGroup (void *ctx, long g, int thread)
+{
+  PickGroups *pg = (PickGroups*) ctx;   long b = g * PICK_LANES, k, ng;
+  ng = (pg->nb - b < PICK_LANES) ? pg->nb - b : PICK_LANES;
+  if (pickBatch(pg->x, pg->start + b, ng, pg->len, pg->nwin, PICK_ORDER,
+                pg->work + thread * PICK_LANES * pg->len, pg->batch + b) < 0)
+    for (k = 0; k < ng; k++) pg->batch[b + k].idx = -1;
+}
+
+int
+pickStage (RunTrace *tr, const Stage *st, Arena *a, RunResult *res,
+           int nthreads)
+{
+  double delta = tr->hdr.delta, b = toEpoch(getSacBegin(tr->hdr)), mark = 0;
+  long npre = lround(st->arg[0] / delta), npost = lround(st->arg[1] / delta);
+  long nwin = lround(st->arg[2] / delta), nw, w, c, lo, hi, best = -1;
+  long len = npre + npost + 1, *win, *start, nb = 0;
+  float *work, snr = -1.0;   int weight = 4;   Pick p, *batch;   RunPick *tmp;
+  PickGroups pg;
+
+  if (nwin < 4) return RUN_PARAM;
+  if (st->src == MARK_TRIG) nw = res->ntrig;
+  else {
+    mark = *markTime(&tr->hdr, st->src);   nw = 1;
+    if (mark == -12345.0) return RUN_MARK;
+  }
+  if (nthreads > (nw + PICK_LANES - 1) / PICK_LANES)    // Work of threads
+    nthreads = (nw > 0) ? (nw + PICK_LANES - 1) / PICK_LANES : 1;
+  work = (float*) arenaAlloc(a, nthreads * PICK_LANES * len * sizeof(float));
+  win = (long*) arenaAlloc(a, (3 * nw + 1) * sizeof(long));
+  batch = (Pick*) arenaAlloc(a, (nw + 1) * sizeof(Pick));
+  if (work == NULL || win == NULL || batch == NULL) return RUN_NOMEM;
+  start = win + 2 * nw;
+
+  for (w = 0; w < nw; w++) {                    // Whole windows go at once
+    if (st->src == MARK_TRIG)                   // Trace may be cut after
+      c = res->trig[w].on + lround((res->b - b) / delta);
+    else c = lround((mark - tr->hdr.b) / delta);
+    lo = win[2 * w] = (c - npre > 0) ? c - npre : 0;
+    hi = win[2 * w + 1] = (c + npost + 1 < tr->npts) ? c + npost + 1 : tr->npts;
+    if (hi - lo == len) start[nb++] = lo;
+  }
+  pg.x = tr->data;   pg.start = start;   pg.nb = nb;   pg.len = len;
+  pg.nwin = nwin;   pg.work = work;   pg.batch = batch;
+  if (nb > 0)
+    runStealing(nthreads, (nb + PICK_LANES - 1) / PICK_LANES, pickGroup, &pg);
+
+  for (nb = w = 0; w < nw; w++) {
+    lo = win[2 * w];   hi = win[2 * w + 1];
+    if (hi - lo == len) {
+      if ((p = batch[nb++]).idx < 0) continue;
+    }
+    else if (hi - lo < 3 * nwin ||
+             pickOnset(tr->data + lo, hi - lo, nwin, PICK_ORDER, work, &p))
+      continue;
+    if (res->npick == res->maxpick) {
+      res->maxpick = 2 * res->maxpick + 16;
+      tmp = (RunPick*) realloc(res->pick, res->maxpick * sizeof(RunPick));
+      if (tmp == NULL) return RUN_NOMEM;
+      res->pick = tmp;
+    }
+    tmp = &res->pick[res->npick++];
+    tmp->time = b + (lo + p.idx) * delta;   tmp->snr = p.snr;
+    tmp->phase = st->phase;   tmp->weight = p.weight;
+    if (p.snr > snr) { snr = p.snr;  best = lo + p.idx;  weight = p.weight; }
+  }
+  if (st->mark != MARK_NONE && best >= 0) {     // Like 'IP0' or 'ES3'
+    *markTime(&tr->hdr, st->mark) = tr->hdr.b + best * delta;
+    memset(markName(&tr->hdr, st->mark), ' ', 8);
+    markName(&tr->hdr, st->mark)[0] = (weight <= 1) ? 'I' : 'E';
+    markName(&tr->hdr, st->mark)[1] = st->phase;
+    markName(&tr->hdr, st->mark)[2] = '0' + weight;
+  }
+  return RUN_OK;
+}
+
+int
+writeStage (RunTrace *tr, const Stage *st, const char *path, Arena *a)
+{
+  const char *name = strrchr(path, '/');   char *out;   DataStat ds;
+  name = (name == NULL) ? path : name + 1;
+  if (st->dir == NULL) {
+    if ((out = (char*) arenaAlloc(a, strlen(path) + 5)) != NULL)
+      sprintf(out, "%s.run", path);
+  }
+  else if ((out = (char*) arenaAlloc(a, strlen(st->dir) + strlen(name) + 2)))
+    sprintf(out, "%s/%s", st->dir, name);
+  if (out == NULL) return RUN_NOMEM;
+  scanData(tr->data, tr->npts, &ds);
+  tr->hdr.depmin = ds.min;   tr->hdr.depmax = ds.max;
+  tr->hdr.depmen = ds.mean;
+  return (writeSac(out, &tr->hdr, tr->data) == SAO_OK) ? RUN_OK : RUN_WRITE;
+}
+/******************************************************************************/
+
+
+
+/*******************************************************************************
+**    Pipeline task - all stages of one file in the arena of the thread
+*/
+void
+runTask (void *ctx, long i, int thread)
+{
+  RunCtx *rc = (RunCtx*) ctx;   Arena *a = &rc->arena[thread];
+  RunResult *res = &rc->res[i];   RunTrace tr;   const Stage *st;
+  int k, ret = RUN_OK;
+
+  SAO_COUNT(SAO_ST_FILE, 0);
+  resetArena(a);
+  memset(&tr, 0, sizeof(RunTrace));
+  for (k = 0; k < rc->nstage && ret == RUN_OK; k++) {
+    st = &rc->stage[k];
+    switch (st->type) {
+      case ST_READ:
+        ret = readStage(&tr, rc->files[i], a);
+        break;
+      case ST_CUT:
+        ret = cutStage(&tr, st);
+        break;
+      case ST_FILTER:
+        ret = filterStage(&tr, st);
+        break;
+      case ST_DETECT:
+        ret = detectStage(&tr, st, a, res);
+        break;
+      case ST_PICK:
+        ret = pickStage(&tr, st, a, res, rc->wthreads);
+        break;
+      case ST_WRITE:
+        ret = writeStage(&tr, st, rc->files[i], a);
+        break;
+    }
+    if (ret != RUN_OK) { res->status = ret;  res->stage = st->type; }
+  }
+}
+/******************************************************************************/
+
+
+
+/*******************************************************************************
+**    Print triggers (or picks if there are pick stages) and failures in
+**    order of files
+**      OUT: 0 - all files are processed, 1 - some files failed
+*/
+int
+printResults (const RunCtx *rc, long nfiles)
+{
+  char t1[SAO_MOMENT_LEN], t2[SAO_MOMENT_LEN];   const RunResult *r;
+  const Trigger *tg;   double e1, e2;   long i, k;   int failed = 0;
+  SAO_PROBE_START(t0);
+
+  for (i = 0; i < nfiles; i++) {
+    r = &rc->res[i];
+    if (r->status != RUN_OK) {
+      fprintf(stderr, "%s - %s: %s\n", rc->files[i],
+              STAGE_NAMES[(int)r->stage], RUN_NAMES[(int)r->status]);
+      failed = 1;
+    }
+    for (k = 0; k < r->npick; k++) {
+      e1 = round(r->pick[k].time * 1e3) / 1e3;
+      sprintMoment(t1, SAO_MOMENT_LEN, fromEpoch(e1), "ISO");
+      fprintf(stdout, "%s,%c,%s,%.2f,%d\n", rc->files[i], r->pick[k].phase,
+              t1, r->pick[k].snr, r->pick[k].weight);
+    }
+    for (k = 0; k < r->ntrig && rc->picking == 0; k++) {
+      tg = &r->trig[k];                       // Milliseconds of Moment
+      e1 = round((r->b + tg->on * r->delta) * 1e3) / 1e3;
+      e2 = round((r->b + tg->off * r->delta) * 1e3) / 1e3;
+      sprintMoment(t1, SAO_MOMENT_LEN, fromEpoch(e1), "ISO");
+      sprintMoment(t2, SAO_MOMENT_LEN, fromEpoch(e2), "ISO");
+      fprintf(stdout, "%s,%s,%s,%.2f\n", rc->files[i], t1, t2, tg->peak);
+    }
+  }
+  SAO_PROBE_STOP(SAO_ST_OUTPUT, t0, 0);
+  return failed;
+}
+/******************************************************************************/
+
+
+
+/*******************************************************************************
+**    Main function - detecting options, taking files and running pipeline
+*/
+int main (int argc, char *argv[])
+{
+  char *options = "hp:f:i:R:g:x:S:j:";   int opt;
+  int optdone = 0;              int nthreads = 0;
+  char *pipe = NULL, *list = NULL, *root = NULL, *glob = NULL, *regex = NULL;
+  char **files = NULL, *text = NULL, **all;
+  long nfiles = 0, lo, hi, i;   int shard = 0, nshards = 1;   RunCtx rc;
+  int stats = saoStatsArg(&argc, argv), failed;
+
+  memset(&rc, 0, sizeof(RunCtx));
+  while (optdone != 1) {
+    if ((opt = getopt(argc, argv, options)) != -1) {
+      switch (opt) {
+        case 'h':
+          programInfo(1);
+          exit(0);
+        case 'p':
+          pipe = strdup(optarg);
+          break;
+        case 'f':
+          if ((pipe = readText(optarg)) == NULL) {
+            fprintf(stderr, "%s - can not read pipeline\n", optarg);
+            exit(1);
+          }
+          break;
+        case 'i':
+          list = optarg;
+          break;
+        case 'R':
+          root = optarg;
+          break;
+        case 'g':
+          glob = optarg;
+          break;
+        case 'x':
+          regex = optarg;
+          break;
+        case 'S':
+          if (sscanf(optarg, "%d/%d", &shard, &nshards) != 2 ||
+              nshards < 1 || shard < 0 || shard >= nshards) {
+            fprintf(stderr, "Incorrect shard '%s'\n", optarg);
+            exit(1);
+          }
+          break;
+        case 'j':
+          nthreads = atoi(optarg);
+          break;
+        default:
+          programInfo(0);
+          exit(1);
+      }
+    }
+    else optdone = 1;
+  }
+  if (pipe == NULL) { programInfo(0);  exit(0); }
+  if (parsePipeline(pipe, &rc) != 0) exit(1);
+
+  if (list != NULL) {
+    if ((text = readText(list)) == NULL ||
+        (nfiles = splitLines(text, &files)) < 0) {
+      fprintf(stderr, "%s - can not read list of files\n", list);
+      exit(1);
+    }
+  }
+  else if (root != NULL) {
+    if ((nfiles = findFiles(root, glob, regex, nthreads, &files)) < 0) {
+      if (nfiles == SAO_EFORMAT)
+        fprintf(stderr, "Incorrect regular expression '%s'\n", regex);
+      else fprintf(stderr, "Can not read directory '%s'\n", root);
+      exit(1);
+    }
+  }
+  else if (optind < argc) { files = argv + optind;  nfiles = argc - optind; }
+  else { programInfo(0);  exit(0); }
+
+  lo = nfiles * shard / nshards;   hi = nfiles * (shard + 1) / nshards;
+  all = files;   rc.files = files + lo;
+  if (nthreads <= 0) nthreads = getNumThreads();
+  rc.res = (RunResult*) calloc(hi - lo + 1, sizeof(RunResult));
+  rc.arena = (Arena*) calloc(nthreads, sizeof(Arena));
+  if (rc.res == NULL || rc.arena == NULL) {
+    fprintf(stderr, "Not enough memory\n");
+    exit(1);
+  }
+  rc.wthreads = (hi - lo > 0 && hi - lo < nthreads) ? nthreads / (hi - lo) : 1;
+  runStealing(nthreads, hi - lo, runTask, &rc);
+  failed = printResults(&rc, hi - lo);
+
+  for (i = 0; i < hi - lo; i++) { free(rc.res[i].trig);  free(rc.res[i].pick); }
+  for (i = 0; i < nthreads; i++) freeArena(&rc.arena[i]);
+  for (i = 0; i < rc.nstage; i++) free(rc.stage[i].dir);
+  free(rc.res);   free(rc.arena);   free(pipe);
+  if (list != NULL) { free(all);  free(text); }
+  else if (root != NULL) freeFiles(all, nfiles);
+  if (stats == 1) saoStatsReport(stderr, "saorun");
+  return failed;
+}
+/******************************************************************************/
@@ -0,0 +1,498 @@
+/*******************************************************************************
+**  seisring.c - Real-time Seismic Data Ring Tool
+**      Part of Seismicity Analysis Organizer
+**
+**  This program is based on 'saoring.c' and 'saowfm.c' (part of SAO system
+**  library). One program is the ingest daemon, a feeder of SAC files (stand-in
+**  for SeedLink client) and a simple consumer of the shared memory rings.
+**  Program info and usage described in programInfo(..) functions
+**  The <unistd.h> is required for getopt(..) function
+*******************************************************************************/
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <pthread.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+
+#include "../../lib/saocore.h"
+#include "../../lib/saosys.h"
+#include "../../lib/saoprof.h"
+
+
+
+#define MAX_PACKET (1 << 20)    // Maximum samples of one packet
+#define MAX_FIFO_PACKET ((PIPE_BUF - (long) sizeof(RingPacket)) / \
+                         (long) sizeof(float))  // Atomic write to a pipe
+
+
+
+/*******************************************************************************
+**    Print program info and usage
+**      IN: 0 - program usage and info, 1 - full list of options
+*/
+void
+programInfo (int full)
+{
+  char *fullinfo =
+  "Real-time Seismic Data Ring Tool.\n"
+  "Keep live samples of channels in ring buffers of shared memory NAME, so\n"
+  "detectors and filters read them with their own cursors as soon as\n"
+  "packets come. Daemon takes packets from a local socket and/or a named\n"
+  "pipe, each packet is a header (see RingPacket in 'saosys.h') followed\n"
+  "by float samples. Packets of a channel may come from several producers,\n"
+  "gaps are filled with NaN, repeated samples are dropped.\n\n"
+  "Options:\n"
+  "  -d             run ingest daemon until SIGINT or SIGTERM\n"
+  "  -s             send FILE(S) as packets to the daemon\n"
+  "  -l             list channels of the ring\n"
+  "  -r=KEY         print new samples of channel KEY as 'time,value' lines\n"
+  "  -a             with -r start from the oldest sample kept in the ring\n"
+  "  -n=NAME        name of shared memory, default 'sao'\n"
+  "  -u=SOCKET      local socket of the daemon\n"
+  "  -p=FIFO        named pipe of the daemon\n"
+  "  -c=CHANNELS    maximum number of channels of the daemon, default 64\n"
+  "  -b=SAMPLES     ring size of each channel, power of two, default 1048576\n"
+  "  -k=SAMPLES     samples per packet for -s, default 512 (with -p it is\n"
+  "                 limited, so a packet is one atomic write to the pipe)\n"
+  "  -t             with -s send packets at real-time pace\n"
+  "  --stats        print JSON summary of time spent in stages to stderr\n"
+  "  -h             display this help and exit\n\n"
+  "Channel KEY is 'NET.STA.LOC.CHA', time is epoch time of the sample.\n\n"
+  "Examples:\n"
+  "  $ seisring -d -u /tmp/sao.sock -b 262144 &\n"
+  "  $ seisring -s -t -u /tmp/sao.sock /data/2018/*.HHZ.sac\n"
+  "  $ seisring -r XX.STA..HHZ\n\n"
+  "Seismicity Analysis Organizer <https://github.com/ScibRam/SAO>.\n";
+
+  printf("Usage: seisring -d [OPTION]...\n");
+  printf("  or:  seisring -s [OPTION]... FILE...\n");
+  printf("  or:  seisring -l|-r KEY [OPTION]...\n");
+  if (full == 1) printf("%s\n", fullinfo);
+  else printf("Try 'seisring -h' for full list of options and examples\n");
+  return ;
+}
+/******************************************************************************/
+
+
+
+/*******************************************************************************
+**    Read or write exactly n bytes
+**      OUT: 0 - success, -1 - end of stream or error
+*/
+int
+readFull (int fd, void *buf, size_t n)
+{
+  char *p = (char*) buf;   ssize_t k;
+  while (n > 0) {
+    if ((k = read(fd, p, n)) <= 0) {
+      if (k < 0 && errno == EINTR) continue;
+      return -1;
+    }
+    p += k;   n -= k;
+  }
+  return 0;
+}
+
+int
+writeFull (int fd, const void *buf, size_t n)
+{
+  const char *p = (const char*) buf;   ssize_t k;
+  while (n > 0) {
+    if ((k = write(fd, p, n)) <= 0) {
+      if (k < 0 && errno == EINTR) continue;
+      return -1;
+    }
+    p += k;   n -= k;
+  }
+  return 0;
+}
+/******************************************************************************/
+
+
+
+/*******************************************************************************
+**    Daemon - one thread per client of the socket and one for the pipe,
+**  each of them is a producer of the rings
+*/
+typedef struct {
+  SaoRing   ring;
+  int       fd;                 // Listening socket
+  char     *fifo;
+}  Daemon;
+
+typedef struct {
+  Daemon   *dm;
+  int       fd;
+}  Client;
+
+/*  Read packets of a stream until its end. After an incorrect packet
+**  header the stream is resynchronized by the next packet magic.  */
+void
+ingest (SaoRing *ring, int fd)
+{
+  RingPacket pk;   char *h = (char*) &pk;   float *x = NULL, *tmp;
+  long cap = 0, skip;   int ret, eos = 0;
+  while (eos == 0 && readFull(fd, &pk, sizeof(RingPacket)) == 0) {
+    for (skip = 0; pk.magic != PACKET_MAGIC || pk.nsamp < 0 ||
+                   pk.nsamp > MAX_PACKET; skip++) {
+      memmove(h, h + 1, sizeof(RingPacket) - 1);
+      if (readFull(fd, h + sizeof(RingPacket) - 1, 1) != 0) {
+        eos = 1;
+        break;
+      }
+    }
+    if (skip > 0)
+      fprintf(stderr, "Incorrect packet, %ld bytes of stream are skipped\n",
+              skip);
+    if (eos == 1) break;
+    if (pk.nsamp > cap) {
+      if ((tmp = (float*) realloc(x, pk.nsamp * sizeof(float))) == NULL) break;
+      x = tmp;   cap = pk.nsamp;
+    }
+    if (readFull(fd, x, pk.nsamp * sizeof(float)) != 0) break;
+    pk.key[SAO_KEY_LEN-1] = '\0';
+    ret = writeRing(ring, pk.key, pk.epoch, pk.delta, x, pk.nsamp);
+    if (ret == SAO_ESPACE)
+      fprintf(stderr, "%s - no free channel in the ring\n", pk.key);
+    else if (ret == SAO_EFORMAT)
+      fprintf(stderr, "%s - sampling differs from the ring\n", pk.key);
+  }
+  free(x);
+}
+
+void*
+clientThread (void *arg)
+{
+  Client *cl = (Client*) arg;
+  ingest(&cl->dm->ring, cl->fd);
+  close(cl->fd);
+  free(cl);
+  return NULL;
+}
+
+void*
+socketThread (void *arg)
+{
+  Daemon *dm = (Daemon*) arg;   Client *cl;   pthread_t th;   int fd;
+  while ((fd = accept(dm->fd, NULL, NULL)) >= 0 || errno == EINTR) {
+    if (fd < 0) continue;
+    if ((cl = (Client*) malloc(sizeof(Client))) == NULL) {
+      close(fd);
+      continue;
+    }
+    cl->dm = dm;   cl->fd = fd;
+    if (pthread_create(&th, NULL, clientThread, cl) != 0) {
+      close(fd);   free(cl);
+    }
+    else pthread_detach(th);
+  }
+  return NULL;
+}
+
+void*
+fifoThread (void *arg)
+{
+  Daemon *dm = (Daemon*) arg;   int fd;
+  while ((fd = open(dm->fifo, O_RDONLY)) >= 0) {   // Waits for a writer
+    ingest(&dm->ring, fd);
+    close(fd);
+  }
+  fprintf(stderr, "%s - can not open named pipe\n", dm->fifo);
+  return NULL;
+}
+
+/*  Run daemon until a signal  */
+int
+runDaemon (const char *name, const char *sock, char *fifo, int nchan, long cap)
+{
+  static Daemon dm;   // Detached producers use it until the process exits
+  struct sockaddr_un addr;   sigset_t set;   pthread_t th;
+  int sig, ret;
+
+  memset(&dm, 0, sizeof(Daemon));
+  dm.fd = -1;   dm.fifo = fifo;
+  if (sock == NULL && fifo == NULL) {
+    fprintf(stderr, "No input, use -u SOCKET and/or -p FIFO\n");
+    return -1;
+  }
+  if ((ret = createRing(&dm.ring, name, nchan, cap)) != SAO_OK) {
+    if (ret == SAO_EFORMAT)
+      fprintf(stderr, "Incorrect number of channels or ring size\n");
+    else fprintf(stderr, "Can not create shared memory '%s'\n", name);
+    return -1;
+  }
+  sigemptyset(&set);
+  sigaddset(&set, SIGINT);   sigaddset(&set, SIGTERM);
+  sigaddset(&set, SIGPIPE);
+  pthread_sigmask(SIG_BLOCK, &set, NULL);
+
+  if (sock != NULL) {
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    snprintf(addr.sun_path, sizeof(addr.sun_path), "%s", sock);
+    unlink(sock);
+    if ((dm.fd = socket(AF_UNIX, SOCK_STREAM, 0)) < 0 ||
+        bind(dm.fd, (struct sockaddr*) &addr, sizeof(addr)) != 0 ||
+        listen(dm.fd, 64) != 0 ||
+        pthread_create(&th, NULL, socketThread, &dm) != 0) {
+      fprintf(stderr, "%s - can not listen on socket\n", sock);
+      closeRing(&dm.ring, name);
+      return -1;
+    }
+  }
+  if (fifo != NULL) {
+    if ((mkfifo(fifo, 0644) != 0 && errno != EEXIST) ||
+        pthread_create(&th, NULL, fifoThread, &dm) != 0) {
+      fprintf(stderr, "%s - can not create named pipe\n", fifo);
+      if (sock != NULL) unlink(sock);
+      unlinkRing(name);
+      return -1;
+    }
+  }
+
+  while (sigwait(&set, &sig) == 0 && sig == SIGPIPE) ;
+  // Producers may still be in writeRing, the exit releases the mapping
+  if (sock != NULL) unlink(sock);
+  unlinkRing(name);
+  return 0;
+}
+/******************************************************************************/
+
+
+
+/*******************************************************************************
+**    Send SAC files as packets to the socket or the pipe of the daemon
+**      OUT: 0 - success, -1 - error
+*/
+int
+sendFiles (char **files, int nfiles, const char *sock, const char *fifo,
+           long k, int pace)
+{
+  struct sockaddr_un addr;   SacMap map;   RingPacket pk;   char *buf;
+  struct timespec ts;   int fd, i, ret = 0;   long j, n;   double b;
+
+  if (sock != NULL) {
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    snprintf(addr.sun_path, sizeof(addr.sun_path), "%s", sock);
+    if ((fd = socket(AF_UNIX, SOCK_STREAM, 0)) >= 0 &&
+        connect(fd, (struct sockaddr*) &addr, sizeof(addr)) != 0) {
+      close(fd);   fd = -1;
+    }
+  }
+  else if (fifo != NULL) fd = open(fifo, O_WRONLY);
+  else {
+    fprintf(stderr, "No output, use -u SOCKET or -p FIFO\n");
+    return -1;
+  }
+  if (fd < 0) {
+    fprintf(stderr, "%s - can not connect to daemon\n",
+            (sock != NULL) ? sock : fifo);
+    return -1;
+  }
+  signal(SIGPIPE, SIG_IGN);
+  if (sock == NULL && k > MAX_FIFO_PACKET) k = MAX_FIFO_PACKET;
+  if ((buf = (char*) malloc(sizeof(RingPacket) + k * sizeof(float))) == NULL) {
+    fprintf(stderr, "Not enough memory\n");
+    close(fd);
+    return -1;
+  }
+
+  for (i = 0; i < nfiles && ret == 0; i++) {
+    SAO_COUNT(SAO_ST_FILE, 0);
+    if (mapSac(files[i], &map) != SAO_OK) {
+      fprintf(stderr, "%s - not a SAC file\n", files[i]);
+      continue;
+    }
+    memset(&pk, 0, sizeof(RingPacket));
+    pk.magic = PACKET_MAGIC;   pk.delta = map.hdr->delta;
+    getSacKey(pk.key, SAO_KEY_LEN, map.hdr);
+    b = toEpoch(getSacBegin(*map.hdr));
+    if (map.hdr->leven != 1 || !(pk.delta > 0.0)) {
+      fprintf(stderr, "%s - not an evenly sampled time series\n", files[i]);
+      unmapSac(&map);
+      continue;
+    }
+    for (j = 0; j < map.npts && ret == 0; j += n) {
+      n = (map.npts - j < k) ? map.npts - j : k;
+      pk.nsamp = n;   pk.epoch = b + j * pk.delta;
+      SAO_PROBE_START(t0);      // One write, packets of producers can not mix
+      memcpy(buf, &pk, sizeof(RingPacket));
+      memcpy(buf + sizeof(RingPacket), map.data + j, n * sizeof(float));
+      if (writeFull(fd, buf, sizeof(RingPacket) + n * sizeof(float)) != 0) {
+        fprintf(stderr, "Connection to daemon is lost\n");
+        ret = -1;
+      }
+      SAO_PROBE_STOP(SAO_ST_OUTPUT, t0, sizeof(RingPacket) + n * sizeof(float));
+      if (pace == 1) {
+        ts.tv_sec = (time_t)(n * pk.delta);
+        ts.tv_nsec = (long)((n * pk.delta - ts.tv_sec) * 1e9);
+        nanosleep(&ts, NULL);
+      }
+    }
+    unmapSac(&map);
+  }
+  free(buf);
+  close(fd);
+  return ret;
+}
+/******************************************************************************/
+
+
+
+/*******************************************************************************
+**    List channels of the ring
+*/
+void
+listRing (const SaoRing *r)
+{
+  const RingChan *c;   char t1[SAO_MOMENT_LEN], t2[SAO_MOMENT_LEN];
+  uint64_t head, last;   int i;
+  printf("Ring of %d channels, %ld samples each\n", r->hdr->nchan,
+         (long) r->hdr->cap);
+  for (i = 0; i < r->hdr->nchan; i++) {
+    c = &r->hdr->chan[i];
+    if (atomic_load(&c->state) != 1) continue;
+    head = atomic_load(&c->head);
+    sprintMoment(t1, SAO_MOMENT_LEN, fromEpoch(c->t0), "ISO");
+    last = (head > 0) ? head - 1 : 0;
+    sprintMoment(t2, SAO_MOMENT_LEN, fromEpoch(c->t0 + last * c->delta), "ISO");
+    printf("%-20s %10.6f %s - %s %llu samples\n", c->key, c->delta, t1, t2,
+           (unsigned long long) head);
+  }
+}
+/******************************************************************************/
+
+
+
+/*******************************************************************************
+**    Print new samples of a channel until the end of output, the channel
+**  may appear in the ring later
+*/
+int
+followRing (const SaoRing *r, const char *key, int all)
+{
+  RingCursor c;   float x[4096];   double t;   long n, i;   uint64_t lost = 0;
+  struct timespec ts = {0, 10000000};
+
+  while (attachRing(r, key, (all == 1) ? 0 : 1, &c) != SAO_OK)
+    nanosleep(&ts, NULL);                     // Wait for the first packet
+  for (;;) {
+    while ((n = readRing(&c, x, 4096, &t)) > 0) {
+      if (c.lost != lost) {
+        fprintf(stderr, "%llu samples are lost\n",
+                (unsigned long long)(c.lost - lost));
+        lost = c.lost;
+      }
+      for (i = 0; i < n; i++)
+        if (printf("%.3f,%g\n", t + i * c.chan->delta, x[i]) < 0) return 0;
+      fflush(stdout);
+    }
+    waitRing(&c, 1.0);
+  }
+  return 0;
+}
+/******************************************************************************/
+
+
+
+/*******************************************************************************
+**    Main function - detecting options and defining program mode
+**  Program modes:
+**      daemon  (-d) option   - ingest packets into rings until a signal
+**      send    (-s) option   - send SAC files as packets
+**      list    (-l) option   - list channels of rings
+**      read    (-r) option   - print new samples of a channel
+*/
+int main (int argc, char *argv[])
+{
+  char *options = "hdslr:an:u:p:c:b:k:t";   int opt;
+  int optdone = 0;              int mode = 0, all = 0, pace = 0;
+  char *name = "sao", *sock = NULL, *fifo = NULL, *key = NULL;
+  int nchan = 64, ret = 0;      long cap = 1 << 20, k = 512;
+  SaoRing ring;
+  int stats = saoStatsArg(&argc, argv);
+
+  while (optdone != 1) {
+    if ((opt = getopt(argc, argv, options)) != -1) {
+      switch (opt) {
+        case 'h':
+          programInfo(1);
+          exit(0);
+        case 'd':
+        case 's':
+        case 'l':
+          mode = opt;
+          break;
+        case 'r':
+          mode = opt;   key = optarg;
+          break;
+        case 'a':
+          all = 1;
+          break;
+        case 'n':
+          name = optarg;
+          break;
+        case 'u':
+          sock = optarg;
+          break;
+        case 'p':
+          fifo = optarg;
+          break;
+        case 'c':
+          nchan = atoi(optarg);
+          break;
+        case 'b':
+          cap = atol(optarg);
+          break;
+        case 'k':
+          if ((k = atol(optarg)) < 1 || k > MAX_PACKET) {
+            fprintf(stderr, "Incorrect packet size '%s'\n", optarg);
+            exit(1);
+          }
+          break;
+        case 't':
+          pace = 1;
+          break;
+        default:
+          programInfo(0);
+          exit(1);
+      }
+    }
+    else optdone = 1;
+  }
+
+  switch (mode) {
+    case 'd':
+      ret = runDaemon(name, sock, fifo, nchan, cap);
+      break;
+    case 's':
+      if (optind >= argc) { programInfo(0);  exit(0); }
+      ret = sendFiles(argv + optind, argc - optind, sock, fifo, k, pace);
+      break;
+    case 'l':
+    case 'r':
+      if (openRing(&ring, name) != SAO_OK) {
+        fprintf(stderr, "Can not open ring '%s', is daemon running?\n", name);
+        exit(1);
+      }
+      if (mode == 'l') listRing(&ring);
+      else ret = followRing(&ring, key, all);
+      closeRing(&ring, NULL);
+      break;
+    default:
+      programInfo(0);
+      exit(0);
+  }
+  if (stats == 1) saoStatsReport(stderr, "seisring");
+  return (ret == 0) ? 0 : 1;
+}
+/******************************************************************************/
@@ -0,0 +1,269 @@
+/*******************************************************************************
+**  seisstat.c - Seismicity Rate and Magnitude Statistics Tool
+**      Part of Seismicity Analysis Organizer
+**
+**  This program is based on 'saostat.c' (part of SAO core library)
+**  Catalog is read only once line by line, so memory does not depend on size
+**  of the catalog, except bootstrap replicates arrays
+**  Program info and usage described in programInfo(..) functions
+**  The <unistd.h> is required for getopt(..) function
+*******************************************************************************/
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <unistd.h>
+
+#include "../../lib/saocore.h"
+#include "../../lib/saosys.h"
+
+
+
+/*******************************************************************************
+**    Print program info and usage
+**      IN: 0 - program usage and info, 1 - full list of options
+*/
+void
+programInfo (int full)
+{
+  char *fullinfo =
+  "Seismicity Rate and Magnitude Statistics Tool.\n"
+  "Read event CATALOG (or standard input) once and calculate event rate in\n"
+  "calendar buckets, cumulative seismic moment, magnitude-frequency\n"
+  "distribution, magnitude of completeness Mc (maximum curvature) and\n"
+  "b-value (Aki-Utsu) with bootstrap confidence intervals.\n"
+  "Each line of CATALOG is 'TIME,MAG,...' separated by comma, semicolon,\n"
+  "space or tab. Lines starting with '#' are skipped. TIME is a string of\n"
+  "any format supported by 'utc' or epoch time with (-e) option.\n"
+  "Events should be ordered by time, otherwise buckets are split.\n\n"
+  "Options:\n"
+  "  -u=UNIT        bucket unit: h - hour, d - day (default), y - year\n"
+  "  -f=FROM        skip events before moment FROM\n"
+  "  -t=TO          skip events at and after moment TO\n"
+  "  -e             TIME is an epoch time in seconds\n"
+  "  -c=CORR        correction for Mc by maximum curvature, default 0.2\n"
+  "  -n=NBOOT       number of bootstrap replicates, default 1000\n"
+  "  -l=LEVEL       confidence level of intervals, default 0.95\n"
+  "  -j=THREADS     number of threads, default all processors\n"
+  "  -h             display this help and exit\n\n"
+  "Output sections (comma separated values):\n"
+  "  # rate: bucket,count,moment,cumulative count,cumulative moment\n"
+  "  # mfd: magnitude,count,cumulative count (M >= magnitude)\n"
+  "  # b-value: events,Mc,a,b,b low,b high,Mc low,Mc high\n\n"
+  "Examples:\n"
+  "  $ seisstat -u y -f 2000-01-01 catalog.csv\n"
+  "  $ cat catalog.csv | seisstat -n 0 -c 0\n\n"
+  "Seismicity Analysis Organizer <https://github.com/ScibRam/SAO>.\n";
+
+  printf("Usage: seisstat [OPTION]... [CATALOG]\n");
+  if (full == 1) printf("%s\n", fullinfo);
+  else printf("Try 'seisstat -h' for full list of options and examples\n");
+  return ;
+}
+/******************************************************************************/
+
+
+
+/*******************************************************************************
+**    Print bucket line of rate section
+**      IN1: Bucket key
+**      IN2: Bucket unit
+**      IN3: Number of events and scalar moment in the bucket
+**      IN4: Cumulative number of events and scalar moment
+*/
+void
+printBucket (long key, char unit, long n, double m0, long cumn, double cumm0)
+{
+  Moment t = bucketBegin(key, unit);   char buf[SAO_MOMENT_LEN];
+  if (unit == 'y') sprintMoment(buf, sizeof(buf), t, "ORD");
+  else if (unit == 'h') sprintMoment(buf, sizeof(buf), t, "SAO");
+  else sprintMoment(buf, sizeof(buf), t, "STD");
+  if (unit == 'y') buf[4] = '\0';
+  fprintf(stdout, "%s,%ld,%.4e,%ld,%.4e\n", buf, n, m0, cumn, cumm0);
+}
+/******************************************************************************/
+
+
+
+/*******************************************************************************
+**    Bootstrap task - one replicate for each index
+*/
+typedef struct {
+  const Seismicity *s;
+  double  mccor;
+  double *mc, *b;
+}  BootCtx;
+
+void
+bootTask (void *ctx, long i)
+{
+  BootCtx *bc = (BootCtx*) ctx;
+  bootSeismicity(bc->s, bc->mccor, (uint64_t)i, &bc->mc[i], &bc->b[i]);
+}
+/******************************************************************************/
+
+
+
+/*******************************************************************************
+**    Quantile of replicates, NAN values are ignored
+**      OUT: Value of quantile or NAN if there is no valid values
+**      IN1: Array of values (will be sorted)
+**      IN2: Number of values
+**      IN3: Quantile level in [0, 1]
+*/
+int
+cmpDouble (const void *a, const void *b)
+{
+  double x = *(const double*)a, y = *(const double*)b;
+  if (isnan(x)) return isnan(y) ? 0 : 1;
+  if (isnan(y)) return -1;
+  return (x > y) - (x < y);
+}
+
+double
+getQuantile (double *x, long n, double q)
+{
+  long nv = 0;
+  qsort(x, n, sizeof(double), cmpDouble);
+  while (nv < n && !isnan(x[nv])) nv++;
+  if (nv == 0) return NAN;
+  return x[lround(q * (nv - 1))];
+}
+/******************************************************************************/
+
+
+
+/*******************************************************************************
+**    Main function - detecting options, reading catalog and output results
+**  First it process all options and its arguments by getopt(..) function
+**  Then each line of catalog is split on TIME and MAG fields
+**  Event is added to the current bucket or the bucket is printed and reset
+**  After catalog is done it prints MFD and runs bootstrap in parallel
+*/
+int main (int argc, char *argv[])
+{
+  char *options = "hu:f:t:ec:n:l:j:";   int opt;
+  int optdone = 0;              int epoch = 0;
+  char unit = 'd';              double mccor = 0.2, level = 0.95;
+  long nboot = 1000;            int nthreads = 0;
+  Moment from = NOT_MOMENT;     Moment to = NOT_MOMENT;
+  FILE *fcat = stdin;           char line[1024];
+  Seismicity s = NO_SEISMICITY; Moment t;
+  long key = 0, n = 0, nbad = 0, nunord = 0;
+  double m0 = 0.0, mag, mc, b, a;
+  long i, nmc;
+
+  while (optdone != 1) {
+    if ((opt = getopt(argc, argv, options)) != -1) {
+      switch (opt) {
+        case 'h':
+          programInfo(1);
+          exit(0);
+        case 'u':
+          unit = optarg[0];
+          if (unit != 'h' && unit != 'd' && unit != 'y') {
+            programInfo(0);
+            exit(1);
+          }
+          break;
+        case 'f':
+          from = readMoment(optarg);
+          break;
+        case 't':
+          to = readMoment(optarg);
+          break;
+        case 'e':
+          epoch = 1;
+          break;
+        case 'c':
+          mccor = atof(optarg);
+          break;
+        case 'n':
+          nboot = atol(optarg);
+          break;
+        case 'l':
+          level = atof(optarg);
+          break;
+        case 'j':
+          nthreads = atoi(optarg);
+          break;
+        default:
+          programInfo(0);
+          exit(1);
+      }
+    }
+    else optdone = 1;
+  }
+  if (optind < argc && strcmp(argv[optind], "-") != 0)
+    if ((fcat = fopen(argv[optind], "r")) == NULL) {
+      fprintf(stderr, "Can not open catalog '%s'\n", argv[optind]);
+      exit(1);
+    }
+
+  fprintf(stdout, "# rate: bucket,count,moment,cumulative count,"
+                  "cumulative moment\n");
+  while (fgets(line, sizeof(line), fcat) != NULL) {
+    char *tstr, *mstr, *end;
+    if (line[0] == '#' || line[0] == '\n') continue;
+    tstr = strtok(line, ",; \t\r\n");
+    mstr = strtok(NULL, ",; \t\r\n");
+    if (tstr == NULL || mstr == NULL) { nbad++;  continue; }
+    mag = strtod(mstr, &end);
+    if (end == mstr) { nbad++;  continue; }
+    if (epoch == 1) t = fromEpoch(atof(tstr));
+    else t = readMoment(tstr);
+    if (isMoment(t) == 0) { nbad++;  continue; }
+    if (isMoment(from) == 1 && cmpMoment(t, from) < 0) continue;
+    if (isMoment(to) == 1 && cmpMoment(t, to) >= 0) continue;
+
+    i = getBucket(t, unit);
+    if (n > 0 && i != key) {
+      printBucket(key, unit, n, s.m0 - m0, s.nev, s.m0);
+      if (i < key) nunord++;
+      n = 0;  m0 = s.m0;
+    }
+    key = i;
+    addEvent(&s, mag);
+    n++;
+  }
+  if (n > 0) printBucket(key, unit, n, s.m0 - m0, s.nev, s.m0);
+  if (fcat != stdin) fclose(fcat);
+
+  fprintf(stdout, "# mfd: magnitude,count,cumulative count\n");
+  n = s.nev - s.nout;
+  for (i = 0; i < MFD_NBINS; i++) {
+    if (s.mfd[i] > 0)
+      fprintf(stdout, "%.1f,%ld,%ld\n", MFD_MMIN + i * MFD_DM, s.mfd[i], n);
+    n -= s.mfd[i];
+  }
+
+  mc = getMc(&s, mccor);
+  b = getBValue(&s, mc, &a, &nmc);
+  fprintf(stdout, "# b-value: events,Mc,a,b,b low,b high,Mc low,Mc high\n");
+  fprintf(stdout, "%ld,%.2f,%.3f,%.3f", nmc, mc, a, b);
+  if (nboot > 0) {
+    BootCtx bc;
+    bc.s = &s;  bc.mccor = mccor;
+    bc.mc = (double*) malloc(nboot * sizeof(double));
+    bc.b  = (double*) malloc(nboot * sizeof(double));
+    if (bc.mc == NULL || bc.b == NULL) {
+      fprintf(stderr, "Not enough memory for %ld replicates\n", nboot);
+      exit(1);
+    }
+    runParallel(nthreads, nboot, bootTask, &bc);
+    fprintf(stdout, ",%.3f,%.3f,%.2f,%.2f\n",
+            getQuantile(bc.b,  nboot, (1.0 - level) / 2),
+            getQuantile(bc.b,  nboot, (1.0 + level) / 2),
+            getQuantile(bc.mc, nboot, (1.0 - level) / 2),
+            getQuantile(bc.mc, nboot, (1.0 + level) / 2));
+    free(bc.mc);  free(bc.b);
+  }
+  else fprintf(stdout, ",nan,nan,nan,nan\n");
+
+  if (nbad > 0)
+    fprintf(stderr, "%ld lines of catalog were not recognized\n", nbad);
+  if (nunord > 0)
+    fprintf(stderr, "%ld times catalog was not ordered by time\n", nunord);
+  return 0;
+}
+/******************************************************************************/
@@ -12,6 +12,7 @@
 #include <unistd.h>
 
 #include "../../lib/saocore.h"
+#include "../../lib/saoprof.h"
 
 
 
@@ -35,7 +36,8 @@ programInfo (int full)
   "  -a=DELTA       add/subtract DELTA seconds to/from MOMENT\n"
   "  -b=REF         calc difference between REF and MOMENT in seconds\n"
   "  -o=FORMAT      format of output string, default: SAO\n"
-  "  -h             display this help and exit\n\n"
+  "  -h             display this help and exit\n"
+  "  --stats        print JSON summary of time spent in stages to stderr\n\n"
   "Formats:\n"
   "  ORD  | YYYY-DDD                 | ordinal date\n"
   "  STD  | YYYY-MM-DD               | standard date format\n"
@@ -103,7 +105,9 @@ int main (int argc, char *argv[])
   int optdone = 0;                          int mode = 0;
   double delta = 0.0;                       char format[32] = "";
   Moment t1 = NOT_MOMENT;                   Moment t;
+  char buf[SAO_MOMENT_LEN];                  int stats, len = -1;
 
+  stats = saoStatsArg(&argc, argv);
   while (optdone != 1) {
     if ((opt = getopt(argc, argv, options)) != -1) {
       switch (opt) {
@@ -139,10 +143,17 @@ int main (int argc, char *argv[])
     if (mode % 2 == 0) t = readMoment(argv[optind]);
     else  t = fromEpoch(atof(argv[optind]));
 
+    if (isMoment(t) == 0) {
+      fprintf(stderr, "Incorrect MOMENT '%s'\n", argv[optind]);
+      exit(1);
+    }
     if (mode / 10 == 1)  t = addSecs(t, delta);
+    if (isMoment(t1) == 1) delta = difSecs(t, t1);
+    else if (strcmp(format,"") != 0 && strcmp(format,"DBD") != 0)
+      len = sprintMoment(buf, sizeof(buf), t, format);
+    SAO_PROBE_START(t0);
 
     if (isMoment(t1) == 1) {
-      delta = difSecs(t, t1);
       if (strcmp(format,"DBD") == 0)
         fprintf(stdout, "%.d\n", (int)(delta / 86400));
       else fprintf(stdout, "%.3f\n", delta);
@@ -151,10 +162,14 @@ int main (int argc, char *argv[])
       if (strcmp(format,"") == 0) fprintf(stdout, "%.3f\n", toEpoch(t));
       else if (strcmp(format,"DBD") == 0)
         fprintf(stdout, "%.d\n", (int)(toEpoch(t) / 86400));
-      else fprintf(stdout, "%s\n", writeMoment(t, format));
+      else if (len > 0)
+        fprintf(stdout, "%s\n", buf);
+      else fprintf(stderr, "Not supported format or incorrect moment.\n");
     }
+    SAO_PROBE_STOP(SAO_ST_OUTPUT, t0, 0);
   }
   else programInfo(0);
+  if (stats == 1) saoStatsReport(stderr, "utc");
   return 0;
 }
 /******************************************************************************/
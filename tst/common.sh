@@ -0,0 +1,82 @@
+# Common part of test scenarios, sourced by each tst/{scenario}.tst
+# Scenario runs from the root of repository with tools in 'bin' and python
+# bindings in 'lib' (see 'make check'), temporary files go to $TMP.
+# Scenario exits with 0 if it passes, otherwise with 1 and a message.
+set -e
+cd "$(dirname "$0")/.."
+TMP=$(mktemp -d)
+export TMP PYTHONPATH=lib
+trap 'rm -rf "$TMP"' EXIT
+
+# Fail the scenario with a message
+fail () {
+  echo "$(basename "$0"): $*" >&2
+  exit 1
+}
+
+# Run python code from stdin with numpy and functions below
+#   write_sac(path, data, delta, epoch, **fields) - write evenly sampled trace
+#   read_sac(path) - header and samples of SAC file
+#   check(cond, msg) - fail the scenario if cond is false
+py () {
+  { cat <<'EOF'
+import datetime, os, sys
+import numpy as np
+
+TMP = os.environ['TMP']
+
+# SAC header - same order as SacH in "lib/saosys.h"
+SACH = np.dtype(
+    [(n, '=f4') for n in
+     ['delta', 'depmin', 'depmax', 'scale', 'odelta', 'b', 'e', 'o', 'a',
+      'internal1'] + ['t%d' % k for k in range(10)] +
+     ['f'] + ['resp%d' % k for k in range(10)] +
+     ['stla', 'stlo', 'stel', 'stdp', 'evla', 'evlo', 'evel', 'evdp',
+      'unused1'] + ['user%d' % k for k in range(10)] +
+     ['dist', 'az', 'baz', 'gcarc', 'internal2', 'internal3', 'depmen',
+      'cmpaz', 'cmpinc'] + ['unused%d' % k for k in range(2, 13)]] +
+    [(n, '=i4') for n in
+     ['nzyear', 'nzjday', 'nzhour', 'nzmin', 'nzsec', 'nzmsec', 'internal4',
+      'internal5', 'internal6', 'npts', 'internal7', 'internal8',
+      'unused13', 'unused14', 'unused15', 'iftype', 'idep', 'iztype',
+      'unused16', 'iinst', 'istreg', 'ievreg', 'ievtyp', 'iqual', 'isynth'] +
+     ['unused%d' % k for k in range(17, 27)] +
+     ['leven', 'lpspol', 'lovrok', 'lcalda', 'unused27']] +
+    [(n, 'S16' if n == 'kevnm' else 'S8') for n in
+     ['kstnm', 'kevnm', 'khole', 'ko', 'ka'] +
+     ['kt%d' % k for k in range(10)] +
+     ['kf', 'kuser0', 'kuser1', 'kuser2', 'kcmpnm', 'knetwk', 'kdatrd',
+      'kinst']])
+
+def check(cond, msg):
+    if not cond:
+        sys.exit('%s: %s' % (os.path.basename(sys.argv[1]), msg))
+
+def write_sac(path, data, delta=0.01, epoch=1577836800.0, **fields):
+    data = np.asarray(data, dtype='=f4')
+    h = np.zeros((), dtype=SACH)
+    for name in SACH.names:
+        h[name] = b'-12345' if h[name].dtype.kind == 'S' else -12345
+    t = datetime.datetime(1970, 1, 1) + \
+        datetime.timedelta(milliseconds=round(epoch * 1000.0))
+    h['nzyear'], h['nzjday'] = t.year, t.timetuple().tm_yday
+    h['nzhour'], h['nzmin'], h['nzsec'] = t.hour, t.minute, t.second
+    h['nzmsec'] = t.microsecond // 1000
+    h['internal4'], h['iftype'], h['leven'], h['iztype'] = 6, 1, 1, 9
+    h['delta'], h['b'], h['npts'] = delta, 0.0, len(data)
+    h['e'] = (len(data) - 1) * delta
+    h['depmin'], h['depmax'] = data.min(), data.max()
+    h['depmen'] = data.mean()
+    for name, value in fields.items():
+        h[name] = value
+    with open(path, 'wb') as f:
+        f.write(h.tobytes() + data.tobytes())
+
+def read_sac(path):
+    raw = open(path, 'rb').read()
+    h = np.frombuffer(raw, dtype=SACH, count=1).reshape(())
+    return h, np.frombuffer(raw, dtype='=f4', count=int(h['npts']),
+                            offset=SACH.itemsize)
+EOF
+    cat; } | python3 - "$0"
+}
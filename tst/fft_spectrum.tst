@@ -0,0 +1,39 @@
+#!/bin/sh
+# FFT of real traces: known spectrum of cosines and round trip of noise
+# fftReal(..) of A*cos(2*pi*k*i/n) has only bin k equal to A*n/2, and
+# fftInverse(..) of fftReal(..) gives the same samples for any size.
+. "$(dirname "$0")/common.sh"
+
+cc -O2 -Ilib -o "$TMP/fft" -x c - -x none lib/obj/saofft.o -lm -pthread <<'EOF'
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include "saocore.h"
+
+int
+main (void)
+{
+  long n, i, k = 7;   double *x, *y, err, a;   const FftPlan *p;
+
+  for (n = 4; n <= 65536; n *= 2) {
+    x = (double*) malloc((n + 2) * sizeof(double));
+    y = (double*) malloc(n * sizeof(double));
+    if ((p = getFftPlan(n)) == NULL || x == NULL || y == NULL) return 2;
+    for (i = 0; i < n; i++)
+      x[i] = 3.0 * cos(2.0 * M_PI * (k % (n / 2)) * i / n);
+    fftReal(p, x);
+    for (err = 0.0, i = 0; i <= n / 2; i++) {
+      a = (i == k % (n / 2)) ? ((i == 0) ? 3.0 * n : 1.5 * n) : 0.0;
+      err = fmax(err, fmax(fabs(x[2*i] - a), fabs(x[2*i+1])));
+    }
+    if (err > 1e-9 * n) { printf("spectrum of %ld: %g\n", n, err);  return 1; }
+    for (i = 0; i < n; i++) x[i] = y[i] = rand() / (double) RAND_MAX - 0.5;
+    fftReal(p, x);   fftInverse(p, x);
+    for (err = 0.0, i = 0; i < n; i++) err = fmax(err, fabs(x[i] - y[i]));
+    if (err > 1e-12) { printf("round trip of %ld: %g\n", n, err);  return 1; }
+    free(x);   free(y);
+  }
+  return 0;
+}
+EOF
+"$TMP/fft" || fail "transform is incorrect"
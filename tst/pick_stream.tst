@@ -0,0 +1,54 @@
+#!/bin/sh
+# Streaming kurtosis in chunks of any size gives the same values as the
+# whole trace (broken samples and a large offset too), and picks of a
+# batch of windows are the same as picks of each window.
+. "$(dirname "$0")/common.sh"
+
+cc -O2 -pthread -Ilib -o "$TMP/stream" -x c - -x none lib/obj/saopick.o \
+   lib/obj/saoprof.o -lm <<'EOF'
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "saocore.h"
+
+#define N     40000
+#define NWIN  50
+#define LEN   1500
+#define NB    11
+
+int
+main (void)
+{
+  static float x[N], cf[N], scf[N], ring[NWIN], work[PICK_LANES * LEN];
+  long i, k, bad = 0, start[NB];   KurtState ks;   Pick p[NB], q;
+
+  srand(5);
+  for (i = 0; i < N; i++) {
+    x[i] = 1e4 + rand() / (double) RAND_MAX - 0.5;
+    if (i % 1700 > 900) x[i] += 5.0 * sin(0.3 * i);
+  }
+  x[333] = NAN;   x[5000] = INFINITY;   x[20000] = -INFINITY;
+
+  kurtosisCf(x, N, NWIN, cf);
+  initKurt(&ks, NWIN, ring);
+  for (i = 0; i < N; i += k) {
+    k = (i % 3 == 0) ? 1 : 1 + rand() % 97;
+    if (i + k > N) k = N - i;
+    streamKurt(&ks, x + i, k, scf + i);
+  }
+  for (i = 0; i < N; i++)
+    if (memcmp(&cf[i], &scf[i], sizeof(float)) != 0) bad++;
+  if (bad > 0) { printf("stream differs in %ld samples\n", bad);  return 1; }
+
+  for (i = 0; i < NB; i++) start[i] = 100 + i * 1700;
+  if (pickBatch(x, start, NB, LEN, NWIN, 8, work, p) != NB) return 1;
+  for (i = 0; i < NB; i++)
+    if (pickOnset(x + start[i], LEN, NWIN, 8, work, &q) != SAO_OK ||
+        q.idx != p[i].idx || q.snr != p[i].snr || q.weight != p[i].weight)
+      bad++;
+  if (bad > 0) { printf("batch differs in %ld windows\n", bad);  return 1; }
+  return 0;
+}
+EOF
+"$TMP/stream" || fail "streaming or batch picks differ"
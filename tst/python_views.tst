@@ -0,0 +1,50 @@
+#!/bin/sh
+# Python bindings give read-only NumPy views of SAC headers and samples,
+# headers of many files (broken ones are undefined) and conversions of
+# epoch times and moments. Mapped file can not be initialised again.
+. "$(dirname "$0")/common.sh"
+
+py <<'PY'
+import sao
+x = np.sin(np.arange(5000) * 0.01).astype('f4')
+write_sac(TMP + '/a.sac', x, 0.02, 1582934400.5, b=1.5, kstnm=b'ABC')
+write_sac(TMP + '/b.sac', x[:10], 0.01, 946684800.0)
+open(TMP + '/c.sac', 'wb').write(b'not a SAC file')
+
+hdr, data = sao.read_sac(TMP + '/a.sac')
+check(np.array_equal(data, x), 'samples of the view')
+check(hdr['npts'] == 5000 and abs(hdr['delta'] - 0.02) < 1e-7 and
+      hdr['kstnm'] == b'ABC', 'fields of the header view')
+check(not data.flags.writeable and not hdr.flags.writeable, 'view is writable')
+try:
+    data[0] = 1.0
+    check(False, 'sample is written through the view')
+except ValueError:
+    pass
+del hdr
+check(np.array_equal(data, x), 'samples after the header is released')
+f = sao.SacFile(TMP + '/a.sac')
+view = np.frombuffer(f, dtype='f4')
+try:
+    f.__init__(TMP + '/b.sac')
+    check(False, 'mapped file is initialised again')
+except ValueError:
+    pass
+check(f.npts == 5000 and view.size == len(x) + 158, 'view after second init')
+del f, view
+
+paths = [TMP + '/a.sac', TMP + '/b.sac', TMP + '/c.sac', TMP + '/none.sac']
+hdrs = sao.read_headers(paths)
+check(list(hdrs['internal4'] == 6) == [True, True, False, False],
+      'valid headers %s' % hdrs['internal4'])
+check(list(hdrs['npts'][:2]) == [5000, 10], 'npts %s' % hdrs['npts'])
+begin = sao.sac_begin(hdrs[:2])
+check(np.allclose(begin, [1582934402.0, 946684800.0], 0, 1e-3),
+      'beginning of traces %s' % begin)
+
+t = np.array([-1e9, 0.0, 683422859.0, 1582934400.25, 4102444799.5])
+m = sao.from_epoch(t)
+check(tuple(m[2]) == (1991, 8, 28, 240, 23, 40, 59, 0), 'moment %s' % m[2])
+check(tuple(m[3]) == (2020, 2, 29, 60, 0, 0, 0, 250), 'moment %s' % m[3])
+check(np.allclose(sao.to_epoch(m), t, 0, 1e-6), 'round trip of epochs')
+PY
@@ -0,0 +1,69 @@
+#!/bin/sh
+# Envelope queries give min/max of blocks of samples from the level
+# that fits the pixels (or samples themselves) skipping broken samples, and
+# an outdated sidecar file is rebuilt when its SAC file changes. Build mode
+# exits with 1 if a sidecar file can not be built.
+. "$(dirname "$0")/common.sh"
+
+py <<'PY'
+rng = np.random.default_rng(4)
+x = np.cumsum(rng.standard_normal(100003)).astype('f4')
+x[5000:5100] = np.nan                           # Broken samples are skipped
+write_sac(TMP + '/env.sac', x, 0.01, 1546300800.0)
+np.save(TMP + '/x.npy', x)
+PY
+
+bin/sacenv -b 16 "$TMP/env.sac" || fail "sacenv failed"
+test -s "$TMP/env.sac.lod" || fail "there is no sidecar file"
+for q in 2019-01-01_000000,2019-01-01_001641,1600 \
+         2019-01-01_000010,2019-01-01_000020,3 \
+         2019-01-01_000040,2019-01-01_000100,700 \
+         2019-01-01_000049,2019-01-01_000052,800; do
+  bin/sacenv -q $q "$TMP/env.sac" > "$TMP/$q.csv" || fail "query $q failed"
+done
+
+py <<'PY'
+x = np.load(TMP + '/x.npy')
+for q in os.listdir(TMP):
+    if not q.endswith('.csv'): continue
+    t1, t2, w = q[:-4].split(',')
+    span = (int(t2[-6:-4]) * 3600 + int(t2[-4:-2]) * 60 + int(t2[-2:]) -
+            int(t1[-6:-4]) * 3600 - int(t1[-4:-2]) * 60 - int(t1[-2:]))
+    spp = span / 0.01 / int(w)
+    out = np.loadtxt(TMP + '/' + q, delimiter=',', ndmin=2)
+    check(len(out) > 1, '%s: %d lines' % (q, len(out)))
+    first = round((out[0, 0] - 1546300800.0) / 0.01)
+    size = round((out[1, 0] - out[0, 0]) / 0.01)
+    check(size == 1 if spp < 16 else
+          (size >= 16 and size <= spp < 2 * size and size & (size - 1) == 0),
+          '%s: %d samples per line for %g per pixel' % (q, size, spp))
+    check(first % size == 0, '%s: line begins at %d' % (q, first))
+    for k, (t, lo, hi) in enumerate(out):
+        i = round((t - 1546300800.0) / 0.01)
+        block = x[i:i + size]
+        block = block[np.isfinite(block)]
+        if len(block) == 0:
+            check(np.isnan(lo) and np.isnan(hi), '%s: gap of line %d' % (q, k))
+            continue
+        check(np.allclose([lo, hi], [block.min(), block.max()], 1e-5, 0),
+              '%s: min/max of line %d' % (q, k))
+PY
+
+sleep 1
+py <<'PY'
+write_sac(TMP + '/env.sac', np.full(100003, 7.0), 0.01, 1546300800.0)
+PY
+bin/sacenv "$TMP/env.sac" || fail "sacenv failed for new data"
+bin/sacenv -q 2019-01-01_000000,2019-01-01_001641,1600 "$TMP/env.sac" \
+  > "$TMP/new.txt" || fail "query of new data failed"
+[ -s "$TMP/new.txt" ] && ! grep -qv ',7,7$' "$TMP/new.txt" ||
+  fail "outdated sidecar file is used"
+
+cp "$TMP/env.sac" "$TMP/ok.sac"
+printf 'not a SAC file' > "$TMP/bad.sac"
+if bin/sacenv "$TMP/ok.sac" "$TMP/bad.sac" 2> "$TMP/err.txt"; then
+  fail "exit status is 0 when a sidecar file is not built"
+fi
+grep -q 'bad.sac - can not build envelope' "$TMP/err.txt" ||
+  fail "failed file is not reported"
+[ -s "$TMP/ok.sac.lod" ] || fail "sidecar file of good file is not built"
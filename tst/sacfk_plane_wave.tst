@@ -0,0 +1,44 @@
+#!/bin/sh
+# FK analysis finds back azimuth and slowness of a synthetic plane wave
+# crossing an array, traces begin at different samples of the same clock.
+. "$(dirname "$0")/common.sh"
+
+py <<'PY'
+baz, slow, delta, n = 60.0, 0.15, 0.01, 6000
+rng = np.random.default_rng(7)
+size = 2 * n
+f = np.fft.rfftfreq(size, delta)
+src = np.fft.rfft(rng.standard_normal(size)) * ((f > 1.0) & (f < 8.0))
+se = -slow * np.sin(np.radians(baz))            # Wave goes away from baz
+sn = -slow * np.cos(np.radians(baz))
+lat0, lon0 = 50.0, 30.0
+xy = [(0, 0), (1, 0), (-1, 0), (0, 1), (0, -1),
+      (0.7, 0.7), (-0.7, 0.7), (0.7, -0.7), (-0.7, -0.7)]
+for k, (x, y) in enumerate(xy):
+    lag = se * x + sn * y
+    tr = np.fft.irfft(src * np.exp(-2j * np.pi * f * lag), size)
+    tr += 0.05 * np.std(tr) * rng.standard_normal(size)
+    cut = 3 * k                                 # Later beginning of trace
+    write_sac('%s/ST%02d.sac' % (TMP, k), tr[cut:cut + n - 10 * k], delta,
+              1577836800.0, b=cut * delta, kstnm=b'ST%02d' % k,
+              stla=lat0 + y / 111.195,
+              stlo=lon0 + x / (111.195 * np.cos(np.radians(lat0))))
+PY
+
+bin/sacfk -s 0.3 -n 61 -w 4 "$TMP"/ST*.sac > "$TMP/fk.csv" ||
+  fail "sacfk failed"
+bin/sacfk -b 60,0.15 -o "$TMP/beam.sac" "$TMP"/ST*.sac ||
+  fail "sacfk beam failed"
+
+py <<'PY'
+fk = np.loadtxt(TMP + '/fk.csv', delimiter=',', usecols=(1, 3, 4), ndmin=2)
+check(len(fk) >= 20, 'only %d windows' % len(fk))
+baz, slow = np.median(fk[:, 1]), np.median(fk[:, 2])
+check(abs(baz - 60.0) < 3.0, 'back azimuth %.2f' % baz)
+check(abs(slow - 0.15) < 0.01, 'slowness %.4f' % slow)
+check(np.min(fk[:, 0]) > 0.8, 'relative power %.3f' % np.min(fk[:, 0]))
+
+hdr, beam = read_sac(TMP + '/beam.sac')        # Samples 24..5943
+check(len(beam) == 5920, 'beam of %d samples' % len(beam))
+check(abs(hdr['b'] - 0.24) < 1e-4, 'beam begins at %.4f' % hdr['b'])
+PY
@@ -0,0 +1,51 @@
+#!/bin/sh
+# Data to header conformity check (sacinfo -c) finds each kind of problem
+# in its own file and nothing in a clean one, for 1 and many threads.
+. "$(dirname "$0")/common.sh"
+
+py <<'PY'
+rng = np.random.default_rng(9)
+x = rng.standard_normal(6000).astype('f4')
+write_sac(TMP + '/ok.sac', x)
+
+y = x.copy();  y[100] = np.nan;  y[200] = np.inf
+write_sac(TMP + '/broken.sac', y, depmin=x.min(), depmax=x.max(),
+          depmen=x.mean())
+write_sac(TMP + '/clip.sac', np.clip(4.0 * np.sin(np.arange(6000) * 0.05),
+                                     -3.0, 3.0))
+write_sac(TMP + '/zero.sac', np.zeros(6000))
+levels = np.tile([0.0, 6.0, 3.0, 1.0, 5.0, 2.0, 4.0], 1000)[:6000]
+write_sac(TMP + '/levels.sac', levels)          # Range is hit, but no tops
+z = x.copy();  z[1000:1200] = 0.5
+write_sac(TMP + '/run.sac', z)
+write_sac(TMP + '/header.sac', x, depmax=x.max() + 1.0)
+write_sac(TMP + '/short.sac', x)
+with open(TMP + '/short.sac', 'r+b') as f: f.truncate(632 + 4 * 5000)
+open(TMP + '/nosac.sac', 'wb').write(b'not a SAC file')
+PY
+
+for j in 1 4; do
+  bin/sacinfo -c -j $j "$TMP"/*.sac > "$TMP/check$j.csv" ||
+    fail "sacinfo -c -j $j failed"
+done
+cmp -s "$TMP/check1.csv" "$TMP/check4.csv" || fail "output depends on threads"
+
+while IFS=, read -r file status rest; do
+  case "$file" in \#*) continue;; esac
+  problems=${rest##*,}
+  case "$(basename "$file")" in
+    ok.sac|levels.sac) expect="OK ";;
+    broken.sac) expect="FAIL NAN;INF";;
+    clip.sac)   expect="FAIL CLIP";;
+    zero.sac)   expect="FAIL RUN";;
+    run.sac)    expect="FAIL RUN";;
+    header.sac) expect="FAIL DEPMAX";;
+    short.sac)  expect="FAIL SIZE*";;           # Samples in file are read
+    nosac.sac)  expect="FAIL NOSAC";;
+  esac
+  case "$status $problems" in
+    $expect) ;;
+    *) fail "$(basename "$file") is '$status $problems' instead of '$expect'";;
+  esac
+done < "$TMP/check1.csv"
+[ "$(wc -l < "$TMP/check1.csv")" -eq 10 ] || fail "not all files are checked"
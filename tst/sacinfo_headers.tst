@@ -0,0 +1,40 @@
+#!/bin/sh
+# Batch header reader gives the same summary of many files with io_uring
+# and with threads (SAO_NO_URING), in order of files, with broken, short
+# and missing files among them.
+. "$(dirname "$0")/common.sh"
+
+py <<'PY'
+for k in range(300):
+    write_sac('%s/f%03d.sac' % (TMP, k), np.zeros(10 + k), 0.01 * (k % 7 + 1),
+              1577836800.0 + 3600.0 * k, kstnm=b'S%03d' % k)
+for k in (13, 101, 257):
+    open('%s/f%03d.sac' % (TMP, k), 'wb').write(b'not a SAC file')
+open(TMP + '/f200.sac', 'r+b').truncate(300)
+PY
+ls "$TMP"/f*.sac > "$TMP/files.lst"
+echo "$TMP/none.sac" >> "$TMP/files.lst"
+
+bin/sacinfo -s $(cat "$TMP/files.lst") > "$TMP/uring.txt" 2>&1 || true
+SAO_NO_URING=1 bin/sacinfo -s -j 3 $(cat "$TMP/files.lst") \
+  > "$TMP/threads.txt" 2>&1 || true
+cmp -s "$TMP/uring.txt" "$TMP/threads.txt" || fail "io_uring and threads differ"
+
+while read -r f; do
+  bin/sacinfo -s "$f" 2>&1 || true
+done < "$TMP/files.lst" > "$TMP/single.txt"
+cmp -s "$TMP/uring.txt" "$TMP/single.txt" ||
+  fail "batch and single files differ"
+
+py <<'PY'
+lines = open(TMP + '/uring.txt').read().splitlines()
+check(len(lines) == 301, '%d lines' % len(lines))
+for k, line in enumerate(lines[:300]):
+    name = '%s/f%03d.sac' % (TMP, k)
+    if k in (13, 101, 200, 257):
+        check(line == name + ' - incorrect SAC file', line)
+    else:
+        check(line.startswith(name + ',') and
+              line.split(',')[2:6:3] == [str(10 + k), 'S%03d' % k], line)
+check(lines[300].endswith('none.sac - can not open file'), lines[300])
+PY
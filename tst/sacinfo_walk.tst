@@ -0,0 +1,37 @@
+#!/bin/sh
+# Recursive walker (-R) takes every file of a directory tree in sorted
+# order, -g filters names by GLOB and -x relative paths by REGEX.
+. "$(dirname "$0")/common.sh"
+
+py <<'PY'
+for year in (2018, 2019):
+    for net in ('IU', 'XX'):
+        for sta in ('ANMO', 'COLA', 'KEV'):
+            d = '%s/sds/%d/%s/%s' % (TMP, year, net, sta)
+            os.makedirs(d)
+            for cha in ('BHZ', 'BHE', 'HHZ'):
+                write_sac('%s/%s.%s.%s.D.sac' % (d, net, sta, cha),
+                          np.zeros(10))
+os.makedirs(TMP + '/sds/empty/deeper')
+PY
+
+list () {
+  sed -n "s|^$TMP/sds/\([^,]*\),.*|\1|p" "$1"
+}
+
+bin/sacinfo -s -R "$TMP/sds" > "$TMP/all.txt" || fail "walk failed"
+(cd "$TMP/sds" && find . -type f | sed 's|^\./||' | LC_ALL=C sort) \
+  > "$TMP/all.exp"
+list "$TMP/all.txt" | cmp -s - "$TMP/all.exp" || fail "files of -R differ"
+[ "$(wc -l < "$TMP/all.exp")" -eq 36 ] || fail "tree is not written"
+
+bin/sacinfo -s -R "$TMP/sds" -g '*.BH?.D.*' > "$TMP/glob.txt" ||
+  fail "walk with -g failed"
+grep '\.BH.\.D\.' "$TMP/all.exp" > "$TMP/glob.exp"
+list "$TMP/glob.txt" | cmp -s - "$TMP/glob.exp" || fail "files of -g differ"
+
+bin/sacinfo -s -R "$TMP/sds" -x '^2019/IU/(ANMO|COLA)/' > "$TMP/regex.txt" ||
+  fail "walk with -x failed"
+grep -E '^2019/IU/(ANMO|COLA)/' "$TMP/all.exp" > "$TMP/regex.exp"
+list "$TMP/regex.txt" | cmp -s - "$TMP/regex.exp" || fail "files of -x differ"
+[ "$(wc -l < "$TMP/regex.exp")" -eq 6 ] || fail "regex takes wrong files"
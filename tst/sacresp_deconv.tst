@@ -0,0 +1,51 @@
+#!/bin/sh
+# Response removal recovers ground velocity of a trace convolved with a
+# known poles and zeros response (STS-2 like, displacement to counts), and
+# a transient at the end of a trace does not wrap around onto its beginning.
+. "$(dirname "$0")/common.sh"
+
+cat > "$TMP/SAC_PZs_XX_STA_HHZ_" <<'PZ'
+ZEROS 3
+POLES 5
+-0.037 0.037
+-0.037 -0.037
+-251.3 0.0
+-131.0 467.3
+-131.0 -467.3
+CONSTANT 1.2e18
+PZ
+
+py <<'PY'
+n, delta = 8192, 0.01                           # Power of two, no padding
+size = 2 * n
+s = 2j * np.pi * np.fft.rfftfreq(size, delta)
+poles = [-0.037+0.037j, -0.037-0.037j, -251.3, -131.0+467.3j, -131.0-467.3j]
+h = 1.2e18 * s ** 3 / np.prod([s - p for p in poles], axis=0)
+h[1:] /= s[1:]                                  # Velocity to counts
+h[0] = 0.0
+for name, at, fp in (('st', n // 2, 2.0), ('end', n - 700, 0.25)):
+    t = (np.arange(n) - at) * delta
+    u = (np.pi * fp * t) ** 2                   # Ricker wavelet of fp Hz
+    vel = (1.0 - 2.0 * u) * np.exp(-u) * 1e-6
+    np.save('%s/%s.npy' % (TMP, name), vel)
+    counts = np.fft.irfft(np.fft.rfft(vel, size) * h, size)[:n]
+    write_sac('%s/%s.sac' % (TMP, name), counts, delta, knetwk=b'XX',
+              kstnm=b'STA', kcmpnm=b'HHZ')
+PY
+
+bin/sacresp -p "$TMP/SAC_PZs_XX_STA_HHZ_" -u v -f 0.1,0.2,30,40 "$TMP/st.sac" \
+  "$TMP/end.sac" || fail "sacresp failed"
+
+py <<'PY'
+vel = np.load(TMP + '/st.npy')
+hdr, out = read_sac(TMP + '/st.sac.rm')
+check(len(out) == len(vel), 'length of corrected trace %d' % len(out))
+mid = slice(len(vel) // 4, 3 * len(vel) // 4)
+err = np.std(out[mid] - vel[mid]) / np.std(vel[mid])
+check(err < 0.02, 'relative error of velocity %.4f' % err)
+
+vel = np.load(TMP + '/end.npy')
+out = read_sac(TMP + '/end.sac.rm')[1]
+head = np.max(np.abs(out[:len(vel) // 2])) / np.max(np.abs(vel))
+check(head < 0.002, 'transient of the end wraps around, %.4f at start' % head)
+PY
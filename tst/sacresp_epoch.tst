@@ -0,0 +1,45 @@
+#!/bin/sh
+# Response of a trace is taken from the epoch of PZ file that contains its
+# beginning, traces out of all epochs fail with exit status 1.
+. "$(dirname "$0")/common.sh"
+
+for epoch in "2010-01-01T00:00:00 2015-01-01T00:00:00 1.0e9" \
+             "2015-01-01T00:00:00 2599-12-31T23:59:59 4.0e9"; do
+  set -- $epoch
+  cat <<PZ
+* NETWORK   (KNETWK): XX
+* STATION    (KSTNM): STA
+* LOCATION   (KHOLE):
+* CHANNEL   (KCMPNM): HHZ
+* START             : $1
+* END               : $2
+ZEROS 3
+POLES 2
+-0.037 0.037
+-0.037 -0.037
+CONSTANT $3
+PZ
+done > "$TMP/st.pz"
+
+py <<'PY'
+n, delta = 4096, 0.01
+x = np.sin(2.0 * np.pi * 2.0 * np.arange(n) * delta) * 1000.0
+for name, epoch in (('old', 1262304000.0 + 86400.0),   # 2010-01-02
+                    ('new', 1420070400.0 + 86400.0),   # 2015-01-02
+                    ('out', 1104537600.0)):            # 2005-01-01
+    write_sac('%s/%s.sac' % (TMP, name), x, delta, epoch, knetwk=b'XX',
+              kstnm=b'STA', kcmpnm=b'HHZ')
+PY
+
+bin/sacresp -p "$TMP/st.pz" -u v "$TMP/old.sac" "$TMP/new.sac" 2>/dev/null ||
+  fail "traces inside epochs are not corrected"
+if bin/sacresp -p "$TMP/st.pz" "$TMP/out.sac" 2>/dev/null; then
+  fail "trace out of epochs is corrected"
+fi
+
+py <<'PY'
+old = read_sac(TMP + '/old.sac.rm')[1]
+new = read_sac(TMP + '/new.sac.rm')[1]
+ratio = np.std(old) / np.std(new)
+check(abs(ratio - 4.0) < 0.01, 'ratio of epochs responses %.4f' % ratio)
+PY
@@ -0,0 +1,28 @@
+#!/bin/sh
+# Benchmark suite runs every benchmark with machine-readable output and
+# cleans its synthetic data, keeping a directory it did not create.
+. "$(dirname "$0")/common.sh"
+
+mkdir "$TMP/data"
+tst/saobench -m -r 2 -w 1 -i 1000 -f 20 -n 1000 -d "$TMP/data" \
+  > "$TMP/bench.csv" || fail "saobench failed"
+[ -d "$TMP/data" ] || fail "directory of data is removed"
+[ -z "$(ls "$TMP/data")" ] || fail "synthetic data are left"
+
+py <<'PY'
+import csv
+rows = list(csv.reader(open(TMP + '/bench.csv')))
+check(rows[0] == ['benchmark', 'unit', 'mean', 'stddev', 'min', 'reps',
+                  'throughput', 'throughput unit'], 'header %s' % rows[0])
+names = set()
+for row in rows[1:]:
+    check(len(row) == 8, 'columns of %s' % row)
+    mean, sd, low, reps, rate = (float(v) for v in row[2:7])
+    check(mean > 0 and sd >= 0 and 0 < low <= mean and reps == 2 and
+          rate > 0, 'values of %s' % row)
+    names.add(row[0])
+for name in ('fromEpoch', 'toEpoch', 'readMoment', 'writeMoment',
+             'sprintMoment', 'getSacBegin', 'readSacH', 'sacinfo -s',
+             'sacinfo -c', 'utc'):
+    check(name in names, 'there is no %s benchmark' % name)
+PY
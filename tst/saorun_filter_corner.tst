@@ -0,0 +1,36 @@
+#!/bin/sh
+# Butterworth filters of saorun pass sines in the pass band, attenuate them
+# by 3 dB at corners (6 dB for zero-phase ones) and stop them far away.
+. "$(dirname "$0")/common.sh"
+
+py <<'PY'
+delta, n = 0.01, 20000
+for f in (0.5, 1.0, 2.0, 5.0, 10.0, 20.0, 40.0):
+    x = np.sin(2.0 * np.pi * f * np.arange(n) * delta)
+    write_sac('%s/%g.sac' % (TMP, f), x, delta)
+PY
+
+for p in lp,5,4 hp,2,4 bp,2,10,2 lp,5,4,zp; do
+  mkdir "$TMP/$p"
+  bin/saorun -p "filter:$p|write:$TMP/$p" "$TMP"/*.sac > /dev/null ||
+    fail "saorun filter:$p failed"
+done
+
+py <<'PY'
+def gain(p, f):                                 # dB of the steady state
+    x = read_sac('%s/%s/%g.sac' % (TMP, p, f))[1][5000:-5000]
+    return 20.0 * np.log10(np.std(x) * np.sqrt(2.0))
+
+for p, f, lo, hi in (('lp,5,4', 1.0, -0.1, 0.1), ('lp,5,4', 5.0, -3.2, -2.8),
+                     ('lp,5,4', 20.0, -60.0, -40.0),
+                     ('hp,2,4', 10.0, -0.1, 0.1), ('hp,2,4', 2.0, -3.2, -2.8),
+                     ('hp,2,4', 0.5, -60.0, -40.0),
+                     ('bp,2,10,2', 5.0, -0.5, 0.1),
+                     ('bp,2,10,2', 2.0, -3.2, -2.8),
+                     ('bp,2,10,2', 10.0, -3.2, -2.8),
+                     ('bp,2,10,2', 40.0, -60.0, -15.0),
+                     ('lp,5,4,zp', 1.0, -0.1, 0.1),
+                     ('lp,5,4,zp', 5.0, -6.2, -5.8)):
+    g = gain(p, f)
+    check(lo <= g <= hi, 'filter:%s gain at %g Hz is %.2f dB' % (p, f, g))
+PY
@@ -0,0 +1,78 @@
+#!/bin/sh
+# Picker of saorun finds synthetic onsets in noise within a few samples,
+# from a header marker and from triggers of a detect stage, and stores the
+# best pick into a header marker. Detect stage keeps all triggers, and
+# windows of one file picked on threads give the same picks.
+. "$(dirname "$0")/common.sh"
+
+py <<'PY'
+rng = np.random.default_rng(11)
+delta, n = 0.01, 12000
+t = np.arange(400) * delta
+onsets = {}
+for k in range(6):
+    x = rng.standard_normal(n)
+    on = [int(v) for v in (2500 + 37 * k, 7000 + 53 * k)]
+    for i in on:
+        x[i:i + 400] += (8.0 + 4 * k) * np.exp(-t * 2.0) * \
+                        np.sin(2 * np.pi * 6.0 * t)
+    write_sac('%s/e%d.sac' % (TMP, k), x, delta, 1546300800.0,
+              t1=on[0] * delta + 0.4)
+    onsets['%s/e%d.sac' % (TMP, k)] = on
+np.save(TMP + '/onsets.npy', onsets)
+PY
+
+mkdir "$TMP/out"
+bin/saorun -p 'pick:P,t1,3,3,.5,a|write:'"$TMP/out" "$TMP"/e*.sac \
+  > "$TMP/mark.csv" || fail "pick from marker failed"
+bin/saorun -p 'detect:0.5,10,4,1.5|pick:P,trig,2,3,.5' "$TMP"/e*.sac \
+  > "$TMP/trig.csv" || fail "pick from triggers failed"
+
+py <<'PY'
+import csv, datetime
+onsets = np.load(TMP + '/onsets.npy', allow_pickle=True).item()
+begin = 1546300800.0
+for name, count in (('mark', 1), ('trig', 2)):
+    picks = {}
+    for row in csv.reader(open('%s/%s.csv' % (TMP, name))):
+        t = datetime.datetime.fromisoformat(row[2] + '+00:00').timestamp()
+        picks.setdefault(row[0], []).append(round((t - begin) / 0.01))
+    check(sorted(picks) == sorted(onsets), '%s: files %s' % (name, picks))
+    for f, on in onsets.items():
+        p = picks[f]
+        check(len(p) == count, '%s: %d picks in %s' % (name, len(p), f))
+        for i, j in zip(p, on):
+            check(abs(i - j) <= 3, '%s: pick %d for onset %d' % (name, i, j))
+
+for f, on in onsets.items():
+    hdr = read_sac(f.replace(TMP, TMP + '/out'))[0]
+    check(abs(hdr['a'] / 0.01 - on[0]) <= 3, 'marker A is %g' % hdr['a'])
+    check(hdr['ka'].item()[:2] in (b'IP', b'EP'), 'marker %s' % hdr['ka'])
+PY
+
+# Detect stage keeps all triggers of a file, however many there are
+py <<'PY'
+x = np.random.default_rng(5).standard_normal(500000) * 0.1
+for i in range(200, 500000, 100):
+    x[i:i + 10] += 20.0
+write_sac(TMP + '/many.sac', x, 0.01, 1546300800.0)
+PY
+bin/saorun -p 'detect:0.05,0.5,8,1.5' "$TMP/many.sac" > "$TMP/many.csv" ||
+  fail "detect of many triggers failed"
+for j in 1 3; do                        # Windows of one file on threads
+  bin/saorun -j $j -p 'detect:0.05,0.5,8,1.5|pick:P,trig,.3,.6,.05' \
+    "$TMP/many.sac" > "$TMP/pick$j.csv" || fail "pick of many windows failed"
+done
+cmp -s "$TMP/pick1.csv" "$TMP/pick3.csv" ||
+  fail "picks of windows on threads differ"
+[ $(wc -l < "$TMP/pick1.csv") -eq 4998 ] || fail "windows are not picked"
+
+py <<'PY'
+import csv, datetime
+on = set()
+for row in csv.reader(open(TMP + '/many.csv')):
+    t = datetime.datetime.fromisoformat(row[1] + '+00:00').timestamp()
+    on.add(round((t - 1546300800.0) / 0.01))
+check(on >= set(range(200, 500000, 100)),
+      'triggers of %d bursts' % len(on & set(range(200, 500000, 100))))
+PY
@@ -0,0 +1,33 @@
+#!/bin/sh
+# Output of saorun does not depend on the number of threads, and shards of
+# files (-S) together give the same output as the whole run.
+. "$(dirname "$0")/common.sh"
+
+py <<'PY'
+rng = np.random.default_rng(3)
+delta, n = 0.01, 12000
+t = np.arange(200) * delta
+for k in range(23):
+    x = rng.standard_normal(n)
+    for on in rng.integers(1500, n - 1500, size=k % 4 + 1):
+        x[on:on + 200] += 20.0 * np.exp(-t * 3.0) * np.sin(2 * np.pi * 8 * t)
+    write_sac('%s/f%02d.sac' % (TMP, k), x, delta, 1577836800.0 + 60 * k)
+PY
+echo "not a SAC file" > "$TMP/f10.sac"
+ls "$TMP"/f*.sac > "$TMP/files.lst"
+
+run () {
+  bin/saorun -p 'filter:bp,1,20,2|detect:0.5,10,4,1.5|pick:P,trig,2,3,.5' \
+             -i "$TMP/files.lst" "$@" 2> /dev/null
+}
+
+run -j1 > "$TMP/j1.csv" && fail "broken file is not reported"
+test -s "$TMP/j1.csv" || fail "there are no picks"
+for j in 2 8; do
+  run -j$j > "$TMP/j$j.csv" || true
+  cmp -s "$TMP/j1.csv" "$TMP/j$j.csv" || fail "output of -j$j differs"
+done
+for k in 0 1 2 3; do
+  run -j3 -S $k/4 || true
+done > "$TMP/shards.csv"
+cmp -s "$TMP/j1.csv" "$TMP/shards.csv" || fail "output of shards differs"
@@ -0,0 +1,81 @@
+#!/bin/sh
+# Ingest daemon keeps samples of concurrent producers (named pipe and
+# socket) in rings: overlaps are dropped, gaps are NaN, and junk bytes in
+# the pipe are skipped without losing the packets after them. Stopping
+# the daemon during ingest removes the ring and socket and exits with 0.
+. "$(dirname "$0")/common.sh"
+
+NAME=sao_tst_$$
+bin/seisring -d -n $NAME -p "$TMP/fifo" -u "$TMP/sock" -b 65536 \
+  2> "$TMP/daemon.log" &
+pid=$!
+trap 'kill $pid 2>/dev/null; wait $pid; rm -rf "$TMP"' EXIT
+i=0
+until [ -S "$TMP/sock" ] && [ -p "$TMP/fifo" ] || [ $i -ge 50 ]; do
+  sleep 0.1;  i=$((i + 1))
+done
+
+py <<'PY'
+x = np.arange(6000, dtype='f4')
+for k in range(6):                              # One channel per producer
+    write_sac('%s/p%d.sac' % (TMP, k), x + 10000 * k, 0.01, 1546300800.0,
+              knetwk=b'XX', kstnm=b'ST%d' % k, kcmpnm=b'HHZ')
+write_sac(TMP + '/over.sac', x[3000:] + 0, 0.01, 1546300830.0,
+          knetwk=b'XX', kstnm=b'ST0', kcmpnm=b'HHZ')
+write_sac(TMP + '/late.sac', x[:1000] + 0, 0.01, 1546300870.0,
+          knetwk=b'XX', kstnm=b'ST0', kcmpnm=b'HHZ')
+PY
+
+senders=
+for k in 0 1 2 3 4 5; do
+  bin/seisring -s -p "$TMP/fifo" -k 4096 "$TMP/p$k.sac" &
+  senders="$senders $!"
+done
+for s in $senders; do wait $s || fail "sending to named pipe failed"; done
+bin/seisring -s -u "$TMP/sock" -k 700 "$TMP/over.sac" ||
+  fail "sending to socket failed"
+{ head -c 1000 /dev/zero;  bin/seisring -s -p /dev/stdout -k 100 \
+  "$TMP/late.sac"; } > "$TMP/fifo" || fail "sending after junk failed"
+
+i=0
+until bin/seisring -l -n $NAME | grep -q 'XX.ST0.* 8000 samples' ||
+      [ $i -ge 50 ]; do
+  sleep 0.1;  i=$((i + 1))
+done
+for k in 0 1 2 3 4 5; do
+  timeout 1 bin/seisring -r XX.ST$k..HHZ -a -n $NAME > "$TMP/r$k.csv" || true
+done
+grep -q 'Incorrect packet' "$TMP/daemon.log" || fail "junk is not reported"
+
+py <<'PY'
+x = np.arange(6000, dtype='f4')
+for k in range(6):
+    r = np.genfromtxt('%s/r%d.csv' % (TMP, k), delimiter=',')
+    n = 8000 if k == 0 else 6000
+    check(r.shape == (n, 2), 'ST%d: %s samples' % (k, r.shape))
+    check(np.allclose(r[:, 0], 1546300800.0 + 0.01 * np.arange(n), 0, 1e-4),
+          'ST%d: times of samples' % k)
+    check(np.array_equal(r[:6000, 1], x + 10000 * k), 'ST%d: samples' % k)
+    if k == 0:
+        check(np.all(np.isnan(r[6000:7000, 1])), 'gap is not NaN')
+        check(np.array_equal(r[7000:, 1], x[:1000]), 'samples after gap')
+PY
+
+# Daemon stops cleanly while producers still write to the ring
+py <<'PY'
+write_sac(TMP + '/long.sac', np.arange(400000, dtype='f4'), 0.01,
+          1546400000.0, knetwk=b'XX', kstnm=b'LONG', kcmpnm=b'HHZ')
+PY
+senders=
+for k in 0 1 2 3; do
+  timeout 10 bin/seisring -s -p "$TMP/fifo" -k 64 "$TMP/long.sac" \
+    2>/dev/null &
+  senders="$senders $!"
+done
+sleep 0.2
+kill -TERM $pid
+wait $pid || fail "daemon stopped during ingest with status $?"
+for s in $senders; do wait $s || true; done
+trap 'rm -rf "$TMP"' EXIT
+[ ! -e "$TMP/sock" ] || fail "socket is left after stop"
+! bin/seisring -l -n $NAME > /dev/null 2>&1 || fail "ring is left after stop"
@@ -0,0 +1,56 @@
+#!/bin/sh
+# Statistics of a synthetic Gutenberg-Richter catalog: daily rate and
+# moment, magnitude-frequency distribution, Mc and b-value near 1 with its
+# interval, and the same result for epoch and ISO times of events.
+. "$(dirname "$0")/common.sh"
+
+py <<'PY'
+import datetime
+rng = np.random.default_rng(1)
+n = 20000
+t = 1577836800.0 + np.sort(rng.uniform(0.0, 10 * 86400.0, n))
+m = np.round(1.95 + rng.exponential(1.0 / np.log(10.0), n), 1)
+with open(TMP + '/epoch.csv', 'w') as f:
+    f.write('# time,magnitude\n')
+    f.writelines('%.3f,%.1f\n' % (a, b) for a, b in zip(t, m))
+with open(TMP + '/iso.csv', 'w') as f:
+    f.writelines('%s %.1f\n' % (datetime.datetime.fromtimestamp(
+        a, datetime.timezone.utc).strftime('%Y-%m-%dT%H:%M:%S.%f')[:-3], b)
+        for a, b in zip(t, m))
+np.save(TMP + '/t.npy', t)
+np.save(TMP + '/m.npy', m)
+PY
+
+bin/seisstat -e -c 0 -n 200 -j 1 "$TMP/epoch.csv" > "$TMP/epoch.out" ||
+  fail "seisstat of epoch times failed"
+bin/seisstat -c 0 -n 200 < "$TMP/iso.csv" > "$TMP/iso.out" ||
+  fail "seisstat of ISO times failed"
+cmp -s "$TMP/epoch.out" "$TMP/iso.out" || fail "epoch and ISO times differ"
+
+py <<'PY'
+t, m = np.load(TMP + '/t.npy'), np.load(TMP + '/m.npy')
+sec = {}
+for line in open(TMP + '/epoch.out'):
+    if line.startswith('#'): name = line[2:line.index(':')];  continue
+    sec.setdefault(name, []).append(line.strip().split(','))
+
+day = ((t - 1577836800.0) // 86400).astype(int)
+rate = sec['rate']
+check(len(rate) == 10, '%d daily buckets' % len(rate))
+for k, row in enumerate(rate):
+    check(row[0] == '2020-01-%02d' % (k + 1), 'bucket %s' % row[0])
+    check(int(row[1]) == np.sum(day == k), 'count of %s' % row[0])
+    m0 = np.sum(10.0 ** (1.5 * m[day == k] + 9.1))
+    check(abs(float(row[2]) / m0 - 1.0) < 1e-3, 'moment of %s' % row[0])
+check(int(rate[-1][3]) == len(t), 'cumulative count %s' % rate[-1][3])
+
+for row in sec['mfd']:
+    mag = float(row[0])
+    check(int(row[1]) == np.sum(np.abs(m - mag) < 0.05), 'mfd of %s' % mag)
+    check(int(row[2]) == np.sum(m > mag - 0.05), 'cumulative mfd of %s' % mag)
+
+n, mc, a, b, lo, hi = [float(v) for v in sec['b-value'][0][:6]]
+check(n == len(t) and abs(mc - 2.0) < 1e-6, 'events %d, Mc %.2f' % (n, mc))
+check(abs(b - 1.0) < 0.03 and lo < b < hi, 'b-value %.3f (%.3f..%.3f)' %
+      (b, lo, hi))
+PY
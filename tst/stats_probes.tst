@@ -0,0 +1,39 @@
+#!/bin/sh
+# Summary of --stats is valid JSON on stderr, counts each file and stage
+# once (formatting of nested calls too) and does not change the output.
+. "$(dirname "$0")/common.sh"
+
+py <<'PY'
+for k in range(5):
+    write_sac('%s/f%d.sac' % (TMP, k), np.arange(1000.0 * (k + 1)))
+open(TMP + '/nosac.sac', 'wb').write(b'not a SAC file')
+PY
+
+bin/sacinfo "$TMP"/*.sac > "$TMP/plain.txt" 2>&1 || true
+bin/sacinfo --stats "$TMP"/*.sac > "$TMP/info.txt" 2> "$TMP/info.json" || true
+cmp -s "$TMP/plain.txt" "$TMP/info.txt" || fail "output of sacinfo changed"
+bin/sacinfo -c --stats "$TMP"/*.sac > /dev/null 2> "$TMP/check.json" || true
+bin/utc --stats -o ISO 2020-02-29_120000 > /dev/null 2> "$TMP/utc.json" ||
+  fail "utc failed"
+
+py <<'PY'
+import json
+info = json.load(open(TMP + '/info.json'))
+st = info['stages']
+check(info['tool'] == 'sacinfo' and info['files'] == 6, 'files %s' % info)
+check(st['open']['calls'] == 6, 'open %s' % st['open'])
+check(st['readSacH']['bytes'] == 5 * 632, 'readSacH %s' % st['readSacH'])
+check(st['format']['calls'] == 5, 'format %s' % st['format'])
+check(st['output']['calls'] == 6, 'output %s' % st['output'])
+
+st = json.load(open(TMP + '/check.json'))['stages']
+check(st['scanData']['calls'] == 5 and
+      st['scanData']['bytes'] == 4 * 1000 * (1 + 2 + 3 + 4 + 5),
+      'scanData %s' % st['scanData'])
+
+utc = json.load(open(TMP + '/utc.json'))
+st = utc['stages']
+check(utc['tool'] == 'utc' and utc['allocs'] == 0, 'utc %s' % utc)
+check(st['readMoment']['calls'] == 1 and st['format']['calls'] == 1 and
+      st['output']['calls'] == 1, 'stages of utc %s' % st)
+PY
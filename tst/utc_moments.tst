@@ -0,0 +1,56 @@
+#!/bin/sh
+# Moments convert to epoch times of the calendar (leap years and dates
+# before 1970 too) and back, and reentrant conversions give the same
+# results in many threads at once.
+. "$(dirname "$0")/common.sh"
+
+for d in 1960-03-29_120000 1968-02-29_000001 1969-12-31_235959 \
+         1970-01-01_000000 1991-08-28_234059 2000-02-29_060000 \
+         2019-12-31_235959 2020-01-01_000000 2020-03-01_120000 \
+         2024-12-31_235959 2038-01-19_031408; do
+  t=$(bin/utc "$d")
+  e=$(date -u -d "$(echo "$d" | sed 's/_\(..\)\(..\)/ \1:\2:/')" +%s)
+  [ "$t" = "$e.000" ] || fail "epoch of $d is $t instead of $e"
+  [ "$(bin/utc -e "$t")" = "$d" ] || fail "moment of $t is not $d"
+done
+
+cc -O2 -pthread -Ilib -o "$TMP/moments" -x c - -x none lib/obj/saotime.o \
+   lib/obj/saoprof.o -lm <<'EOF'
+#include <stdio.h>
+#include <math.h>
+#include <pthread.h>
+#include "saocore.h"
+
+static const char *formats[] = {"SAO", "SAC", "ISO"};
+
+/*  Round trips of moments of one thread, returns number of mismatches  */
+static void*
+run (void *arg)
+{
+  long i, bad = 0, seed = (long) arg;   char buf[64];   Moment t, u;
+  double epoch;
+
+  for (i = 0; i < 200000; i++) {
+    seed = (seed * 1103515245 + 12345) & 0x7FFFFFFF;
+    epoch = (double) seed - 3e8 + (i % 1000) / 1000.0;
+    t = fromEpoch(epoch);
+    if (sprintMoment(buf, sizeof(buf), t, formats[i % 3]) < 0 ||
+        scanMoment(buf, &u) != SAO_OK ||
+        fabs(toEpoch(u) - epoch) > ((i % 3 == 2) ? 1e-3 : 1.0))
+      bad++;
+  }
+  return (void*) bad;
+}
+
+int
+main (void)
+{
+  pthread_t th[8];   void *bad;   long i, total = 0;
+
+  for (i = 0; i < 8; i++) pthread_create(&th[i], NULL, run, (void*) i);
+  for (i = 0; i < 8; i++) { pthread_join(th[i], &bad);  total += (long) bad; }
+  printf("%ld\n", total);
+  return total != 0;
+}
+EOF
+"$TMP/moments" > /dev/null || fail "round trips of moments in threads fail"